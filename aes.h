@@ -0,0 +1,132 @@
+#ifndef AES_H
+#define AES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pool.h"
+#include "stream.h"
+
+#define AES_BLOCK_SIZE 16
+#define Nb 4 // Number of columns comprising the state
+
+// Key sizes in bytes. The round count, 10, 12 or 14, is the key length in 32-bit words plus 6
+#define AES_128_KEY_SIZE 16
+#define AES_192_KEY_SIZE 24
+#define AES_256_KEY_SIZE 32
+#define AES_MAX_ROUNDS 14
+#define AES_VALID_KEY_SIZE(n) ((n) == AES_128_KEY_SIZE || (n) == AES_192_KEY_SIZE || (n) == AES_256_KEY_SIZE)
+
+// Select the 32-bit T-table engine (1) or the byte-wise state_t engine (0) at build time
+#ifndef AES_TTABLE
+#define AES_TTABLE 1
+#endif
+
+// Build the constant-time bitsliced engine, used for software keys unless aes_set_bitslice(0)
+#ifndef AES_BITSLICE
+#define AES_BITSLICE 1
+#endif
+
+// Size of the largest expanded key: (AES_MAX_ROUNDS + 1) round keys of 16 bytes each
+#define AES_KEYEXP_SIZE (Nb * (AES_MAX_ROUNDS + 1) * 4)
+
+// The kernels take the round count as their last argument and are forced inline, so
+// AES_SPECIALIZE instantiates one copy per key size with a constant count the compiler can
+// unroll. It is meant for entry points, outside the block loops, so the key size is only
+// looked at once per call
+#if defined(__GNUC__)
+#define AES_KERNEL static inline __attribute__((always_inline))
+#define AES_UNROLL _Pragma("GCC unroll 14")
+#else
+#define AES_KERNEL static inline
+#define AES_UNROLL
+#endif
+#define AES_SPECIALIZE(rounds, kernel, ...) \
+    do                                      \
+    {                                       \
+        switch (rounds)                     \
+        {                                   \
+        case 10:                            \
+            kernel(__VA_ARGS__, 10);        \
+            break;                          \
+        case 12:                            \
+            kernel(__VA_ARGS__, 12);        \
+            break;                          \
+        default:                            \
+            kernel(__VA_ARGS__, 14);        \
+            break;                          \
+        }                                   \
+    } while (0)
+
+// Structure to hold the expanded AES key, computed once and reused for every block
+typedef struct
+{
+    uint8_t RoundKey[AES_KEYEXP_SIZE];    // Encryption schedule
+    uint8_t InvRoundKey[AES_KEYEXP_SIZE]; // Decryption schedule for the equivalent inverse cipher
+#if AES_TTABLE
+    uint32_t rk[Nb * (AES_MAX_ROUNDS + 1)];  // Encryption schedule as big-endian column words
+    uint32_t drk[Nb * (AES_MAX_ROUNDS + 1)]; // Decryption schedule as big-endian column words
+#endif
+#if AES_BITSLICE
+    uint64_t bsk[8 * (AES_MAX_ROUNDS + 1)]; // Encryption schedule with each round key bitsliced over four blocks
+#endif
+    int rounds;   // 10, 12 or 14, set by aes_keysetup from the key size
+    int aesni;    // Non-zero when the schedules were expanded for the AES-NI engine
+    int bitslice; // Non-zero when the bitsliced engine is used
+} aes_ctx;
+
+// Settings shared by every file in a run: the key is expanded once
+typedef struct
+{
+    aes_ctx ctx;
+    const uint8_t *nonce; // CTR nonce or 12-byte GCM IV, or NULL for padded ECB
+    int encrypt;
+    pool *workers;        // Pool that large ECB and CTR buffers are split across (NULL = one thread)
+    size_t buffer_size;   // Streaming buffer size (0 = STREAM_DEFAULT_BUFFER)
+    stream_arena *arena;  // Direct I/O buffers, or NULL to go through the page cache
+    const uint8_t *header; // GCM: written ahead of the ciphertext, or skipped ahead of it when decrypting
+    size_t header_length;
+} aes_job;
+
+// Function to bypass the AES-NI engine for keys expanded afterwards, even when the CPU supports it
+void aes_set_portable(int portable);
+
+// Function to choose between the bitsliced engine (1, the default) and the table engine (0) for
+// software keys expanded afterwards; it has no effect when AES_BITSLICE is 0
+void aes_set_bitslice(int bitslice);
+
+// Function to report which block engine aes_keysetup will select
+const char *aes_engine_name(void);
+
+// Function to expand a 16, 24 or 32-byte key once into the encryption and decryption schedules;
+// returns -1 for any other key length
+int aes_keysetup(aes_ctx *ctx, const uint8_t *key, size_t key_len);
+
+// Functions to encrypt or decrypt one 16-byte block, or `blocks` consecutive blocks (ECB)
+void aes_encrypt_block(const aes_ctx *ctx, const uint8_t *input, uint8_t *output);
+void aes_decrypt_block(const aes_ctx *ctx, const uint8_t *input, uint8_t *output);
+void aes_encrypt_blocks(const aes_ctx *ctx, const uint8_t *input, uint8_t *output, size_t blocks);
+void aes_decrypt_blocks(const aes_ctx *ctx, const uint8_t *input, uint8_t *output, size_t blocks);
+
+// Function to encrypt or decrypt with AES in counter mode, starting at block `counter`
+void aes_ctr_crypt(const aes_ctx *ctx, const uint8_t *nonce, uint64_t counter,
+                   const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to encrypt or decrypt a buffer across the worker pool, in CTR mode from block `counter`
+// when `nonce` is set and ECB otherwise (`length` must then be a whole number of blocks). The
+// output is identical to aes_ctr_crypt or aes_encrypt_blocks/aes_decrypt_blocks on one thread
+void aes_crypt_parallel(pool *workers, const aes_ctx *ctx, const uint8_t *nonce, uint64_t counter, int encrypt,
+                        const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to check the block engine against the FIPS-197 known-answer vectors; 1 when it passes
+int aes_self_test(void);
+
+// Functions to add PKCS#7 padding in place (the buffer needs room for one more block) and to
+// return the unpadded length, or STREAM_ERROR when the padding is malformed
+size_t aes_pad(uint8_t *buffer, size_t length);
+size_t aes_unpad(const uint8_t *buffer, size_t length);
+
+// Function to encrypt or decrypt a file in place; returns 0 on success
+int aes_process_file(const aes_job *job, const char *filename);
+
+#endif
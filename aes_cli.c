@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "filecrypt.h"
+
+// Function to parse OFFSET:LENGTH, each a size such as 0, 4096 or 64M; returns 0 when valid
+static int parse_range(const char *text, uint64_t *offset, uint64_t *length)
+{
+    char first[32];
+    const char *colon = strchr(text, ':');
+
+    if (!colon || (size_t)(colon - text) >= sizeof(first))
+    {
+        return -1;
+    }
+    memcpy(first, text, colon - text);
+    first[colon - text] = '\0';
+    *offset = strcmp(first, "0") == 0 ? 0 : filecrypt_parse_size(first);
+    *length = filecrypt_parse_size(colon + 1);
+    return (*offset == 0 && strcmp(first, "0") != 0) || *length == 0 ? -1 : 0;
+}
+
+// Main function to handle command-line arguments and run the files through libfilecrypt
+int main(int argc, char *argv[])
+{
+    filecrypt_options options = {0};
+    filecrypt_algorithm algorithm = FILECRYPT_AES_ECB;
+    const char *nonce = NULL;
+    const char *files_from = NULL;
+    const char *rsa_key = NULL;
+    int self_test = 0;
+    const char *range = NULL;
+    uint64_t range_offset = 0, range_length = 0;
+    int stats = 0; // 1 for --stats, 2 for --stats-json
+    int argi = 1;
+
+    // Parse leading options
+    while (argi < argc && strncmp(argv[argi], "--", 2) == 0)
+    {
+        if (strcmp(argv[argi], "--portable") == 0)
+        {
+            filecrypt_set_portable(1);
+        }
+        else if (strcmp(argv[argi], "--stats") == 0 || strcmp(argv[argi], "--stats-json") == 0)
+        {
+            stats = strcmp(argv[argi], "--stats") == 0 ? 1 : 2;
+        }
+        else if (strcmp(argv[argi], "--self-test") == 0)
+        {
+            self_test = 1;
+        }
+        else if ((strcmp(argv[argi], "--ctr") == 0 || strcmp(argv[argi], "--gcm") == 0) && argi + 1 < argc)
+        {
+            if (nonce)
+            {
+                fprintf(stderr, "--ctr and --gcm cannot be combined\n");
+                return 1;
+            }
+            algorithm = strcmp(argv[argi], "--gcm") == 0 ? FILECRYPT_AES_GCM : FILECRYPT_AES_CTR;
+            nonce = argv[++argi];
+        }
+        else if (strcmp(argv[argi], "--buffer-size") == 0 && argi + 1 < argc)
+        {
+            options.buffer_size = filecrypt_parse_size(argv[++argi]);
+            if (options.buffer_size == 0)
+            {
+                fprintf(stderr, "Invalid buffer size: %s\n", argv[argi]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--direct-io") == 0 || strcmp(argv[argi], "--huge-pages") == 0)
+        {
+            options.direct_io = 1;
+            options.huge_pages |= strcmp(argv[argi], "--huge-pages") == 0;
+        }
+        else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+        {
+            options.threads = atoi(argv[++argi]);
+            if (options.threads <= 0)
+            {
+                fprintf(stderr, "Thread count must be a positive number\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--files-from") == 0 && argi + 1 < argc)
+        {
+            files_from = argv[++argi];
+        }
+        else if (strcmp(argv[argi], "--rsa") == 0 && argi + 1 < argc)
+        {
+            rsa_key = argv[++argi];
+        }
+        else if (strcmp(argv[argi], "--container") == 0)
+        {
+            options.container = 1;
+        }
+        else if (strcmp(argv[argi], "--chunk-size") == 0 && argi + 1 < argc)
+        {
+            options.chunk_size = filecrypt_parse_size(argv[++argi]);
+            if (options.chunk_size == 0)
+            {
+                fprintf(stderr, "Invalid chunk size: %s\n", argv[argi]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--range") == 0 && argi + 1 < argc)
+        {
+            range = argv[++argi];
+            if (parse_range(range, &range_offset, &range_length) != 0)
+            {
+                fprintf(stderr, "Invalid range (expected OFFSET:LENGTH): %s\n", range);
+                return 1;
+            }
+            options.container = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+            return 1;
+        }
+        argi++;
+    }
+
+    // Run the known-answer tests for the engines selected on this host
+    if (self_test)
+    {
+        int ok = filecrypt_self_test(FILECRYPT_AES_ECB) == 0;
+        int gcm_ok = filecrypt_self_test(FILECRYPT_AES_GCM) == 0;
+        printf("AES self-test (%s) %s\n", filecrypt_engine_name(FILECRYPT_AES_ECB), ok ? "passed" : "FAILED");
+        printf("AES-GCM self-test (%s) %s\n", filecrypt_engine_name(FILECRYPT_AES_GCM), gcm_ok ? "passed" : "FAILED");
+        return ok && gcm_ok ? 0 : 1;
+    }
+
+    // Paths come first; the key (unless it comes from --rsa) and mode are always the last arguments
+    int trailing = rsa_key ? 1 : 2;
+    if (argc - argi < (files_from ? trailing : trailing + 1))
+    {
+        fprintf(stderr, "Usage: %s [options] <file|directory|->... <key> <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --files-from <list|-> <key> <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --rsa <key-file> <file|directory|->... <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s --gcm <nonce> --range OFFSET:LENGTH <container> <key> decrypt\n", argv[0]);
+        fprintf(stderr, "       %s [--portable] --self-test\n", argv[0]);
+        fprintf(stderr, "Options: --portable --ctr <nonce> --gcm <nonce> --container --chunk-size N[K|M|G]\n");
+        fprintf(stderr, "         --threads N --buffer-size N[K|M|G] --direct-io --huge-pages --rsa <key-file>\n");
+        fprintf(stderr, "         --stats --stats-json\n");
+        return 1;
+    }
+
+    const char *key = rsa_key ? NULL : argv[argc - 2];
+    const char *mode = argv[argc - 1];
+    size_t key_len = key ? strlen(key) : 0;
+
+    // Ensure the key length is correct; it selects AES-128, AES-192 or AES-256
+    if (key && key_len != FILECRYPT_AES_KEY_SIZE && key_len != FILECRYPT_AES_192_KEY_SIZE &&
+        key_len != FILECRYPT_AES_256_KEY_SIZE)
+    {
+        fprintf(stderr, "Key must be 16, 24 or 32 characters long\n");
+        return 1;
+    }
+
+    // With an RSA key every file gets its own random AES-256 key and is sealed with GCM
+    if (rsa_key && (nonce || options.container))
+    {
+        fprintf(stderr, "--rsa picks the key per file and uses AES-GCM; drop --ctr, --gcm, --container and --range\n");
+        return 1;
+    }
+
+    // Containers are written and read a chunk at a time through the page cache
+    if (options.direct_io && options.container)
+    {
+        fprintf(stderr, "--direct-io cannot be combined with --container or --range\n");
+        return 1;
+    }
+
+    if (strcmp(mode, "encrypt") != 0 && strcmp(mode, "decrypt") != 0)
+    {
+        fprintf(stderr, "Mode must be encrypt or decrypt\n");
+        return 1;
+    }
+
+    if (nonce && strlen(nonce) != FILECRYPT_NONCE_SIZE)
+    {
+        fprintf(stderr, "Nonce must be exactly 8 characters long\n");
+        return 1;
+    }
+
+    // Containers are built from authenticated chunks, and a range is read from a single container
+    if (options.container && algorithm != FILECRYPT_AES_GCM)
+    {
+        fprintf(stderr, "--container and --range need --gcm\n");
+        return 1;
+    }
+    if (range && (strcmp(mode, "decrypt") != 0 || files_from || argc - trailing - argi != 1))
+    {
+        fprintf(stderr, "--range decrypts part of one container: give a single file and decrypt\n");
+        return 1;
+    }
+
+    // Time the run from the key setup on, and count the CPU work of the threads started after it
+    if (stats)
+    {
+        filecrypt_stats_enable(1);
+    }
+
+    // Expand the key (or load the RSA key) once and share one worker pool between all files
+    filecrypt_mode direction = strcmp(mode, "encrypt") == 0 ? FILECRYPT_ENCRYPT : FILECRYPT_DECRYPT;
+    filecrypt_job *job;
+    if (rsa_key)
+    {
+        job = filecrypt_job_create_hybrid(FILECRYPT_AES_GCM, direction, rsa_key, &options);
+    }
+    else
+    {
+        job = filecrypt_job_create(algorithm, direction, (const uint8_t *)key, key_len,
+                                   (const uint8_t *)nonce, nonce ? FILECRYPT_NONCE_SIZE : 0, &options);
+    }
+    if (!job)
+    {
+        perror("Failed to set up the job");
+        return 1;
+    }
+
+    // Decrypt just the requested range of one container to standard output, or process the files
+    int failed;
+    if (range)
+    {
+        failed = filecrypt_job_extract(job, argv[argi], range_offset, range_length, STDOUT_FILENO) != 0;
+    }
+    else
+    {
+        failed = filecrypt_job_run(job, (const char *const *)argv + argi, argc - trailing - argi, files_from) != 0;
+    }
+    filecrypt_job_free(job);
+
+    // The workers have been joined, so their CPU counts are included
+    if (stats)
+    {
+        filecrypt_stats_print(stderr, stats == 2);
+    }
+    return failed;
+}
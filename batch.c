@@ -0,0 +1,200 @@
+#define _XOPEN_SOURCE 700
+
+#include "batch.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Function to append one file to the list
+static int batch_push(batch *b, const char *path, off_t size)
+{
+    if (b->count == b->capacity)
+    {
+        size_t capacity = b->capacity ? b->capacity * 2 : 256;
+        batch_entry *entries = realloc(b->entries, capacity * sizeof(batch_entry));
+        if (!entries)
+        {
+            perror("Failed to allocate file list");
+            return -1;
+        }
+        b->entries = entries;
+        b->capacity = capacity;
+    }
+    b->entries[b->count].path = strdup(path);
+    if (!b->entries[b->count].path)
+    {
+        perror("Failed to allocate file list");
+        return -1;
+    }
+    b->entries[b->count].size = size;
+    b->count++;
+    return 0;
+}
+
+// nftw has no user argument, so the directory walk collects into this list
+static batch *walk_target = NULL;
+
+// nftw callback: keep regular files, report unreadable entries
+static int walk_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)ftw;
+    if (type == FTW_F && S_ISREG(st->st_mode))
+    {
+        return batch_push(walk_target, path, st->st_size);
+    }
+    if (type == FTW_DNR || type == FTW_NS)
+    {
+        fprintf(stderr, "%s: cannot read, skipped\n", path);
+    }
+    return 0;
+}
+
+// Function to add a regular file, or every regular file below a directory; returns 0 on success
+int batch_add_path(batch *b, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (S_ISREG(st.st_mode))
+    {
+        return batch_push(b, path, st.st_size);
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        fprintf(stderr, "%s: not a regular file or directory\n", path);
+        return -1;
+    }
+
+    // Symbolic links are not followed, so a link cannot pull files from outside the tree
+    walk_target = b;
+    int result = nftw(path, walk_entry, 64, FTW_PHYS);
+    walk_target = NULL;
+    if (result < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    }
+    return result == 0 ? 0 : -1;
+}
+
+// Function to add every path named on its own line in `list`; returns 0 on success
+int batch_add_list(batch *b, FILE *list)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    int result = 0;
+
+    while ((length = getline(&line, &capacity, list)) >= 0)
+    {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+        if (length > 0 && batch_add_path(b, line) != 0)
+        {
+            result = -1;
+        }
+    }
+    free(line);
+    return result;
+}
+
+// State shared by every task of one batch_run
+typedef struct
+{
+    batch_fn fn;
+    void *arg;
+    pthread_mutex_t lock;
+    size_t failed;
+} batch_shared;
+
+// One task: a run of consecutive entries
+typedef struct
+{
+    batch_shared *shared;
+    const batch_entry *first;
+    size_t count;
+} batch_task;
+
+// Task entry point: process each file of the group in turn
+static void batch_task_run(void *arg)
+{
+    batch_task *task = (batch_task *)arg;
+    size_t failed = 0;
+
+    for (size_t i = 0; i < task->count; i++)
+    {
+        if (task->shared->fn(task->shared->arg, task->first[i].path) != 0)
+        {
+            failed++;
+        }
+    }
+    if (failed)
+    {
+        pthread_mutex_lock(&task->shared->lock);
+        task->shared->failed += failed;
+        pthread_mutex_unlock(&task->shared->lock);
+    }
+}
+
+// Function to run `fn` on every file on the pool, grouping small files into one task and giving
+// large files their own (their cipher can split further across the same pool)
+size_t batch_run(batch *b, pool *p, batch_fn fn, void *arg)
+{
+    batch_shared shared;
+    pool_group group = POOL_GROUP_INIT;
+    batch_task *tasks = malloc((b->count ? b->count : 1) * sizeof(batch_task));
+    size_t ntasks = 0, i = 0;
+
+    if (!tasks)
+    {
+        perror("Failed to allocate tasks");
+        return b->count;
+    }
+    shared.fn = fn;
+    shared.arg = arg;
+    shared.failed = 0;
+    pthread_mutex_init(&shared.lock, NULL);
+
+    while (i < b->count)
+    {
+        batch_task *task = &tasks[ntasks++];
+        off_t bytes = 0;
+
+        task->shared = &shared;
+        task->first = &b->entries[i];
+        task->count = 0;
+        do
+        {
+            bytes += b->entries[i].size;
+            task->count++;
+            i++;
+        } while (i < b->count && task->count < BATCH_GROUP_FILES && bytes < BATCH_GROUP_BYTES &&
+                 b->entries[i].size < BATCH_LARGE_FILE && task->first->size < BATCH_LARGE_FILE);
+        pool_submit(p, &group, batch_task_run, task);
+    }
+    pool_wait(p, &group);
+
+    pthread_mutex_destroy(&shared.lock);
+    free(tasks);
+    return shared.failed;
+}
+
+// Function to free the collected paths
+void batch_free(batch *b)
+{
+    for (size_t i = 0; i < b->count; i++)
+    {
+        free(b->entries[i].path);
+    }
+    free(b->entries);
+    b->entries = NULL;
+    b->count = b->capacity = 0;
+}
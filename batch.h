@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "pool.h"
+
+#define BATCH_GROUP_BYTES (4 << 20) // Small files are grouped into tasks of about this many bytes
+#define BATCH_GROUP_FILES 64        // ... or at most this many files
+#define BATCH_LARGE_FILE (8 << 20)  // Files from this size up get a task of their own
+
+// Callback that encrypts or decrypts one file; returns 0 on success
+typedef int (*batch_fn)(void *arg, const char *path);
+
+// One file to process and its size at the time it was listed
+typedef struct
+{
+    char *path;
+    off_t size;
+} batch_entry;
+
+// List of files collected from the command line, directories and file lists
+typedef struct
+{
+    batch_entry *entries;
+    size_t count, capacity;
+} batch;
+
+// Function to add a regular file, or every regular file below a directory; returns 0 on success
+int batch_add_path(batch *b, const char *path);
+
+// Function to add every path named on its own line in `list`; returns 0 on success
+int batch_add_list(batch *b, FILE *list);
+
+// Function to run `fn` on every file on the pool, grouping small files into one task and giving
+// large files their own; returns the number of files that failed
+size_t batch_run(batch *b, pool *p, batch_fn fn, void *arg);
+
+// Function to free the collected paths
+void batch_free(batch *b);
+
+#endif
@@ -0,0 +1,603 @@
+// Throughput and latency benchmark for the AES and ChaCha20 engines and file paths.
+// The engine sources are built into this program directly so internal backends (the byte-wise
+// rounds, every ChaCha20 kernel) can be driven in-process, not only the ones libfilecrypt selects.
+#include "aes.c"
+#include "chacha20.c"
+#include "gcm.c"
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+#define BENCH_MIN_SIZE 64                // Smallest message size
+#define BENCH_LATENCY_SAMPLES 1000       // Individually timed calls per measurement
+#define BENCH_MAX_CALL_SECONDS 5.0       // Sizes whose single call would take longer are skipped
+#define BENCH_POOL_THREADS 8             // Workers of the pool stress test, more than cores so they race
+#define BENCH_POOL_ROUNDS 100            // Groups of fan-out tasks the stress test waits for
+#define BENCH_POOL_FANOUT 64             // Tasks per group, and leaves per fan-out task
+
+// A benchmark: `op` transforms `length` bytes of `buffer` once per call
+typedef struct
+{
+    const char *name;
+    const char *backend;
+    void (*op)(void *arg, uint8_t *buffer, size_t length);
+    void *arg;
+    int file; // Non-zero when the op works on a file of `length` bytes instead of the buffer
+} bench_case;
+
+// Options from the command line
+static double bench_min_time = 0.2;
+static size_t bench_max_size = (size_t)1 << 30;
+static const char *bench_filter = NULL;
+static const char *bench_dir = ".";
+static int bench_json = 0;
+
+// Keys and contexts shared by the cases
+static aes_ctx bench_aes_hw, bench_aes_sw, bench_aes_bs; // AES-NI, table and bitsliced engines
+static aes_ctx bench_aes256_hw, bench_aes256_sw, bench_aes256_bs; // The same with an AES-256 key
+static aes_gcm_ctx bench_gcm_hw, bench_gcm_sw; // Hash keys for the GHASH-only cases
+static const uint8_t bench_nonce[8] = {'b', 'e', 'n', 'c', 'h', 'n', 'c', 'e'};
+static const uint8_t bench_nonce_iv[GCM_IV_SIZE] = "bench-nonce";
+static chacha20_ctx bench_chacha;
+static const uint8_t bench_chacha_key[32] = "bench-chacha20-key-32-bytes-long";
+static char bench_file[4096];
+
+// Function to read a monotonic clock in seconds
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Function to read the time-stamp counter (reference cycles), or 0 where there is none
+static uint64_t bench_cycles(void)
+{
+#if BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Byte-wise reference engine: Cipher on every block, straight from the round functions
+static void op_cipher(void *arg, uint8_t *buffer, size_t length)
+{
+    const aes_ctx *ctx = (const aes_ctx *)arg;
+    state_t state;
+    for (size_t i = 0; i < length; i += AES_BLOCK_SIZE)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            state[j % 4][j / 4] = buffer[i + j];
+        }
+        Cipher(&state, ctx->RoundKey, ctx->rounds);
+        for (int j = 0; j < 16; j++)
+        {
+            buffer[i + j] = state[j % 4][j / 4];
+        }
+    }
+}
+
+// Byte-wise reference engine: InvCipher on every block
+static void op_inv_cipher(void *arg, uint8_t *buffer, size_t length)
+{
+    const aes_ctx *ctx = (const aes_ctx *)arg;
+    state_t state;
+    for (size_t i = 0; i < length; i += AES_BLOCK_SIZE)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            state[j % 4][j / 4] = buffer[i + j];
+        }
+        InvCipher(&state, ctx->InvRoundKey, ctx->rounds);
+        for (int j = 0; j < 16; j++)
+        {
+            buffer[i + j] = state[j % 4][j / 4];
+        }
+    }
+}
+
+static void op_ecb_encrypt(void *arg, uint8_t *buffer, size_t length)
+{
+    aes_encrypt_blocks((const aes_ctx *)arg, buffer, buffer, length / AES_BLOCK_SIZE);
+}
+
+static void op_ecb_decrypt(void *arg, uint8_t *buffer, size_t length)
+{
+    aes_decrypt_blocks((const aes_ctx *)arg, buffer, buffer, length / AES_BLOCK_SIZE);
+}
+
+static void op_ctr(void *arg, uint8_t *buffer, size_t length)
+{
+    aes_ctr_crypt((const aes_ctx *)arg, bench_nonce, 0, buffer, buffer, length);
+}
+
+// Scalar keystream generation with chacha20_block, one 64-byte block per call
+static void op_chacha20_block(void *arg, uint8_t *buffer, size_t length)
+{
+    chacha20_ctx ctx = *(const chacha20_ctx *)arg;
+    for (size_t i = 0; i < length; i += 64)
+    {
+        chacha20_block(&ctx, (uint32_t *)(buffer + i));
+        chacha20_advance(&ctx, 1);
+    }
+}
+
+// chacha20_encrypt through one specific kernel
+static void op_chacha20_encrypt(void *arg, uint8_t *buffer, size_t length)
+{
+    chacha20_ctx ctx = bench_chacha;
+    chacha20_kernel_in_use = (const chacha20_kernel *)arg;
+    chacha20_encrypt(&ctx, buffer, buffer, length);
+}
+
+// Poly1305 alone over the buffer
+static void op_poly1305(void *arg, uint8_t *buffer, size_t length)
+{
+    poly1305_ctx ctx;
+    uint8_t tag[POLY1305_TAG_SIZE];
+    poly1305_init(&ctx, (const uint8_t *)arg);
+    poly1305_update(&ctx, buffer, length);
+    poly1305_finish(&ctx, tag);
+}
+
+// GHASH alone over the buffer, with the engine the context was set up for
+static void op_ghash(void *arg, uint8_t *buffer, size_t length)
+{
+    ghash_ctx ctx = ((const aes_gcm_ctx *)arg)->ghash;
+    ghash_blocks(&ctx, buffer, length / AES_BLOCK_SIZE);
+}
+
+// AES-GCM encryption in place, tag included
+static void op_gcm(void *arg, uint8_t *buffer, size_t length)
+{
+    aes_gcm_ctx ctx;
+    uint8_t tag[GCM_TAG_SIZE];
+    aes_gcm_init(&ctx, (const aes_ctx *)arg, bench_nonce_iv, 1);
+    aes_gcm_update(&ctx, buffer, buffer, length);
+    aes_gcm_final(&ctx, tag);
+}
+
+// ChaCha20-Poly1305 encryption in place, tag included, through one specific kernel
+static void op_chacha20_poly1305(void *arg, uint8_t *buffer, size_t length)
+{
+    static const uint8_t nonce[CHACHA20_POLY1305_NONCE_SIZE] = "bench-nonce";
+    chacha20_poly1305_ctx ctx;
+    uint8_t tag[CHACHA20_POLY1305_TAG_SIZE];
+    chacha20_kernel_in_use = (const chacha20_kernel *)arg;
+    chacha20_poly1305_init(&ctx, bench_chacha_key, nonce, 1);
+    chacha20_poly1305_update(&ctx, buffer, buffer, length);
+    chacha20_poly1305_final(&ctx, tag);
+}
+
+// AES-CTR over the whole file path: read, encrypt, write, fsync and rename
+static void op_aes_file(void *arg, uint8_t *buffer, size_t length)
+{
+    (void)buffer;
+    (void)length;
+    aes_process_file((const aes_job *)arg, bench_file);
+}
+
+// ChaCha20 over the whole file path
+static void op_chacha20_file(void *arg, uint8_t *buffer, size_t length)
+{
+    (void)buffer;
+    (void)length;
+    chacha20_process_file((const chacha20_job_settings *)arg, bench_file);
+}
+
+// Function to create the scratch file for file-path cases, filled from `buffer`
+static int bench_make_file(const uint8_t *buffer, size_t size)
+{
+    snprintf(bench_file, sizeof(bench_file), "%s/bench.tmp.XXXXXX", bench_dir);
+    int fd = mkstemp(bench_file);
+    if (fd < 0)
+    {
+        perror("Failed to create benchmark file");
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = write(fd, buffer + done, size - done);
+        if (n <= 0)
+        {
+            perror("Failed to write benchmark file");
+            close(fd);
+            unlink(bench_file);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+    return 0;
+}
+
+// qsort comparison for latency samples
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to return percentile `p` (0-100) of sorted samples
+static double percentile(const double *sorted, size_t count, double p)
+{
+    size_t index = (size_t)(p / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+// Function to measure one case at one size and print the result; returns the throughput in MB/s
+static double bench_run(const bench_case *c, uint8_t *buffer, size_t size, double *samples)
+{
+    uint64_t calls = 0, batch = 1;
+    double start, elapsed;
+    uint64_t cycles;
+
+    if (c->file && bench_make_file(buffer, size) != 0)
+    {
+        return 0;
+    }
+
+    // Warm up caches and page in the buffer
+    c->op(c->arg, buffer, size);
+
+    // Throughput: untimed calls in growing batches until the minimum time has passed
+    start = bench_now();
+    cycles = bench_cycles();
+    for (;;)
+    {
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            c->op(c->arg, buffer, size);
+        }
+        calls += batch;
+        elapsed = bench_now() - start;
+        if (elapsed >= bench_min_time)
+        {
+            break;
+        }
+        if (batch < (1u << 20))
+        {
+            batch *= 2;
+        }
+    }
+    cycles = bench_cycles() - cycles;
+
+    // Latency: individually timed calls (including the clock overhead of a few tens of ns)
+    size_t nsamples = calls < BENCH_LATENCY_SAMPLES ? (size_t)calls : BENCH_LATENCY_SAMPLES;
+    for (size_t i = 0; i < nsamples; i++)
+    {
+        double t = bench_now();
+        c->op(c->arg, buffer, size);
+        samples[i] = (bench_now() - t) * 1e9;
+    }
+    qsort(samples, nsamples, sizeof(double), compare_double);
+
+    if (c->file)
+    {
+        unlink(bench_file);
+    }
+
+    double mbps = (double)size * calls / elapsed / 1e6;
+    double cpb = BENCH_HAVE_TSC ? (double)cycles / ((double)size * calls) : 0;
+    if (bench_json)
+    {
+        printf("{\"benchmark\": \"%s\", \"backend\": \"%s\", \"size\": %zu, \"calls\": %llu, "
+               "\"mb_per_s\": %.2f, \"cycles_per_byte\": %.3f, \"latency_ns\": {\"p50\": %.0f, "
+               "\"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f}}\n",
+               c->name, c->backend, size, (unsigned long long)calls, mbps, cpb,
+               percentile(samples, nsamples, 50), percentile(samples, nsamples, 90),
+               percentile(samples, nsamples, 99), samples[nsamples - 1]);
+    }
+    else
+    {
+        printf("%-22s %-10s %11zu %11.1f %9.2f %12.0f %12.0f %12.0f\n", c->name, c->backend, size, mbps, cpb,
+               percentile(samples, nsamples, 50), percentile(samples, nsamples, 99), samples[nsamples - 1]);
+    }
+    fflush(stdout);
+    return mbps;
+}
+
+// Shared state of the pool stress test
+typedef struct
+{
+    pool *workers;
+    uint64_t ran;
+} bench_pool_state;
+
+// Leaf task of the pool stress test
+static void bench_pool_leaf(void *arg)
+{
+    __atomic_fetch_add(&((bench_pool_state *)arg)->ran, 1, __ATOMIC_RELAXED);
+}
+
+// Task that queues leaves on its worker's own deque, where idle workers steal them, and waits
+static void bench_pool_fan_out(void *arg)
+{
+    bench_pool_state *state = (bench_pool_state *)arg;
+    pool_group group = POOL_GROUP_INIT;
+
+    for (int i = 0; i < BENCH_POOL_FANOUT; i++)
+    {
+        pool_submit(state->workers, &group, bench_pool_leaf, state);
+    }
+    pool_wait(state->workers, &group);
+    bench_pool_leaf(state);
+}
+
+// Function to stress the pool with many tiny tasks that are stolen while others are queued, then
+// check that every task ran and that the pool sleeps once idle (miscounted queues leave the
+// workers spinning, and such a pool cannot be stopped, so it is left running)
+static int bench_pool_stress(void)
+{
+    bench_pool_state state = {pool_create(BENCH_POOL_THREADS), 0};
+    struct timespec before, after, pause = {0, 100000000};
+
+    if (!state.workers)
+    {
+        return 0;
+    }
+    for (int round = 0; round < BENCH_POOL_ROUNDS; round++)
+    {
+        pool_group group = POOL_GROUP_INIT;
+        for (int i = 0; i < BENCH_POOL_FANOUT; i++)
+        {
+            pool_submit(state.workers, &group, bench_pool_fan_out, &state);
+        }
+        pool_wait(state.workers, &group);
+    }
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &before);
+    nanosleep(&pause, NULL);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &after);
+    double idle = (after.tv_sec - before.tv_sec) + (after.tv_nsec - before.tv_nsec) / 1e9;
+    if (idle > 0.02)
+    {
+        fprintf(stderr, "Pool stress test FAILED: idle workers used %.0f ms of CPU in 100 ms\n", idle * 1e3);
+        return 0;
+    }
+    pool_destroy(state.workers);
+    if (state.ran != (uint64_t)BENCH_POOL_ROUNDS * BENCH_POOL_FANOUT * (BENCH_POOL_FANOUT + 1))
+    {
+        fprintf(stderr, "Pool stress test FAILED: %llu tasks ran\n", (unsigned long long)state.ran);
+        return 0;
+    }
+    return 1;
+}
+
+// Function to run the known-answer tests for every backend, and the pool stress test, before
+// anything is timed
+static int bench_self_test(void)
+{
+    int ok = 1;
+
+    aes_set_portable(1);
+    for (int bitslice = 0; bitslice <= AES_BITSLICE; bitslice++)
+    {
+        aes_set_bitslice(bitslice);
+        if (!aes_self_test() || !aes_gcm_self_test())
+        {
+            fprintf(stderr, "AES self-test (%s) FAILED\n", aes_gcm_engine_name());
+            ok = 0;
+        }
+    }
+    aes_set_portable(0);
+    if (!aes_self_test() || !aes_gcm_self_test())
+    {
+        fprintf(stderr, "AES self-test (%s) FAILED\n", aes_gcm_engine_name());
+        ok = 0;
+    }
+
+    for (size_t i = 0; i < CHACHA20_KERNEL_COUNT; i++)
+    {
+        if (!chacha20_kernel_supported(&chacha20_kernels[i]))
+        {
+            continue;
+        }
+        chacha20_kernel_in_use = &chacha20_kernels[i];
+        if (!chacha20_self_test() || !chacha20_poly1305_self_test())
+        {
+            fprintf(stderr, "ChaCha20 self-test (%s) FAILED\n", chacha20_kernels[i].name);
+            ok = 0;
+        }
+    }
+    chacha20_kernel_in_use = NULL;
+
+    if (!bench_pool_stress())
+    {
+        ok = 0;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint8_t aes_key[16] = "bench-aes-key-16";
+    static const uint8_t aes256_key[32] = "bench-aes-256-key-32-bytes-long!";
+    bench_case cases[40];
+    size_t ncases = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            bench_json = 1;
+        }
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+        {
+            bench_min_time = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+        {
+            bench_max_size = stream_parse_size(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            bench_filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            bench_dir = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--json] [--min-time S] [--max-size N[K|M|G]] [--filter TEXT] [--dir DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bench_max_size < BENCH_MIN_SIZE || bench_min_time <= 0)
+    {
+        fprintf(stderr, "Invalid --max-size or --min-time\n");
+        return 1;
+    }
+
+    if (!bench_self_test())
+    {
+        return 1;
+    }
+
+    // Contexts for every backend this host can run
+    aes_set_portable(1);
+    aes_set_bitslice(0);
+    aes_keysetup(&bench_aes_sw, aes_key, sizeof(aes_key));
+    aes_keysetup(&bench_aes256_sw, aes256_key, sizeof(aes256_key));
+    aes_set_bitslice(1);
+    aes_keysetup(&bench_aes_bs, aes_key, sizeof(aes_key));
+    aes_keysetup(&bench_aes256_bs, aes256_key, sizeof(aes256_key));
+    aes_set_portable(0);
+    aes_keysetup(&bench_aes_hw, aes_key, sizeof(aes_key));
+    aes_keysetup(&bench_aes256_hw, aes256_key, sizeof(aes256_key));
+    aes_gcm_init(&bench_gcm_sw, &bench_aes_sw, bench_nonce_iv, 1);
+    aes_gcm_init(&bench_gcm_hw, &bench_aes_hw, bench_nonce_iv, 1);
+    chacha20_keysetup(&bench_chacha, bench_chacha_key, bench_nonce);
+
+    aes_job aes_file_job;
+    aes_file_job.ctx = bench_aes_hw;
+    aes_file_job.nonce = bench_nonce;
+    chacha20_job_settings chacha_file_job;
+    chacha_file_job.initial = bench_chacha;
+    chacha_file_job.workers = pool_create(0);
+    aes_file_job.encrypt = 1;
+    aes_file_job.workers = chacha_file_job.workers;
+    aes_file_job.buffer_size = 0;
+    chacha_file_job.buffer_size = 0;
+    chacha_file_job.use_mmap = 0;
+
+    const char *sw = AES_TTABLE ? "t-table" : "byte-wise";
+    cases[ncases++] = (bench_case){"aes-128-ecb-encrypt", "byte-wise", op_cipher, &bench_aes_sw, 0};
+    cases[ncases++] = (bench_case){"aes-128-ecb-decrypt", "byte-wise", op_inv_cipher, &bench_aes_sw, 0};
+    if (AES_TTABLE)
+    {
+        cases[ncases++] = (bench_case){"aes-128-ecb-encrypt", sw, op_ecb_encrypt, &bench_aes_sw, 0};
+        cases[ncases++] = (bench_case){"aes-128-ecb-decrypt", sw, op_ecb_decrypt, &bench_aes_sw, 0};
+    }
+    cases[ncases++] = (bench_case){"aes-128-ctr", sw, op_ctr, &bench_aes_sw, 0};
+    if (bench_aes_bs.bitslice)
+    {
+        cases[ncases++] = (bench_case){"aes-128-ecb-encrypt", "bitsliced", op_ecb_encrypt, &bench_aes_bs, 0};
+        cases[ncases++] = (bench_case){"aes-128-ecb-decrypt", "bitsliced", op_ecb_decrypt, &bench_aes_bs, 0};
+        cases[ncases++] = (bench_case){"aes-128-ctr", "bitsliced", op_ctr, &bench_aes_bs, 0};
+    }
+    if (bench_aes_hw.aesni)
+    {
+        cases[ncases++] = (bench_case){"aes-128-ecb-encrypt", "aes-ni", op_ecb_encrypt, &bench_aes_hw, 0};
+        cases[ncases++] = (bench_case){"aes-128-ecb-decrypt", "aes-ni", op_ecb_decrypt, &bench_aes_hw, 0};
+        cases[ncases++] = (bench_case){"aes-128-ctr", "aes-ni", op_ctr, &bench_aes_hw, 0};
+    }
+    cases[ncases++] = (bench_case){"aes-256-ctr", sw, op_ctr, &bench_aes256_sw, 0};
+    if (bench_aes256_bs.bitslice)
+    {
+        cases[ncases++] = (bench_case){"aes-256-ctr", "bitsliced", op_ctr, &bench_aes256_bs, 0};
+    }
+    if (bench_aes256_hw.aesni)
+    {
+        cases[ncases++] = (bench_case){"aes-256-ecb-encrypt", "aes-ni", op_ecb_encrypt, &bench_aes256_hw, 0};
+        cases[ncases++] = (bench_case){"aes-256-ecb-decrypt", "aes-ni", op_ecb_decrypt, &bench_aes256_hw, 0};
+        cases[ncases++] = (bench_case){"aes-256-ctr", "aes-ni", op_ctr, &bench_aes256_hw, 0};
+    }
+    cases[ncases++] = (bench_case){"chacha20-block", "scalar", op_chacha20_block, &bench_chacha, 0};
+    for (size_t i = 0; i < CHACHA20_KERNEL_COUNT; i++)
+    {
+        if (chacha20_kernel_supported(&chacha20_kernels[i]))
+        {
+            cases[ncases++] = (bench_case){"chacha20-encrypt", chacha20_kernels[i].name, op_chacha20_encrypt,
+                                           (void *)&chacha20_kernels[i], 0};
+        }
+    }
+    cases[ncases++] = (bench_case){"poly1305", POLY1305_LIMB64 ? "64-bit" : "32-bit", op_poly1305,
+                                   (void *)bench_chacha_key, 0};
+    cases[ncases++] = (bench_case){"ghash", "4-bit-table", op_ghash, &bench_gcm_sw, 0};
+    cases[ncases++] = (bench_case){"aes-128-gcm", AES_TTABLE ? "t-table+ghash-table" : "byte-wise+ghash-table", op_gcm, &bench_aes_sw, 0};
+    if (bench_aes_bs.bitslice)
+    {
+        cases[ncases++] = (bench_case){"aes-128-gcm", "bitsliced+ghash-table", op_gcm, &bench_aes_bs, 0};
+        cases[ncases++] = (bench_case){"aes-256-gcm", "bitsliced+ghash-table", op_gcm, &bench_aes256_bs, 0};
+    }
+    if (bench_gcm_hw.ghash.clmul)
+    {
+        cases[ncases++] = (bench_case){"ghash", "pclmul", op_ghash, &bench_gcm_hw, 0};
+        cases[ncases++] = (bench_case){"aes-128-gcm", "aes-ni+pclmul", op_gcm, &bench_aes_hw, 0};
+        cases[ncases++] = (bench_case){"aes-256-gcm", "aes-ni+pclmul", op_gcm, &bench_aes256_hw, 0};
+    }
+    const chacha20_kernel *widest = chacha20_select_kernel();
+    cases[ncases++] = (bench_case){"chacha20-poly1305", widest->name, op_chacha20_poly1305, (void *)widest, 0};
+    cases[ncases++] = (bench_case){"aes-128-ctr-file", aes_engine_name(), op_aes_file, &aes_file_job, 1};
+    cases[ncases++] = (bench_case){"chacha20-file", "default", op_chacha20_file, &chacha_file_job, 1};
+
+    uint8_t *buffer = aligned_alloc(64, bench_max_size);
+    double *samples = malloc(BENCH_LATENCY_SAMPLES * sizeof(double));
+    if (!buffer || !samples)
+    {
+        perror("Failed to allocate benchmark buffer");
+        return 1;
+    }
+    for (size_t i = 0; i < bench_max_size; i++)
+    {
+        buffer[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    if (!bench_json)
+    {
+        printf("%-22s %-10s %11s %11s %9s %12s %12s %12s\n", "benchmark", "backend", "bytes", "MB/s",
+               "cyc/B", "p50 ns", "p99 ns", "max ns");
+    }
+    for (size_t i = 0; i < ncases; i++)
+    {
+        const bench_case *c = &cases[i];
+        if (bench_filter && !strstr(c->name, bench_filter) && !strstr(c->backend, bench_filter))
+        {
+            continue;
+        }
+
+        // Sizes go up by 4x; the file paths start at 4 KiB
+        double mbps = 0;
+        for (size_t size = c->file ? 4096 : BENCH_MIN_SIZE; size <= bench_max_size; size *= 4)
+        {
+            // Skip sizes whose single call would take far longer than the measurement budget
+            if (mbps > 0 && size / (mbps * 1e6) > BENCH_MAX_CALL_SECONDS)
+            {
+                if (!bench_json)
+                {
+                    printf("%-22s %-10s %11zu %11s\n", c->name, c->backend, size, "skipped");
+                }
+                continue;
+            }
+            mbps = bench_run(c, buffer, size, samples);
+        }
+    }
+
+    pool_destroy(chacha_file_job.workers);
+    free(samples);
+    free(buffer);
+    return 0;
+}
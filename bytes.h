@@ -0,0 +1,37 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Function to store a little-endian integer of `bytes` bytes
+static inline void store_le(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+// Function to load a little-endian integer of `bytes` bytes
+static inline uint64_t load_le(const uint8_t *p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// Function to clear key material in a way the compiler cannot drop as a dead store
+static inline void secure_zero(void *p, size_t n)
+{
+    volatile uint8_t *v = (volatile uint8_t *)p;
+    while (n--)
+    {
+        *v++ = 0;
+    }
+}
+
+#endif
@@ -2,18 +2,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#include "bytes.h"
+#include "chacha20.h"
+#include "stream.h"
 
 #define ROUNDS 20 // Number of rounds in ChaCha20
 
+// Build the SSE2/AVX2/AVX-512 kernels on x86 compilers that support per-function target attributes
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHACHA20_HAVE_SIMD 1
+#include <immintrin.h>
+#else
+#define CHACHA20_HAVE_SIMD 0
+#endif
+
 // ChaCha20 constants
 static const char *constants = "expand 32-byte k";
 
-// Structure to hold the ChaCha20 state
-typedef struct
-{
-    uint32_t state[16];
-} chacha20_ctx;
-
 // Function to perform a left rotation on a 32-bit integer
 static uint32_t rotate(uint32_t v, int c)
 {
@@ -39,7 +46,7 @@ static void store32(uint8_t *x, uint32_t u)
 }
 
 // Function to initialize the ChaCha20 state with the key and nonce
-static void chacha20_keysetup(chacha20_ctx *ctx, const uint8_t *key, const uint8_t *nonce)
+void chacha20_keysetup(chacha20_ctx *ctx, const uint8_t *key, const uint8_t *nonce)
 {
     int i;
     // Load the constants into the state
@@ -61,6 +68,14 @@ static void chacha20_keysetup(chacha20_ctx *ctx, const uint8_t *key, const uint8
     ctx->state[15] = load32(nonce + 4);
 }
 
+// Function to initialize the state with the RFC 8439 layout: state[12] is a 32-bit block counter
+// and state[13..15] the 12-byte nonce
+void chacha20_keysetup_ietf(chacha20_ctx *ctx, const uint8_t *key, const uint8_t *nonce)
+{
+    chacha20_keysetup(ctx, key, nonce + 4);
+    ctx->state[13] = load32(nonce);
+}
+
 // Function to generate a 64-byte keystream block
 static void chacha20_block(chacha20_ctx *ctx, uint32_t *out)
 {
@@ -152,14 +167,321 @@ static void chacha20_block(chacha20_ctx *ctx, uint32_t *out)
     }
 }
 
+// Function to advance the 64-bit block counter held in state[12] (low) and state[13] (high)
+static void chacha20_advance(chacha20_ctx *ctx, uint64_t blocks)
+{
+    uint64_t counter = ((uint64_t)ctx->state[13] << 32 | ctx->state[12]) + blocks;
+    ctx->state[12] = (uint32_t)counter;
+    ctx->state[13] = (uint32_t)(counter >> 32);
+}
+
+// Function to fill per-lane counter words for a multi-block kernel starting at the ctx counter
+static void chacha20_lane_counters(const chacha20_ctx *ctx, uint32_t *lo, uint32_t *hi, int lanes)
+{
+    uint64_t counter = (uint64_t)ctx->state[13] << 32 | ctx->state[12];
+    for (int i = 0; i < lanes; ++i)
+    {
+        lo[i] = (uint32_t)(counter + i);
+        hi[i] = (uint32_t)((counter + i) >> 32);
+    }
+}
+
+#if CHACHA20_HAVE_SIMD
+// The vector kernels keep state word i of every block in x[i], one block per 32-bit lane, so the
+// double round is the scalar one applied to whole vectors; the result is transposed back per block
+
+#define CHACHA20_DOUBLE_ROUND(QR) \
+    QR(0, 4, 8, 12)               \
+    QR(1, 5, 9, 13)               \
+    QR(2, 6, 10, 14)              \
+    QR(3, 7, 11, 15)              \
+    QR(0, 5, 10, 15)              \
+    QR(1, 6, 11, 12)              \
+    QR(2, 7, 8, 13)               \
+    QR(3, 4, 9, 14)
+
+// Transpose words 4g..4g+3 of four lanes (within each 128-bit lane) so that y[b] holds them for block b
+#define CHACHA20_TRANSPOSE4(x, g, y, UNPACKLO32, UNPACKHI32, UNPACKLO64, UNPACKHI64) \
+    do                                                                              \
+    {                                                                               \
+        t0 = UNPACKLO32(x[4 * (g) + 0], x[4 * (g) + 1]);                            \
+        t1 = UNPACKLO32(x[4 * (g) + 2], x[4 * (g) + 3]);                            \
+        t2 = UNPACKHI32(x[4 * (g) + 0], x[4 * (g) + 1]);                            \
+        t3 = UNPACKHI32(x[4 * (g) + 2], x[4 * (g) + 3]);                            \
+        y[0] = UNPACKLO64(t0, t1);                                                  \
+        y[1] = UNPACKHI64(t0, t1);                                                  \
+        y[2] = UNPACKLO64(t2, t3);                                                  \
+        y[3] = UNPACKHI64(t2, t3);                                                  \
+    } while (0)
+
+#define SSE2_ROTL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define SSE2_QR(a, b, c, d)                                     \
+    x[a] = _mm_add_epi32(x[a], x[b]);                           \
+    x[d] = SSE2_ROTL(_mm_xor_si128(x[d], x[a]), 16);            \
+    x[c] = _mm_add_epi32(x[c], x[d]);                           \
+    x[b] = SSE2_ROTL(_mm_xor_si128(x[b], x[c]), 12);            \
+    x[a] = _mm_add_epi32(x[a], x[b]);                           \
+    x[d] = SSE2_ROTL(_mm_xor_si128(x[d], x[a]), 8);             \
+    x[c] = _mm_add_epi32(x[c], x[d]);                           \
+    x[b] = SSE2_ROTL(_mm_xor_si128(x[b], x[c]), 7);
+
+// Function to XOR 4 blocks (256 bytes) of keystream into the output using SSE2
+static __attribute__((target("sse2"))) void chacha20_xor4_sse2(const chacha20_ctx *ctx, const uint8_t *input, uint8_t *output)
+{
+    __m128i x[16], orig[16], y[4], t0, t1, t2, t3;
+    uint32_t lo[4], hi[4];
+    int i, g, b;
+
+    for (i = 0; i < 16; ++i)
+    {
+        orig[i] = _mm_set1_epi32((int)ctx->state[i]);
+    }
+    chacha20_lane_counters(ctx, lo, hi, 4);
+    orig[12] = _mm_loadu_si128((const __m128i *)lo);
+    orig[13] = _mm_loadu_si128((const __m128i *)hi);
+    memcpy(x, orig, sizeof(x));
+
+    for (i = 0; i < ROUNDS; i += 2)
+    {
+        CHACHA20_DOUBLE_ROUND(SSE2_QR)
+    }
+    for (i = 0; i < 16; ++i)
+    {
+        x[i] = _mm_add_epi32(x[i], orig[i]);
+    }
+
+    for (g = 0; g < 4; ++g)
+    {
+        CHACHA20_TRANSPOSE4(x, g, y, _mm_unpacklo_epi32, _mm_unpackhi_epi32, _mm_unpacklo_epi64, _mm_unpackhi_epi64);
+        for (b = 0; b < 4; ++b)
+        {
+            const __m128i *in = (const __m128i *)(input + b * 64 + g * 16);
+            _mm_storeu_si128((__m128i *)(output + b * 64 + g * 16), _mm_xor_si128(_mm_loadu_si128(in), y[b]));
+        }
+    }
+}
+
+#define AVX2_ROTL(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define AVX2_QR(a, b, c, d)                                          \
+    x[a] = _mm256_add_epi32(x[a], x[b]);                             \
+    x[d] = _mm256_shuffle_epi8(_mm256_xor_si256(x[d], x[a]), rot16); \
+    x[c] = _mm256_add_epi32(x[c], x[d]);                             \
+    x[b] = AVX2_ROTL(_mm256_xor_si256(x[b], x[c]), 12);              \
+    x[a] = _mm256_add_epi32(x[a], x[b]);                             \
+    x[d] = _mm256_shuffle_epi8(_mm256_xor_si256(x[d], x[a]), rot8);  \
+    x[c] = _mm256_add_epi32(x[c], x[d]);                             \
+    x[b] = AVX2_ROTL(_mm256_xor_si256(x[b], x[c]), 7);
+
+// Function to XOR 8 blocks (512 bytes) of keystream into the output using AVX2
+static __attribute__((target("avx2"))) void chacha20_xor8_avx2(const chacha20_ctx *ctx, const uint8_t *input, uint8_t *output)
+{
+    // Byte shuffles implementing 16- and 8-bit rotations of every 32-bit lane
+    const __m256i rot16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                          13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i rot8 = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                         14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    __m256i x[16], orig[16], y[4][4], t0, t1, t2, t3;
+    uint32_t lo[8], hi[8];
+    int i, g, b;
+
+    for (i = 0; i < 16; ++i)
+    {
+        orig[i] = _mm256_set1_epi32((int)ctx->state[i]);
+    }
+    chacha20_lane_counters(ctx, lo, hi, 8);
+    orig[12] = _mm256_loadu_si256((const __m256i *)lo);
+    orig[13] = _mm256_loadu_si256((const __m256i *)hi);
+    memcpy(x, orig, sizeof(x));
+
+    for (i = 0; i < ROUNDS; i += 2)
+    {
+        CHACHA20_DOUBLE_ROUND(AVX2_QR)
+    }
+    for (i = 0; i < 16; ++i)
+    {
+        x[i] = _mm256_add_epi32(x[i], orig[i]);
+    }
+
+    // After the in-lane transpose y[g][b] holds words 4g..4g+3 of block b (low half) and b + 4 (high half)
+    for (g = 0; g < 4; ++g)
+    {
+        CHACHA20_TRANSPOSE4(x, g, y[g], _mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64);
+    }
+    for (b = 0; b < 4; ++b)
+    {
+        const uint8_t *in = input + b * 64;
+        uint8_t *out = output + b * 64;
+        __m256i k0 = _mm256_permute2x128_si256(y[0][b], y[1][b], 0x20);
+        __m256i k1 = _mm256_permute2x128_si256(y[2][b], y[3][b], 0x20);
+        __m256i k2 = _mm256_permute2x128_si256(y[0][b], y[1][b], 0x31);
+        __m256i k3 = _mm256_permute2x128_si256(y[2][b], y[3][b], 0x31);
+        _mm256_storeu_si256((__m256i *)(out + 0), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + 0)), k0));
+        _mm256_storeu_si256((__m256i *)(out + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + 32)), k1));
+        _mm256_storeu_si256((__m256i *)(out + 256), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + 256)), k2));
+        _mm256_storeu_si256((__m256i *)(out + 288), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + 288)), k3));
+    }
+}
+
+#define AVX512_QR(a, b, c, d)                                            \
+    x[a] = _mm512_add_epi32(x[a], x[b]);                                 \
+    x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 16);           \
+    x[c] = _mm512_add_epi32(x[c], x[d]);                                 \
+    x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 12);           \
+    x[a] = _mm512_add_epi32(x[a], x[b]);                                 \
+    x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 8);            \
+    x[c] = _mm512_add_epi32(x[c], x[d]);                                 \
+    x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 7);
+
+// Function to XOR 16 blocks (1024 bytes) of keystream into the output using AVX-512
+static __attribute__((target("avx512f"))) void chacha20_xor16_avx512(const chacha20_ctx *ctx, const uint8_t *input, uint8_t *output)
+{
+    __m512i x[16], orig[16], y[4][4], u0, u1, u2, u3, k[4], t0, t1, t2, t3;
+    uint32_t lo[16], hi[16];
+    int i, g, b, l;
+
+    for (i = 0; i < 16; ++i)
+    {
+        orig[i] = _mm512_set1_epi32((int)ctx->state[i]);
+    }
+    chacha20_lane_counters(ctx, lo, hi, 16);
+    orig[12] = _mm512_loadu_si512(lo);
+    orig[13] = _mm512_loadu_si512(hi);
+    memcpy(x, orig, sizeof(x));
+
+    for (i = 0; i < ROUNDS; i += 2)
+    {
+        CHACHA20_DOUBLE_ROUND(AVX512_QR)
+    }
+    for (i = 0; i < 16; ++i)
+    {
+        x[i] = _mm512_add_epi32(x[i], orig[i]);
+    }
+
+    // After the in-lane transpose 128-bit lane l of y[g][b] holds words 4g..4g+3 of block 4l + b;
+    // a 4x4 transpose of 128-bit lanes then gathers each block's four groups into one vector
+    for (g = 0; g < 4; ++g)
+    {
+        CHACHA20_TRANSPOSE4(x, g, y[g], _mm512_unpacklo_epi32, _mm512_unpackhi_epi32, _mm512_unpacklo_epi64, _mm512_unpackhi_epi64);
+    }
+    for (b = 0; b < 4; ++b)
+    {
+        u0 = _mm512_shuffle_i32x4(y[0][b], y[1][b], 0x44);
+        u1 = _mm512_shuffle_i32x4(y[0][b], y[1][b], 0xee);
+        u2 = _mm512_shuffle_i32x4(y[2][b], y[3][b], 0x44);
+        u3 = _mm512_shuffle_i32x4(y[2][b], y[3][b], 0xee);
+        k[0] = _mm512_shuffle_i32x4(u0, u2, 0x88);
+        k[1] = _mm512_shuffle_i32x4(u0, u2, 0xdd);
+        k[2] = _mm512_shuffle_i32x4(u1, u3, 0x88);
+        k[3] = _mm512_shuffle_i32x4(u1, u3, 0xdd);
+        for (l = 0; l < 4; ++l)
+        {
+            const uint8_t *in = input + (4 * l + b) * 64;
+            _mm512_storeu_si512(output + (4 * l + b) * 64, _mm512_xor_si512(_mm512_loadu_si512(in), k[l]));
+        }
+    }
+}
+#endif
+
+// Multi-block keystream kernel: XORs `blocks` 64-byte blocks starting at the ctx counter
+typedef struct
+{
+    const char *name;
+    const char *cpu_feature; // __builtin_cpu_supports name, or NULL for the scalar path
+    int blocks;
+    void (*xor_blocks)(const chacha20_ctx *ctx, const uint8_t *input, uint8_t *output);
+} chacha20_kernel;
+
+// Available kernels, widest first; the scalar reference path is always last
+static const chacha20_kernel chacha20_kernels[] = {
+#if CHACHA20_HAVE_SIMD
+    {"avx512", "avx512f", 16, chacha20_xor16_avx512},
+    {"avx2", "avx2", 8, chacha20_xor8_avx2},
+    {"sse2", "sse2", 4, chacha20_xor4_sse2},
+#endif
+    {"scalar", NULL, 0, NULL},
+};
+
+#define CHACHA20_KERNEL_COUNT (sizeof(chacha20_kernels) / sizeof(chacha20_kernels[0]))
+
+// Set by --scalar to keep the reference one-block-at-a-time path even when SIMD is available
+static int chacha20_force_scalar = 0;
+
+// Kernel used by chacha20_encrypt, picked on first use
+static const chacha20_kernel *chacha20_kernel_in_use = NULL;
+
+// Function to check whether the CPU can run a kernel
+static int chacha20_kernel_supported(const chacha20_kernel *kernel)
+{
+    if (!kernel->cpu_feature)
+    {
+        return 1;
+    }
+#if CHACHA20_HAVE_SIMD
+    __builtin_cpu_init();
+    if (strcmp(kernel->cpu_feature, "avx512f") == 0)
+    {
+        return __builtin_cpu_supports("avx512f");
+    }
+    if (strcmp(kernel->cpu_feature, "avx2") == 0)
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(kernel->cpu_feature, "sse2") == 0)
+    {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return 0;
+}
+
+// Function to pick (once) the widest kernel the CPU supports; blocks == 0 means scalar only
+static const chacha20_kernel *chacha20_select_kernel(void)
+{
+    if (!chacha20_kernel_in_use)
+    {
+        size_t i = chacha20_force_scalar ? CHACHA20_KERNEL_COUNT - 1 : 0;
+        while (!chacha20_kernel_supported(&chacha20_kernels[i]))
+        {
+            i++;
+        }
+        chacha20_kernel_in_use = &chacha20_kernels[i];
+    }
+    return chacha20_kernel_in_use;
+}
+
+// Function to select the scalar path (or go back to the widest supported kernel)
+void chacha20_set_scalar(int scalar)
+{
+    chacha20_force_scalar = scalar;
+    chacha20_kernel_in_use = NULL;
+}
+
+// Function to report the name of the kernel chacha20_encrypt uses
+const char *chacha20_engine_name(void)
+{
+    return chacha20_select_kernel()->name;
+}
+
 // Function to encrypt or decrypt data using ChaCha20
-void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *input, uint8_t *output, uint32_t length)
+void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length)
 {
+    const chacha20_kernel *kernel = chacha20_select_kernel();
     uint8_t block[64];
-    uint32_t i, j;
+    size_t i = 0, j;
+
+    // Whole groups of blocks go through the vector kernel, which XORs wide words directly
+    if (kernel->blocks)
+    {
+        size_t stride = kernel->blocks * 64;
+        for (; length - i >= stride; i += stride)
+        {
+            kernel->xor_blocks(ctx, input + i, output + i);
+            chacha20_advance(ctx, kernel->blocks);
+        }
+    }
 
-    // Process each 64-byte block
-    for (i = 0; i < length; i += 64)
+    // Process each remaining 64-byte block
+    for (; i < length; i += 64)
     {
         // Generate the keystream block
         chacha20_block(ctx, (uint32_t *)block);
@@ -179,82 +501,452 @@ void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *input, uint8_t *output,
     }
 }
 
-// Function to process a file using ChaCha20 encryption or decryption
-void process_file(const char *filename, const char *key, const char *nonce, const char *mode)
+// Smallest slice worth handing to a pool task (a multiple of the 64-byte block size)
+#define CHACHA20_MIN_CHUNK (64 << 10)
+
+// One task's slice of the buffer, with its own copy of the state seeked to the slice's first block
+typedef struct
+{
+    chacha20_ctx ctx;
+    const uint8_t *input;
+    uint8_t *output;
+    size_t length;
+} chacha20_job;
+
+// Pool task entry point: encrypt or decrypt one slice
+static void chacha20_worker(void *arg)
 {
-    FILE *file = fopen(filename, "rb");
-    if (!file)
+    chacha20_job *job = (chacha20_job *)arg;
+    chacha20_encrypt(&job->ctx, job->input, job->output, job->length);
+}
+
+// Function to encrypt or decrypt a buffer across the worker pool. Each 64-byte-aligned slice seeks
+// the block counter to its own offset, so the output and final ctx match a single chacha20_encrypt call
+void chacha20_encrypt_parallel(pool *workers, chacha20_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length)
+{
+    size_t slices = workers ? (size_t)pool_size(workers) : 1;
+    if (slices > length / CHACHA20_MIN_CHUNK)
     {
-        perror("Failed to open file");
-        exit(1);
+        slices = length / CHACHA20_MIN_CHUNK;
+    }
+    chacha20_job *jobs = slices > 1 ? malloc(slices * sizeof(chacha20_job)) : NULL;
+    if (!jobs)
+    {
+        chacha20_encrypt(ctx, input, output, length);
+        return;
     }
 
-    // Get the file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    size_t chunk = (length / slices + 63) & ~(size_t)63;
+    pool_group group = POOL_GROUP_INIT;
+    for (size_t i = 0; i < slices; ++i)
+    {
+        size_t offset = i * chunk;
+        jobs[i].ctx = *ctx;
+        chacha20_advance(&jobs[i].ctx, offset / 64);
+        jobs[i].input = input + offset;
+        jobs[i].output = output + offset;
+        jobs[i].length = i == slices - 1 ? length - offset : chunk;
+        pool_submit(workers, &group, chacha20_worker, &jobs[i]);
+    }
+    pool_wait(workers, &group);
 
-    // Allocate memory for the input and output data
-    uint8_t *input = malloc(file_size);
-    uint8_t *output = malloc(file_size);
+    chacha20_advance(ctx, (length + 63) / 64);
+    free(jobs);
+}
 
-    // Read the input file
-    fread(input, 1, file_size, file);
-    fclose(file);
+// Function to check the selected kernel against RFC 8439 and the scalar reference path
+int chacha20_self_test(void)
+{
+    // RFC 8439 2.4.2: a 96-bit nonce 00..00 00 00 00 4a 00 00 00 00 is state[13..15], so with the
+    // 64-bit counter layout used here it becomes counter 1 and nonce 00 00 00 4a 00 00 00 00
+    static const char plain[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+                                "tip for the future, sunscreen would be it.";
+    static const uint8_t cipher[114] = {
+        0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+        0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+        0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+        0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+        0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+        0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+        0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+        0x87, 0x4d};
+    static const uint8_t nonce[8] = {0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00};
+    uint8_t key[32], output[114];
+    uint8_t data[4096 + 100], expected[sizeof(data)], block[64];
+    chacha20_ctx ctx, ref;
+    uint32_t i, j;
 
-    // Initialize the ChaCha20 context with the key and nonce
-    chacha20_ctx ctx;
-    chacha20_keysetup(&ctx, (const uint8_t *)key, (const uint8_t *)nonce);
+    for (i = 0; i < 32; ++i)
+    {
+        key[i] = (uint8_t)i;
+    }
+    chacha20_keysetup(&ctx, key, nonce);
+    ctx.state[12] = 1;
+    chacha20_encrypt(&ctx, (const uint8_t *)plain, output, sizeof(output));
+    if (memcmp(output, cipher, sizeof(output)) != 0)
+    {
+        return 0;
+    }
 
-    // Encrypt or decrypt the data
-    if (strcmp(mode, "encrypt") == 0)
+    // Long message across the 32-bit counter boundary, compared with one-block-at-a-time output
+    for (i = 0; i < sizeof(data); ++i)
     {
-        chacha20_encrypt(&ctx, input, output, file_size);
+        data[i] = (uint8_t)(i * 7 + 3);
     }
-    else if (strcmp(mode, "decrypt") == 0)
+    chacha20_keysetup(&ctx, key, nonce);
+    ctx.state[12] = 0xfffffff9;
+    ref = ctx;
+    for (i = 0; i < sizeof(data); i += 64)
     {
-        chacha20_encrypt(&ctx, input, output, file_size); // Same function for both
+        chacha20_block(&ref, (uint32_t *)block);
+        chacha20_advance(&ref, 1);
+        for (j = 0; j < 64 && i + j < sizeof(data); ++j)
+        {
+            expected[i + j] = data[i + j] ^ block[j];
+        }
     }
+    chacha20_encrypt(&ctx, data, data, sizeof(data));
+    return memcmp(data, expected, sizeof(data)) == 0 &&
+           memcmp(ctx.state, ref.state, sizeof(ctx.state)) == 0;
+}
+
+// Bytes encrypted between MAC updates, so Poly1305 reads the ciphertext while it is still in L1
+#define CHACHA20_POLY1305_CHUNK (4 << 10)
+
+// Function to begin an AEAD message from a state at block 0: that block becomes the one-time
+// Poly1305 key and the text starts at block 1
+static void chacha20_poly1305_begin(chacha20_poly1305_ctx *ctx, const chacha20_ctx *state, int encrypt)
+{
+    uint8_t key[64] = {0};
+
+    ctx->chacha20 = *state;
+    chacha20_encrypt(&ctx->chacha20, key, key, sizeof(key));
+    poly1305_init(&ctx->poly1305, key);
+    secure_zero(key, sizeof(key));
+    ctx->available = 0;
+    ctx->aad_length = 0;
+    ctx->text_length = 0;
+    ctx->text_started = 0;
+    ctx->encrypt = encrypt;
+}
 
-    // Write the output file
-    file = fopen(filename, "wb");
-    fwrite(output, 1, file_size, file);
-    fclose(file);
+void chacha20_poly1305_init(chacha20_poly1305_ctx *ctx, const uint8_t *key, const uint8_t *nonce, int encrypt)
+{
+    chacha20_ctx state;
+    chacha20_keysetup_ietf(&state, key, nonce);
+    chacha20_poly1305_begin(ctx, &state, encrypt);
+    secure_zero(&state, sizeof(state));
+}
 
-    // Free the allocated memory
-    free(input);
-    free(output);
+void chacha20_poly1305_aad(chacha20_poly1305_ctx *ctx, const uint8_t *aad, size_t length)
+{
+    poly1305_update(&ctx->poly1305, aad, length);
+    ctx->aad_length += length;
 }
 
-// Main function to handle command-line arguments and call the process_file function
-int main(int argc, char *argv[])
+// Function to XOR `length` bytes with `keystream`, feeding the ciphertext side to the MAC
+static void chacha20_poly1305_xor(chacha20_poly1305_ctx *ctx, const uint8_t *input, uint8_t *output,
+                                  const uint8_t *keystream, size_t length)
 {
-    if (argc != 5)
+    if (!ctx->encrypt)
     {
-        fprintf(stderr, "Usage: %s <file> <key> <nonce> <encrypt|decrypt>\n", argv[0]);
-        return 1;
+        poly1305_update(&ctx->poly1305, input, length);
+    }
+    for (size_t i = 0; i < length; ++i)
+    {
+        output[i] = input[i] ^ keystream[i];
+    }
+    if (ctx->encrypt)
+    {
+        poly1305_update(&ctx->poly1305, output, length);
     }
+}
 
-    const char *filename = argv[1];
-    const char *key = argv[2];
-    const char *nonce = argv[3];
-    const char *mode = argv[4];
+int chacha20_poly1305_update(chacha20_poly1305_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length)
+{
+    size_t done = 0;
 
-    // Ensure the key and nonce lengths are correct
-    if (strlen(key) != 32)
+    if (length > CHACHA20_POLY1305_MAX_TEXT - ctx->text_length)
     {
-        fprintf(stderr, "Key must be exactly 32 characters long\n");
-        return 1;
+        return -1;
     }
+    if (!ctx->text_started)
+    {
+        poly1305_pad16(&ctx->poly1305);
+        ctx->text_started = 1;
+    }
+    ctx->text_length += length;
 
-    if (strlen(nonce) != 8)
+    // Use up the keystream left over from a previous partial block
+    if (ctx->available)
     {
-        fprintf(stderr, "Nonce must be exactly 8 characters long\n");
-        return 1;
+        done = length < ctx->available ? length : ctx->available;
+        chacha20_poly1305_xor(ctx, input, output, ctx->keystream + 64 - ctx->available, done);
+        ctx->available -= done;
     }
 
-    // Process the file
-    process_file(filename, key, nonce, mode);
+    // Whole blocks go through the vector kernel one chunk at a time, each MAC'd while still hot
+    while (length - done >= 64)
+    {
+        size_t n = (length - done) & ~(size_t)63;
+        if (n > CHACHA20_POLY1305_CHUNK)
+        {
+            n = CHACHA20_POLY1305_CHUNK;
+        }
+        if (!ctx->encrypt)
+        {
+            poly1305_update(&ctx->poly1305, input + done, n);
+        }
+        chacha20_encrypt(&ctx->chacha20, input + done, output + done, n);
+        if (ctx->encrypt)
+        {
+            poly1305_update(&ctx->poly1305, output + done, n);
+        }
+        done += n;
+    }
 
+    // Start a new keystream block for the tail
+    if (done < length)
+    {
+        memset(ctx->keystream, 0, sizeof(ctx->keystream));
+        chacha20_encrypt(&ctx->chacha20, ctx->keystream, ctx->keystream, sizeof(ctx->keystream));
+        chacha20_poly1305_xor(ctx, input + done, output + done, ctx->keystream, length - done);
+        ctx->available = 64 - (length - done);
+    }
     return 0;
 }
+
+void chacha20_poly1305_final(chacha20_poly1305_ctx *ctx, uint8_t *tag)
+{
+    uint8_t lengths[16];
+
+    // MAC input: aad || pad16 || ciphertext || pad16 || le64(aad length) || le64(text length)
+    poly1305_pad16(&ctx->poly1305);
+    store32(lengths, (uint32_t)ctx->aad_length);
+    store32(lengths + 4, (uint32_t)(ctx->aad_length >> 32));
+    store32(lengths + 8, (uint32_t)ctx->text_length);
+    store32(lengths + 12, (uint32_t)(ctx->text_length >> 32));
+    poly1305_update(&ctx->poly1305, lengths, sizeof(lengths));
+    poly1305_finish(&ctx->poly1305, tag);
+    secure_zero(ctx->keystream, sizeof(ctx->keystream));
+    secure_zero(&ctx->chacha20, sizeof(ctx->chacha20));
+}
+
+int chacha20_poly1305_verify(chacha20_poly1305_ctx *ctx, const uint8_t *tag)
+{
+    uint8_t computed[CHACHA20_POLY1305_TAG_SIZE];
+    chacha20_poly1305_final(ctx, computed);
+    return poly1305_verify(computed, tag);
+}
+
+// Function to check the AEAD against RFC 8439 2.8.2, fed in uneven pieces
+int chacha20_poly1305_self_test(void)
+{
+    static const char plain[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+                                "tip for the future, sunscreen would be it.";
+    static const uint8_t aad[12] = {0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7};
+    static const uint8_t nonce[12] = {0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47};
+    static const uint8_t cipher[114] = {
+        0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+        0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+        0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+        0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+        0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+        0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+        0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+        0x61, 0x16};
+    static const uint8_t tag[16] = {
+        0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91};
+    chacha20_poly1305_ctx ctx;
+    uint8_t key[32], output[114], computed[16];
+    int i;
+
+    if (!poly1305_self_test())
+    {
+        return 0;
+    }
+    for (i = 0; i < 32; ++i)
+    {
+        key[i] = (uint8_t)(0x80 + i);
+    }
+
+    chacha20_poly1305_init(&ctx, key, nonce, 1);
+    chacha20_poly1305_aad(&ctx, aad, 5);
+    chacha20_poly1305_aad(&ctx, aad + 5, sizeof(aad) - 5);
+    chacha20_poly1305_update(&ctx, (const uint8_t *)plain, output, 10);
+    chacha20_poly1305_update(&ctx, (const uint8_t *)plain + 10, output + 10, 64);
+    chacha20_poly1305_update(&ctx, (const uint8_t *)plain + 74, output + 74, sizeof(output) - 74);
+    chacha20_poly1305_final(&ctx, computed);
+    if (memcmp(output, cipher, sizeof(cipher)) != 0 || memcmp(computed, tag, sizeof(tag)) != 0)
+    {
+        return 0;
+    }
+
+    // Decrypt in place and reject a tag with one bit flipped
+    chacha20_poly1305_init(&ctx, key, nonce, 0);
+    chacha20_poly1305_aad(&ctx, aad, sizeof(aad));
+    chacha20_poly1305_update(&ctx, output, output, sizeof(output));
+    if (!chacha20_poly1305_verify(&ctx, tag) || memcmp(output, plain, sizeof(output)) != 0)
+    {
+        return 0;
+    }
+    computed[15] ^= 1;
+    chacha20_poly1305_init(&ctx, key, nonce, 0);
+    chacha20_poly1305_aad(&ctx, aad, sizeof(aad));
+    chacha20_poly1305_update(&ctx, cipher, output, sizeof(output));
+    return !chacha20_poly1305_verify(&ctx, computed);
+}
+
+// Per-file streaming state: the counter in ctx carries over from one buffer to the next
+typedef struct
+{
+    chacha20_ctx ctx;
+    pool *workers;
+} chacha20_stream;
+
+// Stream transform: split each buffer across the pool
+static size_t chacha20_stream_transform(void *arg, uint8_t *buffer, size_t length, int final)
+{
+    chacha20_stream *stream = (chacha20_stream *)arg;
+    (void)final;
+    chacha20_encrypt_parallel(stream->workers, &stream->ctx, buffer, buffer, length);
+    return length;
+}
+
+// Per-file AEAD state. When decrypting, the last 16 bytes of the file are the tag: `remaining`
+// counts the ciphertext still to come and the tag bytes are collected as they arrive
+typedef struct
+{
+    chacha20_poly1305_ctx aead;
+    const char *filename;
+    uint64_t remaining;
+    int piped; // Decrypting standard input: the length is only known at the final call
+    uint8_t tag[CHACHA20_POLY1305_TAG_SIZE];
+    size_t tag_length;
+} chacha20_aead_stream;
+
+// Stream transform for ChaCha20-Poly1305: the tag is appended after the final buffer when
+// encrypting, and checked on the final call when decrypting. A mismatch fails the stream, so the
+// decrypted output is discarded and the original file is left unchanged
+static size_t chacha20_aead_transform(void *arg, uint8_t *buffer, size_t length, int final)
+{
+    chacha20_aead_stream *stream = (chacha20_aead_stream *)arg;
+    size_t text = length;
+
+    // A pipe's length is not known up front, but the stream keeps the whole tag in the final buffer
+    if (stream->piped)
+    {
+        stream->remaining = length;
+        if (final)
+        {
+            stream->remaining = length < CHACHA20_POLY1305_TAG_SIZE ? 0 : length - CHACHA20_POLY1305_TAG_SIZE;
+        }
+    }
+    if (!stream->aead.encrypt && text > stream->remaining)
+    {
+        text = (size_t)stream->remaining;
+    }
+    if (chacha20_poly1305_update(&stream->aead, buffer, buffer, text) != 0)
+    {
+        fprintf(stderr, "%s: File is too large for ChaCha20-Poly1305\n", stream->filename);
+        return STREAM_ERROR;
+    }
+
+    if (stream->aead.encrypt)
+    {
+        if (final)
+        {
+            chacha20_poly1305_final(&stream->aead, buffer + length);
+            length += CHACHA20_POLY1305_TAG_SIZE;
+        }
+        return length;
+    }
+
+    stream->remaining -= text;
+    if (stream->tag_length + (length - text) > CHACHA20_POLY1305_TAG_SIZE)
+    {
+        fprintf(stderr, "%s: File changed while it was being decrypted\n", stream->filename);
+        return STREAM_ERROR;
+    }
+    memcpy(stream->tag + stream->tag_length, buffer + text, length - text);
+    stream->tag_length += length - text;
+    if (final && (stream->tag_length != CHACHA20_POLY1305_TAG_SIZE ||
+                  !chacha20_poly1305_verify(&stream->aead, stream->tag)))
+    {
+        fprintf(stderr, "%s: Authentication failed (wrong key or nonce, or the file was modified); %s\n",
+                stream->filename, stream->piped ? "the output written is not authentic" : "file left unchanged");
+        return STREAM_ERROR;
+    }
+    return text;
+}
+
+// Function to encrypt a file with ChaCha20-Poly1305, appending the tag, or to decrypt and verify it
+static int chacha20_aead_file(const chacha20_job_settings *settings, const char *filename)
+{
+    chacha20_aead_stream stream;
+    struct stat st;
+    int result;
+
+    // The output is a tag longer or shorter than the input, so the file cannot be rewritten in place
+    if (settings->use_mmap)
+    {
+        fprintf(stderr, "%s: --mmap cannot be used with ChaCha20-Poly1305\n", filename);
+        return -1;
+    }
+    secure_zero(&stream, sizeof(stream));
+    stream.filename = filename;
+    if (!settings->encrypt && stream_is_stdio(filename))
+    {
+        stream.piped = 1;
+    }
+    else if (!settings->encrypt)
+    {
+        if (stat(filename, &st) != 0)
+        {
+            perror(filename);
+            return -1;
+        }
+        if ((uint64_t)st.st_size < settings->header_length + CHACHA20_POLY1305_TAG_SIZE)
+        {
+            fprintf(stderr, "%s: File is too short to hold an authentication tag\n", filename);
+            return -1;
+        }
+        stream.remaining = (uint64_t)st.st_size - settings->header_length - CHACHA20_POLY1305_TAG_SIZE;
+    }
+
+    chacha20_poly1305_begin(&stream.aead, &settings->initial, settings->encrypt);
+    if (settings->encrypt)
+    {
+        result = stream_file_framed(filename, settings->buffer_size, settings->arena, settings->header,
+                                    settings->header_length, 0, chacha20_aead_transform, &stream);
+    }
+    else
+    {
+        result = stream_file_framed(filename, settings->buffer_size, settings->arena, NULL, 0,
+                                    (off_t)settings->header_length, chacha20_aead_transform, &stream);
+    }
+    secure_zero(&stream, sizeof(stream));
+    return result;
+}
+
+// Function to process a file using ChaCha20 encryption or decryption; returns 0 on success.
+// Without the AEAD, encryption and decryption are the same operation
+int chacha20_process_file(const chacha20_job_settings *settings, const char *filename)
+{
+    chacha20_stream stream;
+
+    if (settings->aead)
+    {
+        return chacha20_aead_file(settings, filename);
+    }
+
+    stream.ctx = settings->initial;
+    stream.workers = settings->workers;
+
+    // ChaCha20 is length-preserving, so the mapped pages can be rewritten in place
+    if (settings->use_mmap)
+    {
+        return stream_map_file(filename, settings->buffer_size, chacha20_stream_transform, &stream);
+    }
+    return stream_file(filename, settings->buffer_size, settings->arena, chacha20_stream_transform, &stream);
+}
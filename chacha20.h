@@ -0,0 +1,91 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "poly1305.h"
+#include "pool.h"
+#include "stream.h"
+
+#define CHACHA20_POLY1305_NONCE_SIZE 12
+#define CHACHA20_POLY1305_TAG_SIZE POLY1305_TAG_SIZE
+#define CHACHA20_POLY1305_MAX_TEXT ((((uint64_t)1 << 32) - 1) * 64) // RFC 8439 limit: a 32-bit block counter
+
+// Structure to hold the ChaCha20 state
+typedef struct
+{
+    uint32_t state[16];
+} chacha20_ctx;
+
+// RFC 8439 ChaCha20-Poly1305 AEAD: the keystream starts at block 1 and the MAC covers the
+// additional data and the ciphertext
+typedef struct
+{
+    chacha20_ctx chacha20;
+    poly1305_ctx poly1305;
+    uint8_t keystream[64]; // Current keystream block, of which the last `available` bytes are unused
+    size_t available;
+    uint64_t aad_length, text_length;
+    int text_started; // The additional data has been padded and the text begun
+    int encrypt;
+} chacha20_poly1305_ctx;
+
+// Settings shared by every file in a run: the key and nonce are loaded once
+typedef struct
+{
+    chacha20_ctx initial; // State at block 0; each file starts from a copy
+    pool *workers;        // Pool that large buffers are split across
+    size_t buffer_size;   // Streaming buffer size (0 = STREAM_DEFAULT_BUFFER)
+    stream_arena *arena;  // Direct I/O buffers, or NULL to go through the page cache
+    int use_mmap;         // XOR the keystream straight into a memory mapping of the file
+    int aead;             // ChaCha20-Poly1305: append the tag when encrypting, verify it when decrypting
+    int encrypt;
+    const uint8_t *header; // AEAD: written ahead of the ciphertext, or skipped ahead of it when decrypting
+    size_t header_length;
+} chacha20_job_settings;
+
+// Function to initialize the ChaCha20 state with a 32-byte key and an 8-byte nonce, at block 0
+void chacha20_keysetup(chacha20_ctx *ctx, const uint8_t *key, const uint8_t *nonce);
+
+// Function to initialize the state with the RFC 8439 layout: a 32-bit counter and a 12-byte nonce
+void chacha20_keysetup_ietf(chacha20_ctx *ctx, const uint8_t *key, const uint8_t *nonce);
+
+// Function to keep the scalar reference path even when SIMD kernels are available
+void chacha20_set_scalar(int scalar);
+
+// Function to report the name of the kernel chacha20_encrypt uses
+const char *chacha20_engine_name(void);
+
+// Function to encrypt or decrypt data; the block counter in ctx advances past the data
+void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to encrypt or decrypt a buffer across the worker pool, with the same result as chacha20_encrypt
+void chacha20_encrypt_parallel(pool *workers, chacha20_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to check the selected kernel against RFC 8439 and the scalar reference path; 1 when it passes
+int chacha20_self_test(void);
+
+// Function to start an AEAD message with a 32-byte key and a 12-byte nonce
+void chacha20_poly1305_init(chacha20_poly1305_ctx *ctx, const uint8_t *key, const uint8_t *nonce, int encrypt);
+
+// Function to authenticate additional data; every call must come before the first update
+void chacha20_poly1305_aad(chacha20_poly1305_ctx *ctx, const uint8_t *aad, size_t length);
+
+// Function to encrypt or decrypt the next `length` bytes (out may equal in) while computing the MAC
+// over the ciphertext; -1 once the message would exceed CHACHA20_POLY1305_MAX_TEXT
+int chacha20_poly1305_update(chacha20_poly1305_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to finish the message and write the 16-byte tag
+void chacha20_poly1305_final(chacha20_poly1305_ctx *ctx, uint8_t *tag);
+
+// Function to finish the message and compare its tag with `tag` in constant time; 1 when they match
+int chacha20_poly1305_verify(chacha20_poly1305_ctx *ctx, const uint8_t *tag);
+
+// Function to check the AEAD against RFC 8439 (Poly1305 and the AEAD example); 1 when it passes
+int chacha20_poly1305_self_test(void);
+
+// Function to encrypt or decrypt a file in place; returns 0 on success
+int chacha20_process_file(const chacha20_job_settings *settings, const char *filename);
+
+#endif
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "filecrypt.h"
+
+// Function to parse OFFSET:LENGTH, each a size such as 0, 4096 or 64M; returns 0 when valid
+static int parse_range(const char *text, uint64_t *offset, uint64_t *length)
+{
+    char first[32];
+    const char *colon = strchr(text, ':');
+
+    if (!colon || (size_t)(colon - text) >= sizeof(first))
+    {
+        return -1;
+    }
+    memcpy(first, text, colon - text);
+    first[colon - text] = '\0';
+    *offset = strcmp(first, "0") == 0 ? 0 : filecrypt_parse_size(first);
+    *length = filecrypt_parse_size(colon + 1);
+    return (*offset == 0 && strcmp(first, "0") != 0) || *length == 0 ? -1 : 0;
+}
+
+// Main function to handle command-line arguments and run the files through libfilecrypt
+int main(int argc, char *argv[])
+{
+    filecrypt_options options = {0};
+    filecrypt_algorithm algorithm = FILECRYPT_CHACHA20;
+    const char *files_from = NULL;
+    const char *rsa_key = NULL;
+    int self_test = 0;
+    const char *range = NULL;
+    uint64_t range_offset = 0, range_length = 0;
+    int stats = 0; // 1 for --stats, 2 for --stats-json
+    int argi = 1;
+
+    // Parse leading options
+    while (argi < argc && strncmp(argv[argi], "--", 2) == 0)
+    {
+        if (strcmp(argv[argi], "--scalar") == 0)
+        {
+            filecrypt_set_portable(1);
+        }
+        else if (strcmp(argv[argi], "--stats") == 0 || strcmp(argv[argi], "--stats-json") == 0)
+        {
+            stats = strcmp(argv[argi], "--stats") == 0 ? 1 : 2;
+        }
+        else if (strcmp(argv[argi], "--self-test") == 0)
+        {
+            self_test = 1;
+        }
+        else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+        {
+            options.threads = atoi(argv[++argi]);
+            if (options.threads <= 0)
+            {
+                fprintf(stderr, "Thread count must be a positive number\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--files-from") == 0 && argi + 1 < argc)
+        {
+            files_from = argv[++argi];
+        }
+        else if (strcmp(argv[argi], "--rsa") == 0 && argi + 1 < argc)
+        {
+            rsa_key = argv[++argi];
+            algorithm = FILECRYPT_CHACHA20_POLY1305;
+        }
+        else if (strcmp(argv[argi], "--container") == 0)
+        {
+            options.container = 1;
+        }
+        else if (strcmp(argv[argi], "--chunk-size") == 0 && argi + 1 < argc)
+        {
+            options.chunk_size = filecrypt_parse_size(argv[++argi]);
+            if (options.chunk_size == 0)
+            {
+                fprintf(stderr, "Invalid chunk size: %s\n", argv[argi]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--range") == 0 && argi + 1 < argc)
+        {
+            range = argv[++argi];
+            if (parse_range(range, &range_offset, &range_length) != 0)
+            {
+                fprintf(stderr, "Invalid range (expected OFFSET:LENGTH): %s\n", range);
+                return 1;
+            }
+            options.container = 1;
+        }
+        else if (strcmp(argv[argi], "--aead") == 0)
+        {
+            algorithm = FILECRYPT_CHACHA20_POLY1305;
+        }
+        else if (strcmp(argv[argi], "--mmap") == 0)
+        {
+            options.use_mmap = 1;
+        }
+        else if (strcmp(argv[argi], "--direct-io") == 0 || strcmp(argv[argi], "--huge-pages") == 0)
+        {
+            options.direct_io = 1;
+            options.huge_pages |= strcmp(argv[argi], "--huge-pages") == 0;
+        }
+        else if (strcmp(argv[argi], "--buffer-size") == 0 && argi + 1 < argc)
+        {
+            options.buffer_size = filecrypt_parse_size(argv[++argi]);
+            if (options.buffer_size == 0)
+            {
+                fprintf(stderr, "Invalid buffer size: %s\n", argv[argi]);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+            return 1;
+        }
+        argi++;
+    }
+
+    // Run the known-answer tests for the kernel selected on this host
+    if (self_test)
+    {
+        int ok = filecrypt_self_test(algorithm) == 0;
+        printf("%s self-test (%s) %s\n", algorithm == FILECRYPT_CHACHA20 ? "ChaCha20" : "ChaCha20-Poly1305",
+               filecrypt_engine_name(algorithm), ok ? "passed" : "FAILED");
+        return ok ? 0 : 1;
+    }
+
+    // Paths come first; the key and nonce (unless they come from --rsa) and mode are always the last
+    // arguments
+    int trailing = rsa_key ? 1 : 3;
+    if (argc - argi < (files_from ? trailing : trailing + 1))
+    {
+        fprintf(stderr, "Usage: %s [options] <file|directory|->... <key> <nonce> <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --files-from <list|-> <key> <nonce> <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --rsa <key-file> <file|directory|->... <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s --aead --range OFFSET:LENGTH <container> <key> <nonce> decrypt\n", argv[0]);
+        fprintf(stderr, "       %s [--scalar] [--aead] --self-test\n", argv[0]);
+        fprintf(stderr, "Options: --scalar --aead --container --chunk-size N[K|M|G] --threads N\n");
+        fprintf(stderr, "         --buffer-size N[K|M|G] --mmap --direct-io --huge-pages --rsa <key-file>\n");
+        fprintf(stderr, "         --stats --stats-json\n");
+        return 1;
+    }
+
+    const char *key = rsa_key ? NULL : argv[argc - 3];
+    const char *nonce = rsa_key ? NULL : argv[argc - 2];
+    const char *mode = argv[argc - 1];
+
+    // Ensure the key and nonce lengths are correct
+    if (key && strlen(key) != FILECRYPT_CHACHA20_KEY_SIZE)
+    {
+        fprintf(stderr, "Key must be exactly 32 characters long\n");
+        return 1;
+    }
+
+    if (nonce && strlen(nonce) != FILECRYPT_NONCE_SIZE)
+    {
+        fprintf(stderr, "Nonce must be exactly 8 characters long\n");
+        return 1;
+    }
+
+    if (strcmp(mode, "encrypt") != 0 && strcmp(mode, "decrypt") != 0)
+    {
+        fprintf(stderr, "Mode must be encrypt or decrypt\n");
+        return 1;
+    }
+
+    if (options.use_mmap && algorithm != FILECRYPT_CHACHA20)
+    {
+        fprintf(stderr, "--mmap cannot be combined with --aead or --rsa\n");
+        return 1;
+    }
+
+    // Mapped files and containers go through the page cache
+    if (options.direct_io && (options.use_mmap || options.container))
+    {
+        fprintf(stderr, "--direct-io cannot be combined with --mmap, --container or --range\n");
+        return 1;
+    }
+
+    // With an RSA key every file gets its own random key and is sealed with ChaCha20-Poly1305
+    if (rsa_key && options.container)
+    {
+        fprintf(stderr, "--rsa cannot be combined with --container or --range\n");
+        return 1;
+    }
+
+    // Containers are built from authenticated chunks, and a range is read from a single container
+    if (options.container && algorithm != FILECRYPT_CHACHA20_POLY1305)
+    {
+        fprintf(stderr, "--container and --range need --aead\n");
+        return 1;
+    }
+    if (range && (strcmp(mode, "decrypt") != 0 || files_from || argc - trailing - argi != 1))
+    {
+        fprintf(stderr, "--range decrypts part of one container: give a single file and decrypt\n");
+        return 1;
+    }
+
+    // Time the run from the key setup on, and count the CPU work of the threads started after it
+    if (stats)
+    {
+        filecrypt_stats_enable(1);
+    }
+
+    // Load the key (or the RSA key) once and share one worker pool between files and within large files
+    filecrypt_mode direction = strcmp(mode, "encrypt") == 0 ? FILECRYPT_ENCRYPT : FILECRYPT_DECRYPT;
+    filecrypt_job *job;
+    if (rsa_key)
+    {
+        job = filecrypt_job_create_hybrid(algorithm, direction, rsa_key, &options);
+    }
+    else
+    {
+        job = filecrypt_job_create(algorithm, direction, (const uint8_t *)key, FILECRYPT_CHACHA20_KEY_SIZE,
+                                   (const uint8_t *)nonce, FILECRYPT_NONCE_SIZE, &options);
+    }
+    if (!job)
+    {
+        perror("Failed to set up the job");
+        return 1;
+    }
+
+    // Decrypt just the requested range of one container to standard output, or process the files
+    int failed;
+    if (range)
+    {
+        failed = filecrypt_job_extract(job, argv[argi], range_offset, range_length, STDOUT_FILENO) != 0;
+    }
+    else
+    {
+        failed = filecrypt_job_run(job, (const char *const *)argv + argi, argc - trailing - argi, files_from) != 0;
+    }
+    filecrypt_job_free(job);
+
+    // The workers have been joined, so their CPU counts are included
+    if (stats)
+    {
+        filecrypt_stats_print(stderr, stats == 2);
+    }
+    return failed;
+}
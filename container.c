@@ -0,0 +1,646 @@
+#include "container.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "rsa.h"
+#include "stats.h"
+#include "stream.h"
+
+#define CONTAINER_BATCH_BYTES (64 << 20) // Most chunk bytes held in memory at once
+#define CONTAINER_INDEX_PREFIX 0xffffffffu
+
+// One chunk (or the index) to seal or open on the pool
+typedef struct
+{
+    const container_settings *settings;
+    const uint8_t *aad;
+    size_t aad_length;
+    uint8_t nonce[12];
+    uint8_t *data;
+    size_t length;
+    uint8_t *tag;
+    int encrypt;
+    int result;
+} container_task;
+
+// Buffers for a batch of consecutive chunks, each followed by its tag
+typedef struct
+{
+    uint8_t *buffer;
+    container_task *tasks;
+    size_t capacity; // Chunks per batch
+    size_t chunk_size;
+} container_batch;
+
+// Header and verified index of a container being read
+typedef struct
+{
+    uint8_t header[CONTAINER_HEADER_SIZE];
+    size_t chunk_size;
+    uint64_t plain_size;
+    uint64_t chunks;
+} container_info;
+
+// Function to build the 12-byte nonce of one chunk (prefix = chunk number + 1) or of the index
+static void container_nonce(uint8_t *nonce, uint32_t prefix, const uint8_t *base)
+{
+    nonce[0] = (uint8_t)(prefix >> 24);
+    nonce[1] = (uint8_t)(prefix >> 16);
+    nonce[2] = (uint8_t)(prefix >> 8);
+    nonce[3] = (uint8_t)prefix;
+    memcpy(nonce + 4, base, CONTAINER_NONCE_SIZE);
+}
+
+// Function to write all of `length` bytes to a descriptor that may be a pipe
+static int container_write_all(int fd, const uint8_t *buffer, size_t length)
+{
+    uint64_t start = stats_begin();
+    size_t total = length;
+
+    while (length)
+    {
+        ssize_t n = write(fd, buffer, length);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buffer += n;
+        length -= n;
+    }
+    stats_end(STATS_WRITE, start, total);
+    return 0;
+}
+
+// Function to return the plaintext length of chunk `i`
+static size_t container_chunk_length(size_t chunk_size, uint64_t plain_size, uint64_t i)
+{
+    uint64_t start = i * chunk_size;
+    return plain_size - start < chunk_size ? (size_t)(plain_size - start) : chunk_size;
+}
+
+// Function to return the container offset of chunk `i`
+static uint64_t container_chunk_offset(size_t chunk_size, uint64_t i)
+{
+    return CONTAINER_HEADER_SIZE + i * (chunk_size + CONTAINER_TAG_SIZE);
+}
+
+// Function to return the container offset of the index: every chunk has grown by its tag
+static uint64_t container_index_offset(uint64_t plain_size, uint64_t chunks)
+{
+    return CONTAINER_HEADER_SIZE + plain_size + chunks * CONTAINER_TAG_SIZE;
+}
+
+// Pool task: seal or open one chunk
+static void container_worker(void *arg)
+{
+    container_task *task = (container_task *)arg;
+    const container_settings *settings = task->settings;
+    task->result = settings->seal(settings->key, task->nonce, task->aad, task->aad_length,
+                                  task->data, task->length, task->tag, task->encrypt);
+}
+
+// Function to allocate batch buffers: enough chunks to keep every worker busy twice over, within
+// CONTAINER_BATCH_BYTES and never more than `chunks`
+static int container_batch_init(container_batch *batch, const container_settings *settings,
+                                const char *filename, size_t chunk_size, uint64_t chunks)
+{
+    size_t capacity = (size_t)pool_size(settings->workers) * 2;
+    size_t limit = CONTAINER_BATCH_BYTES / (chunk_size + CONTAINER_TAG_SIZE);
+
+    capacity = capacity < limit ? capacity : limit;
+    capacity = capacity < chunks ? capacity : (size_t)chunks;
+    batch->capacity = capacity ? capacity : 1;
+    batch->chunk_size = chunk_size;
+    batch->buffer = malloc(batch->capacity * (chunk_size + CONTAINER_TAG_SIZE));
+    batch->tasks = calloc(batch->capacity, sizeof(container_task));
+    if (!batch->buffer || !batch->tasks)
+    {
+        fprintf(stderr, "%s: Failed to allocate chunk buffers\n", filename);
+        free(batch->buffer);
+        free(batch->tasks);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to wipe and free batch buffers
+static void container_batch_free(container_batch *batch)
+{
+    secure_zero(batch->buffer, batch->capacity * (batch->chunk_size + CONTAINER_TAG_SIZE));
+    free(batch->buffer);
+    free(batch->tasks);
+}
+
+// Function to lay out `n` chunks starting at `first` in the batch buffer; returns their total
+// size with tags
+static size_t container_batch_layout(container_batch *batch, const container_settings *settings,
+                                     const uint8_t *header, uint64_t plain_size, uint64_t first, size_t n, int encrypt)
+{
+    size_t bytes = 0;
+
+    for (size_t j = 0; j < n; j++)
+    {
+        container_task *task = &batch->tasks[j];
+        task->settings = settings;
+        task->aad = header;
+        task->aad_length = CONTAINER_HEADER_SIZE;
+        container_nonce(task->nonce, (uint32_t)(first + j + 1), header + 16);
+        task->data = batch->buffer + bytes;
+        task->length = container_chunk_length(batch->chunk_size, plain_size, first + j);
+        task->tag = task->data + task->length;
+        task->encrypt = encrypt;
+        task->result = 0;
+        bytes += task->length + CONTAINER_TAG_SIZE;
+    }
+    return bytes;
+}
+
+// Function to seal or open the first `n` chunks of a batch across the pool; returns the index of
+// the first chunk that failed, or `n` when all succeeded
+static size_t container_batch_run(container_batch *batch, pool *workers, size_t n)
+{
+    pool_group group = POOL_GROUP_INIT;
+    uint64_t start = stats_begin();
+    size_t j, bytes = 0;
+
+    for (j = 0; j < n; j++)
+    {
+        bytes += batch->tasks[j].length;
+        pool_submit(workers, &group, container_worker, &batch->tasks[j]);
+    }
+    pool_wait(workers, &group);
+    stats_end(STATS_CIPHER, start, bytes);
+    for (j = 0; j < n && batch->tasks[j].result == 0; j++)
+    {
+    }
+    return j;
+}
+
+// Function to seal (or check) the index: plaintext size, chunk count and chunk offsets,
+// authenticated together with the header. The tag goes right after the `length` index bytes
+static int container_seal_index(const container_settings *settings, const uint8_t *header,
+                                uint8_t *index, size_t length, int encrypt)
+{
+    uint8_t nonce[12];
+    uint8_t *aad = malloc(CONTAINER_HEADER_SIZE + length);
+    int result;
+
+    if (!aad)
+    {
+        return -1;
+    }
+    memcpy(aad, header, CONTAINER_HEADER_SIZE);
+    memcpy(aad + CONTAINER_HEADER_SIZE, index, length);
+    container_nonce(nonce, CONTAINER_INDEX_PREFIX, header + 16);
+    uint64_t start = stats_begin();
+    result = settings->seal(settings->key, nonce, aad, CONTAINER_HEADER_SIZE + length, NULL, 0,
+                            index + length, encrypt);
+    stats_end(STATS_CIPHER, start, 0);
+    free(aad);
+    return result;
+}
+
+// Function to write the header, the sealed chunks, the index and the footer to `out_fd`
+static int container_write(const container_settings *settings, const char *filename, int in_fd, int out_fd,
+                           uint64_t plain_size, size_t chunk_size)
+{
+    uint8_t header[CONTAINER_HEADER_SIZE] = {0};
+    uint8_t footer[CONTAINER_FOOTER_SIZE];
+    uint64_t chunks = (plain_size + chunk_size - 1) / chunk_size;
+    uint64_t index_offset = container_index_offset(plain_size, chunks);
+    size_t index_length = 16 + (size_t)chunks * 8;
+    container_batch batch;
+    uint8_t *index;
+    uint64_t first;
+    size_t n, bytes;
+    int result = 0;
+
+    memcpy(header, CONTAINER_MAGIC, 8);
+    store_le(header + 8, CONTAINER_VERSION, 2);
+    header[10] = (uint8_t)settings->algorithm;
+    store_le(header + 12, chunk_size, 4);
+    if (rsa_random(header + 16, CONTAINER_NONCE_SIZE) != 0)
+    {
+        fprintf(stderr, "%s: Failed to generate the container nonce\n", filename);
+        return -1;
+    }
+
+    index = malloc(index_length + CONTAINER_TAG_SIZE);
+    if (!index)
+    {
+        fprintf(stderr, "%s: Failed to allocate the chunk index\n", filename);
+        return -1;
+    }
+    if (container_batch_init(&batch, settings, filename, chunk_size, chunks) != 0)
+    {
+        free(index);
+        return -1;
+    }
+    store_le(index, plain_size, 8);
+    store_le(index + 8, chunks, 8);
+    if (stream_write_full(out_fd, header, sizeof(header), 0) < 0)
+    {
+        perror(filename);
+        result = -1;
+    }
+
+    // Read a batch of chunks, seal them in parallel and write them out contiguously
+    for (first = 0; result == 0 && first < chunks; first += n)
+    {
+        n = chunks - first < batch.capacity ? (size_t)(chunks - first) : batch.capacity;
+        bytes = container_batch_layout(&batch, settings, header, plain_size, first, n, 1);
+        for (size_t j = 0; j < n && result == 0; j++)
+        {
+            store_le(index + 16 + (first + j) * 8, container_chunk_offset(chunk_size, first + j), 8);
+            if (stream_read_full(in_fd, batch.tasks[j].data, batch.tasks[j].length, (off_t)((first + j) * chunk_size)) !=
+                (ssize_t)batch.tasks[j].length)
+            {
+                fprintf(stderr, "%s: File changed or could not be read while it was being encrypted\n", filename);
+                result = -1;
+            }
+        }
+        if (result == 0 && container_batch_run(&batch, settings->workers, n) != n)
+        {
+            fprintf(stderr, "%s: Failed to encrypt a chunk\n", filename);
+            result = -1;
+        }
+        if (result == 0 && stream_progress(bytes - n * CONTAINER_TAG_SIZE) != 0)
+        {
+            fprintf(stderr, "%s: Cancelled\n", filename);
+            result = -1;
+        }
+        if (result == 0 && stream_write_full(out_fd, batch.buffer, bytes, (off_t)container_chunk_offset(chunk_size, first)) < 0)
+        {
+            perror(filename);
+            result = -1;
+        }
+    }
+
+    // Seal and write the index, then the footer that locates it
+    if (result == 0 && container_seal_index(settings, header, index, index_length, 1) != 0)
+    {
+        fprintf(stderr, "%s: Failed to seal the chunk index\n", filename);
+        result = -1;
+    }
+    store_le(footer, index_offset, 8);
+    memcpy(footer + 8, CONTAINER_INDEX_MAGIC, 8);
+    if (result == 0 &&
+        (stream_write_full(out_fd, index, index_length + CONTAINER_TAG_SIZE, (off_t)index_offset) < 0 ||
+         stream_write_full(out_fd, footer, sizeof(footer), (off_t)(index_offset + index_length + CONTAINER_TAG_SIZE)) < 0))
+    {
+        perror(filename);
+        result = -1;
+    }
+
+    container_batch_free(&batch);
+    free(index);
+    return result;
+}
+
+int container_pack(const container_settings *settings, const char *filename)
+{
+    size_t chunk_size = settings->chunk_size ? settings->chunk_size : CONTAINER_DEFAULT_CHUNK;
+    struct stat st;
+    char *tmpname;
+    int in_fd, out_fd, result;
+
+    if (chunk_size < CONTAINER_MIN_CHUNK || chunk_size > CONTAINER_MAX_CHUNK)
+    {
+        fprintf(stderr, "%s: Chunk size must be between 1K and 1G\n", filename);
+        return -1;
+    }
+    in_fd = open(filename, O_RDONLY);
+    if (in_fd < 0)
+    {
+        perror(filename);
+        return -1;
+    }
+    if (fstat(in_fd, &st) < 0)
+    {
+        perror(filename);
+        close(in_fd);
+        return -1;
+    }
+    if (((uint64_t)st.st_size + chunk_size - 1) / chunk_size > CONTAINER_MAX_CHUNKS)
+    {
+        fprintf(stderr, "%s: File has too many chunks; use a larger chunk size\n", filename);
+        close(in_fd);
+        return -1;
+    }
+
+    out_fd = stream_create_temp(filename, st.st_mode, &tmpname);
+    if (out_fd < 0)
+    {
+        close(in_fd);
+        return -1;
+    }
+    result = container_write(settings, filename, in_fd, out_fd, st.st_size, chunk_size);
+    close(in_fd);
+    return stream_commit_temp(filename, out_fd, tmpname, result);
+}
+
+// Function to check the index read from a container: it must authenticate and describe exactly
+// the layout container_write produces
+static int container_check_index(const container_settings *settings, const char *filename, container_info *info,
+                                 uint8_t *index, size_t index_length, uint64_t index_offset)
+{
+    if (container_seal_index(settings, info->header, index, index_length, 0) != 0)
+    {
+        fprintf(stderr, "%s: Authentication failed (wrong key, or the container was modified)\n", filename);
+        return -1;
+    }
+    info->plain_size = load_le(index, 8);
+    info->chunks = load_le(index + 8, 8);
+    if (info->chunks > CONTAINER_MAX_CHUNKS || index_length != 16 + info->chunks * 8 ||
+        info->chunks != (info->plain_size + info->chunk_size - 1) / info->chunk_size ||
+        index_offset != container_index_offset(info->plain_size, info->chunks))
+    {
+        fprintf(stderr, "%s: Corrupt chunk index\n", filename);
+        return -1;
+    }
+    for (uint64_t i = 0; i < info->chunks; i++)
+    {
+        if (load_le(index + 16 + i * 8, 8) != container_chunk_offset(info->chunk_size, i))
+        {
+            fprintf(stderr, "%s: Corrupt chunk index\n", filename);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to read and check a container's header and index; returns 0, or -1 (reported)
+static int container_open(const container_settings *settings, const char *filename, int fd, container_info *info)
+{
+    uint8_t footer[CONTAINER_FOOTER_SIZE];
+    struct stat st;
+    uint64_t index_offset;
+    size_t index_length;
+    uint8_t *index;
+    int result;
+
+    if (fstat(fd, &st) < 0)
+    {
+        perror(filename);
+        return -1;
+    }
+    if ((uint64_t)st.st_size < CONTAINER_HEADER_SIZE + 16 + CONTAINER_TAG_SIZE + CONTAINER_FOOTER_SIZE ||
+        stream_read_full(fd, info->header, CONTAINER_HEADER_SIZE, 0) != CONTAINER_HEADER_SIZE ||
+        stream_read_full(fd, footer, sizeof(footer), st.st_size - sizeof(footer)) != sizeof(footer) ||
+        memcmp(info->header, CONTAINER_MAGIC, 8) != 0 || memcmp(footer + 8, CONTAINER_INDEX_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "%s: Not an encrypted container\n", filename);
+        return -1;
+    }
+    if (load_le(info->header + 8, 2) != CONTAINER_VERSION)
+    {
+        fprintf(stderr, "%s: Unsupported container version %u\n", filename, (unsigned)load_le(info->header + 8, 2));
+        return -1;
+    }
+    if (info->header[10] != settings->algorithm)
+    {
+        fprintf(stderr, "%s: Container was encrypted with a different algorithm\n", filename);
+        return -1;
+    }
+
+    // The index runs from the offset in the footer up to its tag, just before the footer
+    info->chunk_size = (size_t)load_le(info->header + 12, 4);
+    index_offset = load_le(footer, 8);
+    if (info->chunk_size < CONTAINER_MIN_CHUNK || info->chunk_size > CONTAINER_MAX_CHUNK ||
+        index_offset < CONTAINER_HEADER_SIZE ||
+        index_offset > (uint64_t)st.st_size - sizeof(footer) - 16 - CONTAINER_TAG_SIZE)
+    {
+        fprintf(stderr, "%s: Corrupt container header\n", filename);
+        return -1;
+    }
+    index_length = (size_t)(st.st_size - sizeof(footer) - index_offset - CONTAINER_TAG_SIZE);
+    index = malloc(index_length + CONTAINER_TAG_SIZE);
+    if (!index)
+    {
+        fprintf(stderr, "%s: Failed to allocate the chunk index\n", filename);
+        return -1;
+    }
+    if (stream_read_full(fd, index, index_length + CONTAINER_TAG_SIZE, (off_t)index_offset) !=
+        (ssize_t)(index_length + CONTAINER_TAG_SIZE))
+    {
+        fprintf(stderr, "%s: Failed to read the chunk index\n", filename);
+        result = -1;
+    }
+    else
+    {
+        result = container_check_index(settings, filename, info, index, index_length, index_offset);
+    }
+    free(index);
+    return result;
+}
+
+// Function to read chunks [first, first + n) into the batch and open them in parallel. Returns 0,
+// or -1 (reported) when the read fails or a chunk does not authenticate
+static int container_read_chunks(const container_settings *settings, const char *filename, int fd,
+                                 const container_info *info, container_batch *batch, uint64_t first, size_t n)
+{
+    size_t bytes = container_batch_layout(batch, settings, info->header, info->plain_size, first, n, 0);
+    size_t failed;
+
+    if (stream_read_full(fd, batch->buffer, bytes, (off_t)container_chunk_offset(info->chunk_size, first)) != (ssize_t)bytes)
+    {
+        fprintf(stderr, "%s: Failed to read chunks\n", filename);
+        return -1;
+    }
+    failed = container_batch_run(batch, settings->workers, n);
+    if (failed != n)
+    {
+        fprintf(stderr, "%s: Authentication failed for chunk %llu (wrong key, or the container was modified)\n",
+                filename, (unsigned long long)(first + failed));
+        return -1;
+    }
+    return 0;
+}
+
+// Function to write the plaintext of every chunk to `out_fd`
+static int container_read(const container_settings *settings, const char *filename, int in_fd, int out_fd,
+                          const container_info *info)
+{
+    container_batch batch;
+    uint64_t first;
+    size_t n;
+    int result = 0;
+
+    if (container_batch_init(&batch, settings, filename, info->chunk_size, info->chunks) != 0)
+    {
+        return -1;
+    }
+    for (first = 0; result == 0 && first < info->chunks; first += n)
+    {
+        n = info->chunks - first < batch.capacity ? (size_t)(info->chunks - first) : batch.capacity;
+        result = container_read_chunks(settings, filename, in_fd, info, &batch, first, n);
+        uint64_t end = (first + n) * info->chunk_size;
+        if (result == 0 && stream_progress((end < info->plain_size ? end : info->plain_size) - first * info->chunk_size) != 0)
+        {
+            fprintf(stderr, "%s: Cancelled\n", filename);
+            result = -1;
+        }
+        for (size_t j = 0; result == 0 && j < n; j++)
+        {
+            if (stream_write_full(out_fd, batch.tasks[j].data, batch.tasks[j].length,
+                                  (off_t)((first + j) * info->chunk_size)) < 0)
+            {
+                perror(filename);
+                result = -1;
+            }
+        }
+    }
+    container_batch_free(&batch);
+    return result;
+}
+
+int container_unpack(const container_settings *settings, const char *filename)
+{
+    container_info info;
+    struct stat st;
+    char *tmpname;
+    int in_fd, out_fd, result;
+
+    in_fd = open(filename, O_RDONLY);
+    if (in_fd < 0)
+    {
+        perror(filename);
+        return -1;
+    }
+    if (fstat(in_fd, &st) < 0 || container_open(settings, filename, in_fd, &info) != 0)
+    {
+        close(in_fd);
+        return -1;
+    }
+    out_fd = stream_create_temp(filename, st.st_mode, &tmpname);
+    if (out_fd < 0)
+    {
+        close(in_fd);
+        return -1;
+    }
+    result = container_read(settings, filename, in_fd, out_fd, &info);
+    if (result != 0)
+    {
+        fprintf(stderr, "%s: File left unchanged\n", filename);
+    }
+    close(in_fd);
+    return stream_commit_temp(filename, out_fd, tmpname, result);
+}
+
+// Function to write the plaintext bytes [offset, end) to `fd`, opening only the chunks they span
+static int container_read_range(const container_settings *settings, const char *filename, int in_fd, int fd,
+                                const container_info *info, uint64_t offset, uint64_t end)
+{
+    uint64_t first = offset / info->chunk_size;
+    uint64_t last = (end - 1) / info->chunk_size;
+    container_batch batch;
+    size_t n;
+    int result = 0;
+
+    if (container_batch_init(&batch, settings, filename, info->chunk_size, last - first + 1) != 0)
+    {
+        return -1;
+    }
+    for (; result == 0 && first <= last; first += n)
+    {
+        n = last - first + 1 < batch.capacity ? (size_t)(last - first + 1) : batch.capacity;
+        result = container_read_chunks(settings, filename, in_fd, info, &batch, first, n);
+        for (size_t j = 0; result == 0 && j < n; j++)
+        {
+            uint64_t start = (first + j) * info->chunk_size;
+            uint64_t from = offset > start ? offset - start : 0;
+            uint64_t to = end - start < batch.tasks[j].length ? end - start : batch.tasks[j].length;
+            if (container_write_all(fd, batch.tasks[j].data + from, (size_t)(to - from)) < 0)
+            {
+                perror("Failed to write the extracted range");
+                result = -1;
+            }
+        }
+    }
+    container_batch_free(&batch);
+    return result;
+}
+
+int container_extract(const container_settings *settings, const char *filename, uint64_t offset,
+                      uint64_t length, int fd)
+{
+    container_info info;
+    int in_fd, result = 0;
+
+    in_fd = open(filename, O_RDONLY);
+    if (in_fd < 0)
+    {
+        perror(filename);
+        return -1;
+    }
+    if (container_open(settings, filename, in_fd, &info) != 0)
+    {
+        result = -1;
+    }
+    else if (offset < info.plain_size && length > 0)
+    {
+        uint64_t end = length > info.plain_size - offset ? info.plain_size : offset + length;
+        result = container_read_range(settings, filename, in_fd, fd, &info, offset, end);
+    }
+    close(in_fd);
+    return result;
+}
+
+int container_self_test(const container_settings *settings)
+{
+    uint8_t plain[3 * CONTAINER_MIN_CHUNK + 100], opened[sizeof(plain) + 1], sealed[2][sizeof(plain) + 512];
+    container_settings small = *settings;
+    FILE *files[4] = {tmpfile(), tmpfile(), tmpfile(), tmpfile()};
+    ssize_t lengths[2] = {-1, -1};
+    int ok = files[0] && files[1] && files[2] && files[3];
+
+    for (size_t i = 0; i < sizeof(plain); i++)
+    {
+        plain[i] = (uint8_t)(i * 7 + 1);
+    }
+    small.chunk_size = CONTAINER_MIN_CHUNK;
+    ok = ok && stream_write_full(fileno(files[0]), plain, sizeof(plain), 0) == 0;
+
+    // Pack the same data twice, then unpack each container into the fourth file
+    for (int i = 0; ok && i < 2; i++)
+    {
+        container_info info;
+        ok = container_write(&small, "container self-test", fileno(files[0]), fileno(files[i + 1]),
+                             sizeof(plain), CONTAINER_MIN_CHUNK) == 0;
+        lengths[i] = ok ? stream_read_full(fileno(files[i + 1]), sealed[i], sizeof(sealed[i]), 0) : -1;
+        ok = ok && lengths[i] > CONTAINER_HEADER_SIZE &&
+             container_open(&small, "container self-test", fileno(files[i + 1]), &info) == 0 &&
+             ftruncate(fileno(files[3]), 0) == 0 &&
+             container_read(&small, "container self-test", fileno(files[i + 1]), fileno(files[3]), &info) == 0 &&
+             stream_read_full(fileno(files[3]), opened, sizeof(opened), 0) == (ssize_t)sizeof(plain) &&
+             memcmp(opened, plain, sizeof(plain)) == 0;
+    }
+
+    // The nonces (header bytes 16-23) and every chunk must differ
+    ok = ok && lengths[0] == lengths[1] && memcmp(sealed[0] + 16, sealed[1] + 16, CONTAINER_NONCE_SIZE) != 0;
+    for (uint64_t i = 0; ok && i < (sizeof(plain) + CONTAINER_MIN_CHUNK - 1) / CONTAINER_MIN_CHUNK; i++)
+    {
+        uint64_t offset = container_chunk_offset(CONTAINER_MIN_CHUNK, i);
+        ok = memcmp(sealed[0] + offset, sealed[1] + offset, 16) != 0;
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (files[i])
+        {
+            fclose(files[i]);
+        }
+    }
+    return ok ? 0 : -1;
+}
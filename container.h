@@ -0,0 +1,68 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+// Encrypted container layout (integers little-endian):
+//
+//   header   32 bytes: magic "FCRYPTCX", u16 version, u8 algorithm, u8 0, u32 chunk size,
+//            8-byte nonce (random, drawn for each container), 8 zero bytes
+//   chunks   each chunk-size bytes of ciphertext (the last one shorter) followed by its 16-byte tag
+//   index    u64 plaintext size, u64 chunk count, u64 offset of every chunk, 16-byte tag
+//   footer   u64 offset of the index, magic "FCXINDEX"
+//
+// Every chunk is sealed on its own with a 12-byte nonce of big-endian (chunk number + 1) followed
+// by the 8-byte nonce, and the header as additional data, so any chunk can be decrypted and
+// authenticated without the others. The index is sealed as additional data under the nonce prefix
+// 0xffffffff, so chunks cannot be dropped, reordered or appended. Plain AEAD files use the prefix
+// 0, so a container never reuses their keystream. As the nonce is drawn afresh, containers written
+// with the same key do not share chunk nonces either
+#define CONTAINER_MAGIC "FCRYPTCX"
+#define CONTAINER_INDEX_MAGIC "FCXINDEX"
+#define CONTAINER_VERSION 1
+#define CONTAINER_HEADER_SIZE 32
+#define CONTAINER_FOOTER_SIZE 16
+#define CONTAINER_TAG_SIZE 16
+#define CONTAINER_NONCE_SIZE 8
+#define CONTAINER_DEFAULT_CHUNK (1 << 20)
+#define CONTAINER_MIN_CHUNK (1 << 10)
+#define CONTAINER_MAX_CHUNK (1 << 30)
+#define CONTAINER_MAX_CHUNKS 0xfffffffeu // Chunk numbers + 1 must stay below the index prefix
+
+// Seals (`encrypt` set: writes the tag) or opens (checks the tag; returns -1 on a mismatch) one
+// message in place with a 12-byte nonce and additional data
+typedef int (*container_seal_fn)(void *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                                 uint8_t *data, size_t length, uint8_t *tag, int encrypt);
+
+// Settings shared by every file in a run
+typedef struct
+{
+    int algorithm;                         // Recorded in the header; opening requires a match
+    size_t chunk_size;                     // Plaintext bytes per chunk for new containers (0 = default)
+    container_seal_fn seal;
+    void *key;                             // Passed to `seal`
+    pool *workers;                         // Chunks are sealed and opened in parallel
+} container_settings;
+
+// Function to rewrite a plain file as a container; returns 0 on success
+int container_pack(const container_settings *settings, const char *filename);
+
+// Function to rewrite a container as the plain file, authenticating every chunk first; a file
+// that does not verify is left unchanged. Returns 0 on success
+int container_unpack(const container_settings *settings, const char *filename);
+
+// Function to decrypt `length` bytes of plaintext starting at `offset` and write them to `fd`,
+// reading and authenticating only the index and the chunks that hold the range. The range is
+// clipped to the end of the plaintext, and only authenticated bytes are written. Returns 0 on success
+int container_extract(const container_settings *settings, const char *filename, uint64_t offset,
+                      uint64_t length, int fd);
+
+// Function to check that two containers packed from the same data with the same settings get
+// different nonces and ciphertexts, and that both unpack to the data. Works on unlinked temporary
+// files; returns 0 on success
+int container_self_test(const container_settings *settings);
+
+#endif
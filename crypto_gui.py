@@ -1,62 +1,293 @@
+import ctypes
+import os
+import queue
+import socket
+import stat
+import struct
 import subprocess
+import sys
+import threading
+import time
 import tkinter as tk
-from tkinter import filedialog, simpledialog, messagebox
+from tkinter import filedialog, simpledialog, messagebox, ttk
 
-# Define a function to run the selected cryptographic program with provided inputs.
-def run_program(program, filepath, mode):
-    if program == 'rsa':
-        n = simpledialog.askinteger("RSA", "Enter the modulus n (product of two primes):", parent=root)
-        if n is None:
-            messagebox.showerror("Error", "Modulus n is required for RSA.")
+# Load libfilecrypt from the directory of this script so AES and ChaCha20 run in-process.
+LIB_NAME = {'darwin': 'libfilecrypt.dylib', 'win32': 'filecrypt.dll'}.get(sys.platform, 'libfilecrypt.so')
+filecrypt = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), LIB_NAME))
+PROGRESS_FN = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64, ctypes.c_int)
+filecrypt.filecrypt_job_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t,
+                                           ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p]
+filecrypt.filecrypt_job_create.restype = ctypes.c_void_p
+filecrypt.filecrypt_job_set_progress.argtypes = [ctypes.c_void_p, PROGRESS_FN, ctypes.c_void_p]
+filecrypt.filecrypt_job_set_progress.restype = None
+filecrypt.filecrypt_job_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+filecrypt.filecrypt_job_file.restype = ctypes.c_int
+filecrypt.filecrypt_job_free.argtypes = [ctypes.c_void_p]
+filecrypt.filecrypt_job_free.restype = None
+
+# Values of filecrypt_algorithm, filecrypt_mode and filecrypt_file_state in filecrypt.h
+FILECRYPT_AES_ECB, FILECRYPT_AES_CTR, FILECRYPT_CHACHA20 = 0, 1, 2
+FILECRYPT_MODES = {'decrypt': 0, 'encrypt': 1}
+FILECRYPT_FILE_RUNNING = 0
+
+# When filecryptd is running, files are handed to it over its socket, so its keys and worker threads stay warm.
+# The socket is in the user's runtime directory, or else in a private directory filecryptd makes under /tmp.
+DAEMON_SOCKET_NAME = 'filecryptd.sock'
+DAEMON_ALGORITHMS = {FILECRYPT_AES_ECB: 'aes-ecb', FILECRYPT_AES_CTR: 'aes-ctr', FILECRYPT_CHACHA20: 'chacha20'}
+
+# Names of the programs as the window shows them.
+PROGRAM_NAMES = {'aes': "AES", 'chacha20': "ChaCha20", 'rsa': "RSA"}
+
+# How often the job table is redrawn, in milliseconds.
+REFRESH_MS = 250
+
+# A file waiting in, or taken from, the job queue. The worker thread updates the progress fields and the
+# window reads them; `lock` orders a cancel from the window against the worker starting the job.
+class Job:
+    def __init__(self, program, algorithm, filepath, key, nonce, mode):
+        self.program = program
+        self.algorithm = algorithm
+        self.filepath = os.path.abspath(filepath)
+        self.key = key
+        self.nonce = nonce
+        self.mode = mode
+        self.total = os.path.getsize(filepath)
+        self.processed = 0
+        self.state = 'Queued'
+        self.started = None
+        self.finished = None
+        self.cancelled = False
+        self.connection = None
+        self.lock = threading.Lock()
+
+    # Function to cancel the job: a queued job is skipped, a running one fails and leaves its file unchanged.
+    def cancel(self):
+        with self.lock:
+            self.cancelled = True
+            connection = self.connection
+        if connection:
+            try:
+                connection.sendall(b'cancel\n')
+            except OSError:
+                pass
+
+    # Function to return the job's row in the table: file, operation, state, progress, throughput and ETA.
+    def columns(self):
+        end = self.finished or time.monotonic()
+        elapsed = end - self.started if self.started else 0
+        rate = self.processed / elapsed if elapsed > 0 else 0
+        percent = min(100, 100 * self.processed // self.total) if self.total else (100 if self.finished else 0)
+        eta = ''
+        if self.state == 'Running' and rate > 0:
+            eta = '%d s' % max(0, (self.total - self.processed) / rate)
+        speed = '%.1f MB/s' % (rate / 1e6) if rate else ''
+        return (os.path.basename(self.filepath), f"{PROGRAM_NAMES[self.program]} {self.mode}", self.state,
+                f"{percent}%", speed, eta)
+
+# Function to escape a request value for filecryptd (bytes other than printable ASCII, spaces and % become %XX).
+def daemon_escape(value):
+    return ''.join(chr(c) if 0x20 < c < 0x7f and c != 0x25 else '%%%02X' % c for c in value)
+
+# Function to return the daemon's socket path, or None unless its directory is one only this user can use (anyone
+# could otherwise listen there first and be sent the keys).
+def daemon_socket():
+    if not hasattr(os, 'getuid'):
+        return None
+    directory = os.environ.get('XDG_RUNTIME_DIR') or f"/tmp/filecryptd-{os.getuid()}"
+    try:
+        info = os.lstat(directory)
+    except OSError:
+        return None
+    if not stat.S_ISDIR(info.st_mode) or info.st_uid != os.getuid() or info.st_mode & 0o077:
+        return None
+    return os.path.join(directory, DAEMON_SOCKET_NAME)
+
+# Function to tell whether the process listening on a connected socket belongs to this user.
+def daemon_trusted(connection):
+    if hasattr(socket, 'SO_PEERCRED'):
+        credentials = connection.getsockopt(socket.SOL_SOCKET, socket.SO_PEERCRED, struct.calcsize('3i'))
+        return struct.unpack('3i', credentials)[1] == os.getuid()
+    # Without peer credentials, trust a socket this user owns in the private directory
+    info = os.lstat(connection.getpeername())
+    return stat.S_ISSOCK(info.st_mode) and info.st_uid == os.getuid()
+
+# Function to run a job through filecryptd, following its progress lines; returns None when the daemon is not running
+# or cannot be trusted with the key.
+def run_daemon(job):
+    words = ['run', 'algorithm=' + DAEMON_ALGORITHMS[job.algorithm], 'mode=' + job.mode,
+             'key=' + daemon_escape(job.key), 'path=' + daemon_escape(os.fsencode(job.filepath))]
+    if job.nonce:
+        words.append('nonce=' + daemon_escape(job.nonce))
+    path = daemon_socket() if hasattr(socket, 'AF_UNIX') else None
+    if not path:
+        return None
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+        try:
+            connection.connect(path)
+            if not daemon_trusted(connection):
+                return None
+        except OSError:
+            return None
+        try:
+            connection.sendall(' '.join(words).encode() + b'\n')
+            with job.lock:
+                job.connection = connection
+                cancelled = job.cancelled
+            if cancelled:
+                connection.sendall(b'cancel\n')
+            for line in connection.makefile('rb'):
+                fields = line.split()
+                if len(fields) == 3 and fields[0] == b'progress':
+                    job.processed = int(fields[2])
+                elif fields and fields[0] in (b'done', b'error'):
+                    return fields == [b'done', b'0']
+        except OSError:
+            pass
+        finally:
+            with job.lock:
+                job.connection = None
+    return False
+
+# Function to run a job with libfilecrypt in-process, counting the bytes the engine reports.
+def run_in_process(job):
+    handle = filecrypt.filecrypt_job_create(job.algorithm, FILECRYPT_MODES[job.mode], job.key, len(job.key),
+                                            job.nonce, len(job.nonce) if job.nonce else 0, None)
+    if not handle:
+        return False
+
+    # Called on the thread running the file; a non-zero return cancels it and the file is left unchanged
+    def progress(arg, path, count, state):
+        if state == FILECRYPT_FILE_RUNNING:
+            job.processed += count
+        return 1 if job.cancelled else 0
+
+    callback = PROGRESS_FN(progress)
+    filecrypt.filecrypt_job_set_progress(handle, callback, None)
+    status = filecrypt.filecrypt_job_file(handle, os.fsencode(job.filepath))
+    filecrypt.filecrypt_job_free(handle)
+    return status == 0
+
+# Function to run one job on the worker thread and record how it ended.
+def run_job(job):
+    with job.lock:
+        if job.cancelled:
+            job.state = 'Cancelled'
+            job.finished = time.monotonic()
             return
-        exp_label = "Enter the public exponent e for encryption:" if mode == 'encrypt' else "Enter the private exponent d for decryption:"
-        exp = simpledialog.askinteger("RSA", exp_label, parent=root)
-        if exp is None:
-            messagebox.showerror("Error", "Exponent is required for RSA.")
+        job.state = 'Running'
+        job.started = time.monotonic()
+    if job.program == 'rsa':
+        # One RSA operation on a small file: it finishes at once, so it is not cancelled once started
+        result = subprocess.run(['./rsa', job.filepath, job.key, job.mode], capture_output=True, text=True)
+        succeeded = result.returncode == 0
+    else:
+        succeeded = run_daemon(job)
+        if succeeded is None:
+            succeeded = run_in_process(job)
+    job.finished = time.monotonic()
+    if succeeded:
+        job.processed = job.total
+    job.state = 'Done' if succeeded else 'Cancelled' if job.cancelled else 'Failed'
+
+# Worker thread: run queued jobs one at a time, each on every core, so the window stays responsive.
+def worker():
+    while True:
+        job = job_queue.get()
+        try:
+            run_job(job)
+        finally:
+            job_queue.task_done()
+
+# Function to queue jobs for the selected files and add them to the table.
+def submit(program, algorithm, filepaths, key, nonce, mode):
+    for filepath in filepaths:
+        job = Job(program, algorithm, filepath, key, nonce, mode)
+        job.row = table.insert('', tk.END, values=job.columns())
+        jobs.append(job)
+        job_queue.put(job)
+
+# Define a function to ask for the key of the selected cryptographic program and queue the files.
+def run_program(program, filepaths, mode):
+    if program == 'rsa':
+        key_title = "Select the RSA public key" if mode == 'encrypt' else "Select the RSA private key"
+        keypath = filedialog.askopenfilename(title=key_title)
+        if not keypath:
+            messagebox.showerror("Error", "A key file is required for RSA (create one with ./rsa --genkey).")
             return
-        subprocess.run(['./rsa', filepath, str(n), str(exp), mode])
+        submit(program, None, filepaths, keypath, None, mode)
     elif program == 'aes':
-        key = simpledialog.askstring("AES Key", "Enter the 16-byte key for AES operation (exactly 16 characters):", parent=root)
+        key = simpledialog.askstring("AES Key", "Enter the key for AES operation (16, 24 or 32 characters for AES-128, AES-192 or AES-256):", parent=root)
         if key:
-            print(f"Key length: {len(key)}")
-            if len(key) == 16:
-                subprocess.run(['/Users/rahmancoban/D/marmara/zErasmus/Romanya/4.Semester (24:Spr)/Security And Criptoraphy/abdurrahman_coban_2/aes', filepath, key, mode])
+            if len(key) in (16, 24, 32):
+                submit(program, FILECRYPT_AES_ECB, filepaths, key.encode(), None, mode)
             else:
-                messagebox.showerror("Error", "Key must be exactly 16 characters long.")
+                messagebox.showerror("Error", "Key must be 16, 24 or 32 characters long.")
     elif program == 'chacha20':
         key = simpledialog.askstring("ChaCha20 Key", "Enter the 32-byte key for ChaCha20 operation (exactly 32 characters):", parent=root)
         nonce = simpledialog.askstring("ChaCha20 Nonce", "Enter the 8-byte nonce for ChaCha20 operation (exactly 8 characters):", parent=root)
         if key and nonce:
-            print(f"Key: {key}, Key length: {len(key)}")
-            print(f"Nonce: {nonce}, Nonce length: {len(nonce)}")
             if len(key) == 32 and len(nonce) == 8:
-                subprocess.run(['/Users/rahmancoban/D/marmara/zErasmus/Romanya/4.Semester (24:Spr)/Security And Criptoraphy/abdurrahman_coban_2/chacha20', filepath, key, nonce, mode])
+                submit(program, FILECRYPT_CHACHA20, filepaths, key.encode(), nonce.encode(), mode)
             else:
                 messagebox.showerror("Error", "Key must be exactly 32 characters long and nonce must be exactly 8 characters long.")
     else:
         messagebox.showerror("Error", "Unsupported algorithm selected.")
 
 # Function to open a file selection dialog.
-def select_file():
-    return filedialog.askopenfilename()
+def select_files():
+    return root.tk.splitlist(filedialog.askopenfilenames())
 
 # Function to handle encrypt or decrypt actions.
 def encrypt_or_decrypt(mode):
     program = program_var.get()
-    filepath = select_file()
-    if filepath:
-        run_program(program, filepath, mode)
+    filepaths = select_files()
+    if filepaths:
+        run_program(program, filepaths, mode)
+
+# Function to cancel the selected jobs, or every unfinished job when none is selected.
+def cancel_jobs():
+    selected = set(table.selection())
+    for job in jobs:
+        if (not selected or job.row in selected) and job.finished is None:
+            job.cancel()
+
+# Function to redraw the table from the jobs' progress.
+def refresh():
+    for job in jobs:
+        table.item(job.row, values=job.columns())
+    root.after(REFRESH_MS, refresh)
+
+# Function to close the window only once the running job has stopped, so no file is left half-written.
+def close():
+    for job in jobs:
+        job.cancel()
+    if job_queue.unfinished_tasks:
+        root.after(REFRESH_MS, close)
+    else:
+        root.destroy()
 
 # Setup the main window of the application using tkinter.
 root = tk.Tk()
 root.title("Cryptography GUI")
 
 program_var = tk.StringVar(value="RSA")
-options = {'AES': "aes", 'ChaCha20': "chacha20", 'RSA': "rsa"}
-for text, value in options.items():
+for value, text in PROGRAM_NAMES.items():
     tk.Radiobutton(root, text=text, variable=program_var, value=value).pack(anchor=tk.W)
 
+columns = ('File', 'Operation', 'State', 'Progress', 'Speed', 'ETA')
+table = ttk.Treeview(root, columns=columns, show='headings', height=8)
+for column in columns:
+    table.heading(column, text=column)
+    table.column(column, width=220 if column == 'File' else 90)
+table.pack(fill=tk.BOTH, expand=True, padx=10)
+
 tk.Button(root, text="Encrypt File", command=lambda: encrypt_or_decrypt('encrypt')).pack(side=tk.LEFT, padx=10, pady=10)
 tk.Button(root, text="Decrypt File", command=lambda: encrypt_or_decrypt('decrypt')).pack(side=tk.LEFT, padx=10, pady=10)
+tk.Button(root, text="Cancel", command=cancel_jobs).pack(side=tk.LEFT, padx=10, pady=10)
 
+jobs = []
+job_queue = queue.Queue()
+threading.Thread(target=worker, daemon=True).start()
+root.protocol("WM_DELETE_WINDOW", close)
+root.after(REFRESH_MS, refresh)
 root.mainloop()
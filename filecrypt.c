@@ -0,0 +1,960 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aes.h"
+#include "batch.h"
+#include "bytes.h"
+#include "chacha20.h"
+#include "container.h"
+#include "filecrypt.h"
+#include "gcm.h"
+#include "hybrid.h"
+#include "pool.h"
+#include "stats.h"
+#include "stream.h"
+
+// Streaming context. For AES-ECB `pending` holds input not yet processed and for AEAD decryption
+// the held-back tag candidate; for the stream ciphers it holds the keystream block in
+// use, of which the last `pending_len` bytes are still unused
+struct filecrypt_ctx
+{
+    filecrypt_algorithm algorithm;
+    int encrypt;
+    int finished;
+    aes_ctx aes;
+    uint8_t nonce[FILECRYPT_NONCE_SIZE];
+    uint64_t counter; // AES-CTR: next counter block
+    chacha20_ctx chacha20;
+    chacha20_poly1305_ctx aead;
+    aes_gcm_ctx gcm; // Borrows `aes`
+    uint8_t pending[64];
+    size_t pending_len;
+};
+
+// File job: one expanded key and one worker pool for any number of files
+struct filecrypt_job
+{
+    filecrypt_algorithm algorithm;
+    uint8_t nonce[FILECRYPT_IETF_NONCE_SIZE]; // AES-CTR nonce or AES-GCM IV
+    size_t buffer_size; // As requested; 0 lets each run choose
+    aes_job aes;
+    chacha20_job_settings chacha20;
+    uint8_t key[FILECRYPT_CHACHA20_KEY_SIZE]; // ChaCha20-Poly1305 key for container chunks
+    container_settings container;             // Used when `container.seal` is set
+    rsa_key *rsa; // Hybrid jobs: every file has its own key, wrapped with this one
+    int encrypt;
+    pool *workers;
+    int shared;   // The workers belong to a filecrypt_pool
+    stream_arena *arena; // Direct I/O buffers, shared by the job's files
+    filecrypt_progress_fn progress;
+    void *progress_arg;
+};
+
+// Worker pool shared by jobs
+struct filecrypt_pool
+{
+    pool *workers;
+};
+
+// Progress of one file, the argument of the stream engine's callback while the file runs
+typedef struct
+{
+    filecrypt_job *job;
+    const char *path;
+} filecrypt_progress;
+
+// Function to check the algorithm, key and nonce lengths; sets errno and returns -1 when invalid
+static int filecrypt_check(filecrypt_algorithm algorithm, size_t key_len, const uint8_t *nonce, size_t nonce_len)
+{
+    int ok;
+    switch (algorithm)
+    {
+    case FILECRYPT_AES_ECB:
+        ok = AES_VALID_KEY_SIZE(key_len);
+        break;
+    case FILECRYPT_AES_CTR:
+        ok = AES_VALID_KEY_SIZE(key_len) && nonce && nonce_len == FILECRYPT_NONCE_SIZE;
+        break;
+    case FILECRYPT_CHACHA20:
+        ok = key_len == FILECRYPT_CHACHA20_KEY_SIZE && nonce && nonce_len == FILECRYPT_NONCE_SIZE;
+        break;
+    case FILECRYPT_CHACHA20_POLY1305:
+        ok = key_len == FILECRYPT_CHACHA20_KEY_SIZE && nonce &&
+             (nonce_len == FILECRYPT_NONCE_SIZE || nonce_len == FILECRYPT_IETF_NONCE_SIZE);
+        break;
+    case FILECRYPT_AES_GCM:
+        ok = AES_VALID_KEY_SIZE(key_len) && nonce &&
+             (nonce_len == FILECRYPT_NONCE_SIZE || nonce_len == FILECRYPT_IETF_NONCE_SIZE);
+        break;
+    default:
+        ok = 0;
+        break;
+    }
+    if (!ok)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to tell whether an algorithm authenticates (appends or checks a tag)
+static int filecrypt_is_aead(filecrypt_algorithm algorithm)
+{
+    return algorithm == FILECRYPT_CHACHA20_POLY1305 || algorithm == FILECRYPT_AES_GCM;
+}
+
+// Function to widen an 8-byte nonce to a 12-byte AEAD nonce by prefixing four zero bytes
+static void filecrypt_ietf_nonce(uint8_t *ietf, const uint8_t *nonce, size_t nonce_len)
+{
+    memset(ietf, 0, FILECRYPT_IETF_NONCE_SIZE);
+    memcpy(ietf + FILECRYPT_IETF_NONCE_SIZE - nonce_len, nonce, nonce_len);
+}
+
+int filecrypt_version(void)
+{
+    return FILECRYPT_VERSION;
+}
+
+size_t filecrypt_parse_size(const char *text)
+{
+    return stream_parse_size(text);
+}
+
+void filecrypt_wipe(void *p, size_t n)
+{
+    secure_zero(p, n);
+}
+
+void filecrypt_set_portable(int portable)
+{
+    aes_set_portable(portable);
+    chacha20_set_scalar(portable);
+}
+
+void filecrypt_stats_enable(int enable)
+{
+    stats_enable(enable);
+}
+
+void filecrypt_stats_print(FILE *out, int json)
+{
+    stats_print(out, json);
+}
+
+const char *filecrypt_engine_name(filecrypt_algorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case FILECRYPT_CHACHA20:
+    case FILECRYPT_CHACHA20_POLY1305:
+        return chacha20_engine_name();
+    case FILECRYPT_AES_GCM:
+        return aes_gcm_engine_name();
+    default:
+        return aes_engine_name();
+    }
+}
+
+// Function to check that containers sealed twice with the same key and nonce differ
+static int filecrypt_container_self_test(filecrypt_algorithm algorithm)
+{
+    static const uint8_t key[FILECRYPT_CHACHA20_KEY_SIZE] = "container-self-test-key-32-bytes";
+    filecrypt_options options = {0};
+    options.threads = 1;
+    options.container = 1;
+
+    filecrypt_job *job = filecrypt_job_create(algorithm, FILECRYPT_ENCRYPT, key,
+                                              algorithm == FILECRYPT_AES_GCM ? FILECRYPT_AES_KEY_SIZE : sizeof(key),
+                                              (const uint8_t *)"selftest", FILECRYPT_NONCE_SIZE, &options);
+    int ok = job && container_self_test(&job->container) == 0;
+    filecrypt_job_free(job);
+    return ok;
+}
+
+int filecrypt_self_test(filecrypt_algorithm algorithm)
+{
+    int ok;
+    switch (algorithm)
+    {
+    case FILECRYPT_CHACHA20:
+        ok = chacha20_self_test();
+        break;
+    case FILECRYPT_CHACHA20_POLY1305:
+        ok = chacha20_self_test() && chacha20_poly1305_self_test() && filecrypt_container_self_test(algorithm);
+        break;
+    case FILECRYPT_AES_GCM:
+        ok = aes_self_test() && aes_gcm_self_test() && filecrypt_container_self_test(algorithm);
+        break;
+    default:
+        ok = aes_self_test();
+        break;
+    }
+    return ok ? 0 : -1;
+}
+
+filecrypt_ctx *filecrypt_init(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                              const uint8_t *key, size_t key_len,
+                              const uint8_t *nonce, size_t nonce_len)
+{
+    if (filecrypt_check(algorithm, key_len, nonce, nonce_len) != 0)
+    {
+        return NULL;
+    }
+    filecrypt_ctx *ctx = calloc(1, sizeof(filecrypt_ctx));
+    if (!ctx)
+    {
+        return NULL;
+    }
+    ctx->algorithm = algorithm;
+    ctx->encrypt = mode == FILECRYPT_ENCRYPT;
+    uint64_t start = stats_begin();
+    if (algorithm == FILECRYPT_CHACHA20)
+    {
+        chacha20_keysetup(&ctx->chacha20, key, nonce);
+    }
+    else if (algorithm == FILECRYPT_CHACHA20_POLY1305)
+    {
+        uint8_t ietf[FILECRYPT_IETF_NONCE_SIZE];
+        filecrypt_ietf_nonce(ietf, nonce, nonce_len);
+        chacha20_poly1305_init(&ctx->aead, key, ietf, ctx->encrypt);
+    }
+    else
+    {
+        aes_keysetup(&ctx->aes, key, key_len);
+        if (algorithm == FILECRYPT_AES_CTR)
+        {
+            memcpy(ctx->nonce, nonce, FILECRYPT_NONCE_SIZE);
+        }
+        else if (algorithm == FILECRYPT_AES_GCM)
+        {
+            uint8_t iv[FILECRYPT_IETF_NONCE_SIZE];
+            filecrypt_ietf_nonce(iv, nonce, nonce_len);
+            aes_gcm_init(&ctx->gcm, &ctx->aes, iv, ctx->encrypt);
+        }
+    }
+    stats_end(STATS_KEYSETUP, start, 0);
+    return ctx;
+}
+
+// Function to XOR whole keystream blocks of the context's stream cipher into `out`
+static void filecrypt_keystream(filecrypt_ctx *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    if (ctx->algorithm == FILECRYPT_CHACHA20)
+    {
+        chacha20_encrypt(&ctx->chacha20, in, out, len);
+    }
+    else
+    {
+        aes_ctr_crypt(&ctx->aes, ctx->nonce, ctx->counter, in, out, len);
+        ctx->counter += len / AES_BLOCK_SIZE;
+    }
+}
+
+// Stream ciphers: use up the leftover keystream, run whole blocks through the engine, then start a
+// new keystream block for any tail
+static void filecrypt_update_stream(filecrypt_ctx *ctx, const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t block = ctx->algorithm == FILECRYPT_CHACHA20 ? 64 : AES_BLOCK_SIZE;
+    size_t done = 0;
+
+    for (; ctx->pending_len && done < len; done++)
+    {
+        out[done] = in[done] ^ ctx->pending[block - ctx->pending_len--];
+    }
+
+    size_t whole = (len - done) / block * block;
+    if (whole)
+    {
+        filecrypt_keystream(ctx, in + done, out + done, whole);
+        done += whole;
+    }
+
+    if (done < len)
+    {
+        memset(ctx->pending, 0, block);
+        filecrypt_keystream(ctx, ctx->pending, ctx->pending, block);
+        for (ctx->pending_len = block; done < len; done++)
+        {
+            out[done] = in[done] ^ ctx->pending[block - ctx->pending_len--];
+        }
+    }
+}
+
+// AES-ECB: emit every complete block except, when decrypting, the last one (it holds the padding)
+static size_t filecrypt_update_ecb(filecrypt_ctx *ctx, const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t total = ctx->pending_len + len;
+    size_t blocks = total / AES_BLOCK_SIZE;
+    size_t used = 0, produced = 0;
+
+    if (!ctx->encrypt && blocks && total % AES_BLOCK_SIZE == 0)
+    {
+        blocks--;
+    }
+    if (blocks == 0)
+    {
+        memcpy(ctx->pending + ctx->pending_len, in, len);
+        ctx->pending_len += len;
+        return 0;
+    }
+
+    // Complete the held-back partial block first
+    if (ctx->pending_len)
+    {
+        used = AES_BLOCK_SIZE - ctx->pending_len;
+        memcpy(ctx->pending + ctx->pending_len, in, used);
+        if (ctx->encrypt)
+        {
+            aes_encrypt_block(&ctx->aes, ctx->pending, out);
+        }
+        else
+        {
+            aes_decrypt_block(&ctx->aes, ctx->pending, out);
+        }
+        produced = AES_BLOCK_SIZE;
+        blocks--;
+    }
+
+    if (ctx->encrypt)
+    {
+        aes_encrypt_blocks(&ctx->aes, in + used, out + produced, blocks);
+    }
+    else
+    {
+        aes_decrypt_blocks(&ctx->aes, in + used, out + produced, blocks);
+    }
+    used += blocks * AES_BLOCK_SIZE;
+    produced += blocks * AES_BLOCK_SIZE;
+
+    ctx->pending_len = len - used;
+    memcpy(ctx->pending, in + used, ctx->pending_len);
+    return produced;
+}
+
+// Function to run AEAD text through the context's cipher and MAC; fails with EFBIG once the
+// message exceeds the algorithm's limit
+static int filecrypt_aead_update(filecrypt_ctx *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    int status = ctx->algorithm == FILECRYPT_AES_GCM ? aes_gcm_update(&ctx->gcm, in, out, len)
+                                                      : chacha20_poly1305_update(&ctx->aead, in, out, len);
+    if (status != 0)
+    {
+        errno = EFBIG;
+    }
+    return status;
+}
+
+// AEAD decryption: the last FILECRYPT_TAG_SIZE bytes seen so far may be the tag, so
+// they stay in `pending` and everything before them is decrypted
+static int filecrypt_update_aead_decrypt(filecrypt_ctx *ctx, const uint8_t *in, size_t len, uint8_t *out, size_t *out_len)
+{
+    size_t total = ctx->pending_len + len;
+
+    *out_len = 0;
+    if (total <= FILECRYPT_TAG_SIZE)
+    {
+        memcpy(ctx->pending + ctx->pending_len, in, len);
+        ctx->pending_len = total;
+        return 0;
+    }
+
+    size_t emit = total - FILECRYPT_TAG_SIZE;
+    size_t from_pending = emit < ctx->pending_len ? emit : ctx->pending_len;
+    size_t from_in = emit - from_pending;
+    if (filecrypt_aead_update(ctx, ctx->pending, out, from_pending) != 0 ||
+        filecrypt_aead_update(ctx, in, out + from_pending, from_in) != 0)
+    {
+        return -1;
+    }
+
+    memmove(ctx->pending, ctx->pending + from_pending, ctx->pending_len - from_pending);
+    memcpy(ctx->pending + ctx->pending_len - from_pending, in + from_in, len - from_in);
+    ctx->pending_len = FILECRYPT_TAG_SIZE;
+    *out_len = emit;
+    return 0;
+}
+
+int filecrypt_update(filecrypt_ctx *ctx, const uint8_t *in, size_t in_len, uint8_t *out, size_t *out_len)
+{
+    if (ctx->finished)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (ctx->algorithm == FILECRYPT_AES_ECB)
+    {
+        *out_len = filecrypt_update_ecb(ctx, in, in_len, out);
+    }
+    else if (filecrypt_is_aead(ctx->algorithm) && !ctx->encrypt)
+    {
+        return filecrypt_update_aead_decrypt(ctx, in, in_len, out, out_len);
+    }
+    else if (filecrypt_is_aead(ctx->algorithm))
+    {
+        if (filecrypt_aead_update(ctx, in, out, in_len) != 0)
+        {
+            return -1;
+        }
+        *out_len = in_len;
+    }
+    else
+    {
+        filecrypt_update_stream(ctx, in, in_len, out);
+        *out_len = in_len;
+    }
+    return 0;
+}
+
+int filecrypt_finalize(filecrypt_ctx *ctx, uint8_t *out, size_t *out_len)
+{
+    *out_len = 0;
+    if (ctx->finished)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    ctx->finished = 1;
+    if (ctx->algorithm == FILECRYPT_AES_GCM)
+    {
+        if (ctx->encrypt)
+        {
+            aes_gcm_final(&ctx->gcm, out);
+            *out_len = FILECRYPT_TAG_SIZE;
+            return 0;
+        }
+        if (ctx->pending_len != FILECRYPT_TAG_SIZE || !aes_gcm_verify(&ctx->gcm, ctx->pending))
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        return 0;
+    }
+    if (ctx->algorithm == FILECRYPT_CHACHA20_POLY1305)
+    {
+        if (ctx->encrypt)
+        {
+            chacha20_poly1305_final(&ctx->aead, out);
+            *out_len = FILECRYPT_TAG_SIZE;
+            return 0;
+        }
+        if (ctx->pending_len != FILECRYPT_TAG_SIZE || !chacha20_poly1305_verify(&ctx->aead, ctx->pending))
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        return 0;
+    }
+    if (ctx->algorithm != FILECRYPT_AES_ECB)
+    {
+        return 0;
+    }
+
+    uint8_t block[AES_BLOCK_SIZE];
+    memcpy(block, ctx->pending, ctx->pending_len);
+    if (ctx->encrypt)
+    {
+        *out_len = aes_pad(block, ctx->pending_len);
+        aes_encrypt_block(&ctx->aes, block, out);
+        secure_zero(block, sizeof(block));
+        return 0;
+    }
+
+    // The held-back block must be complete and correctly padded
+    if (ctx->pending_len != AES_BLOCK_SIZE)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    aes_decrypt_block(&ctx->aes, block, block);
+    size_t length = aes_unpad(block, AES_BLOCK_SIZE);
+    if (length == STREAM_ERROR)
+    {
+        secure_zero(block, sizeof(block));
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(out, block, length);
+    secure_zero(block, sizeof(block));
+    *out_len = length;
+    return 0;
+}
+
+void filecrypt_free(filecrypt_ctx *ctx)
+{
+    if (ctx)
+    {
+        secure_zero(ctx, sizeof(*ctx));
+        free(ctx);
+    }
+}
+
+// Container callback: seal or open one message in place with the job's AEAD, under a nonce the
+// container chooses per chunk
+static int filecrypt_container_seal(void *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                                    uint8_t *data, size_t length, uint8_t *tag, int encrypt)
+{
+    filecrypt_job *job = (filecrypt_job *)key;
+    int result = 0;
+
+    if (job->algorithm == FILECRYPT_AES_GCM)
+    {
+        aes_gcm_ctx gcm;
+        aes_gcm_init(&gcm, &job->aes.ctx, nonce, encrypt);
+        aes_gcm_aad(&gcm, aad, aad_length);
+        if (aes_gcm_update(&gcm, data, data, length) != 0)
+        {
+            result = -1;
+        }
+        else if (encrypt)
+        {
+            aes_gcm_final(&gcm, tag);
+        }
+        else if (!aes_gcm_verify(&gcm, tag))
+        {
+            result = -1;
+        }
+        secure_zero(&gcm, sizeof(gcm));
+        return result;
+    }
+
+    chacha20_poly1305_ctx aead;
+    chacha20_poly1305_init(&aead, job->key, nonce, encrypt);
+    chacha20_poly1305_aad(&aead, aad, aad_length);
+    if (chacha20_poly1305_update(&aead, data, data, length) != 0)
+    {
+        result = -1;
+    }
+    else if (encrypt)
+    {
+        chacha20_poly1305_final(&aead, tag);
+    }
+    else if (!chacha20_poly1305_verify(&aead, tag))
+    {
+        result = -1;
+    }
+    secure_zero(&aead, sizeof(aead));
+    return result;
+}
+
+filecrypt_pool *filecrypt_pool_create(int threads)
+{
+    filecrypt_pool *shared = malloc(sizeof(filecrypt_pool));
+    if (!shared)
+    {
+        return NULL;
+    }
+    shared->workers = pool_create(threads);
+    if (!shared->workers)
+    {
+        free(shared);
+        return NULL;
+    }
+    return shared;
+}
+
+void filecrypt_pool_free(filecrypt_pool *shared)
+{
+    if (shared)
+    {
+        pool_destroy(shared->workers);
+        free(shared);
+    }
+}
+
+filecrypt_job *filecrypt_job_create(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                    const uint8_t *key, size_t key_len,
+                                    const uint8_t *nonce, size_t nonce_len,
+                                    const filecrypt_options *options)
+{
+    static const filecrypt_options defaults = {0};
+    if (!options)
+    {
+        options = &defaults;
+    }
+    if (filecrypt_check(algorithm, key_len, nonce, nonce_len) != 0 || options->threads < 0 ||
+        (options->use_mmap && algorithm != FILECRYPT_CHACHA20) ||
+        (options->direct_io && (options->use_mmap || options->container)) ||
+        (options->huge_pages && !options->direct_io) ||
+        (options->container && (!filecrypt_is_aead(algorithm) || nonce_len != FILECRYPT_NONCE_SIZE ||
+                                (options->chunk_size && (options->chunk_size < CONTAINER_MIN_CHUNK ||
+                                                         options->chunk_size > CONTAINER_MAX_CHUNK)))))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    filecrypt_job *job = calloc(1, sizeof(filecrypt_job));
+    if (!job)
+    {
+        return NULL;
+    }
+    job->shared = options->pool != NULL;
+    job->workers = job->shared ? options->pool->workers : pool_create(options->threads);
+    if (options->direct_io)
+    {
+        job->arena = stream_arena_create(options->huge_pages);
+    }
+    if (!job->workers || (options->direct_io && !job->arena))
+    {
+        if (job->workers && !job->shared)
+        {
+            pool_destroy(job->workers);
+        }
+        free(job);
+        return NULL;
+    }
+    job->algorithm = algorithm;
+    job->buffer_size = options->buffer_size;
+    job->encrypt = mode == FILECRYPT_ENCRYPT;
+    if (options->container)
+    {
+        job->container.algorithm = algorithm;
+        job->container.chunk_size = options->chunk_size;
+        job->container.seal = filecrypt_container_seal;
+        job->container.key = job;
+        job->container.workers = job->workers;
+    }
+
+    uint64_t start = stats_begin();
+    if (algorithm == FILECRYPT_CHACHA20)
+    {
+        chacha20_keysetup(&job->chacha20.initial, key, nonce);
+        job->chacha20.workers = job->workers;
+        job->chacha20.buffer_size = options->buffer_size;
+        job->chacha20.arena = job->arena;
+        job->chacha20.use_mmap = options->use_mmap;
+    }
+    else if (algorithm == FILECRYPT_CHACHA20_POLY1305)
+    {
+        uint8_t ietf[FILECRYPT_IETF_NONCE_SIZE];
+        filecrypt_ietf_nonce(ietf, nonce, nonce_len);
+        memcpy(job->key, key, FILECRYPT_CHACHA20_KEY_SIZE);
+        chacha20_keysetup_ietf(&job->chacha20.initial, key, ietf);
+        job->chacha20.workers = job->workers;
+        job->chacha20.buffer_size = options->buffer_size;
+        job->chacha20.arena = job->arena;
+        job->chacha20.aead = 1;
+        job->chacha20.encrypt = mode == FILECRYPT_ENCRYPT;
+    }
+    else
+    {
+        aes_keysetup(&job->aes.ctx, key, key_len);
+        if (algorithm == FILECRYPT_AES_CTR)
+        {
+            memcpy(job->nonce, nonce, FILECRYPT_NONCE_SIZE);
+            job->aes.nonce = job->nonce;
+        }
+        else if (algorithm == FILECRYPT_AES_GCM)
+        {
+            filecrypt_ietf_nonce(job->nonce, nonce, nonce_len);
+            job->aes.nonce = job->nonce;
+        }
+        job->aes.encrypt = mode == FILECRYPT_ENCRYPT;
+        job->aes.workers = job->workers;
+        job->aes.buffer_size = options->buffer_size;
+        job->aes.arena = job->arena;
+    }
+    stats_end(STATS_KEYSETUP, start, 0);
+    return job;
+}
+
+filecrypt_job *filecrypt_job_create_hybrid(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                           const char *key_file, const filecrypt_options *options)
+{
+    static const uint8_t unused[FILECRYPT_CHACHA20_KEY_SIZE] = {0};
+    if (!filecrypt_is_aead(algorithm) || (options && (options->container || options->use_mmap)))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    rsa_key *key = malloc(sizeof(rsa_key));
+    FILE *in = key ? fopen(key_file, "r") : NULL;
+    if (!in)
+    {
+        int error = errno;
+        perror(key_file);
+        free(key);
+        errno = error;
+        return NULL;
+    }
+    int status = rsa_key_load(key, in);
+    fclose(in);
+    if (status != 0 || (mode == FILECRYPT_DECRYPT && !key->has_private))
+    {
+        fprintf(stderr, "%s: %s\n", key_file,
+                status != 0 ? "Not a valid RSA key" : "Decryption needs the private key");
+        rsa_key_wipe(key);
+        free(key);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // The job's own key is never used: every file sets up a copy of the engine with its file key
+    filecrypt_job *job = filecrypt_job_create(algorithm, mode, unused, sizeof(unused), unused,
+                                              FILECRYPT_NONCE_SIZE, options);
+    if (!job)
+    {
+        rsa_key_wipe(key);
+        free(key);
+        return NULL;
+    }
+    job->rsa = key;
+    return job;
+}
+
+// Function to encrypt or decrypt one file of a hybrid job: one RSA operation wraps a fresh file key
+// into the header, or unwraps it, and the file then streams through a copy of the job's AEAD
+// engine keyed with it
+static int filecrypt_job_hybrid_file(filecrypt_job *job, const char *path)
+{
+    static const uint8_t nonce[HYBRID_NONCE_SIZE] = {0};
+    uint8_t header[HYBRID_MAX_HEADER], file_key[HYBRID_KEY_SIZE];
+    int result;
+
+    uint64_t start = stats_begin();
+    result = job->encrypt ? hybrid_seal(job->rsa, job->algorithm, path, file_key, header)
+                          : hybrid_open(job->rsa, job->algorithm, path, file_key);
+    stats_end(STATS_KEYSETUP, start, 0);
+    if (result != 0)
+    {
+        secure_zero(file_key, sizeof(file_key));
+        return -1;
+    }
+
+    if (job->algorithm == FILECRYPT_AES_GCM)
+    {
+        aes_job aes = job->aes;
+        aes_keysetup(&aes.ctx, file_key, HYBRID_KEY_SIZE);
+        aes.nonce = nonce;
+        aes.header = header;
+        aes.header_length = hybrid_header_size(job->rsa);
+        result = aes_gcm_process_file(&aes, path);
+        secure_zero(&aes, sizeof(aes));
+    }
+    else
+    {
+        chacha20_job_settings chacha20 = job->chacha20;
+        chacha20_keysetup_ietf(&chacha20.initial, file_key, nonce);
+        chacha20.header = header;
+        chacha20.header_length = hybrid_header_size(job->rsa);
+        result = chacha20_process_file(&chacha20, path);
+        secure_zero(&chacha20, sizeof(chacha20));
+    }
+    secure_zero(file_key, sizeof(file_key));
+    return result;
+}
+
+// Function to process one file with the engine the job was set up for
+static int filecrypt_job_process(filecrypt_job *job, const char *path)
+{
+    if (job->rsa)
+    {
+        return filecrypt_job_hybrid_file(job, path);
+    }
+    if (job->container.seal)
+    {
+        // The index is written after the chunks and read before them, so a container needs a file
+        if (stream_is_stdio(path))
+        {
+            fprintf(stderr, "%s: Containers cannot be streamed through a pipe\n", path);
+            return -1;
+        }
+        return job->encrypt ? container_pack(&job->container, path) : container_unpack(&job->container, path);
+    }
+    switch (job->algorithm)
+    {
+    case FILECRYPT_CHACHA20:
+    case FILECRYPT_CHACHA20_POLY1305:
+        return chacha20_process_file(&job->chacha20, path);
+    case FILECRYPT_AES_GCM:
+        return aes_gcm_process_file(&job->aes, path);
+    default:
+        return aes_process_file(&job->aes, path);
+    }
+}
+
+// Stream engine callback: pass the bytes processed on to the job's progress callback
+static int filecrypt_job_progress(void *arg, uint64_t bytes)
+{
+    filecrypt_progress *progress = (filecrypt_progress *)arg;
+    return progress->job->progress(progress->job->progress_arg, progress->path, bytes, FILECRYPT_FILE_RUNNING);
+}
+
+// Batch callback: process one file of a run, reporting its progress when the job has a callback
+static int filecrypt_job_batch_file(void *arg, const char *path)
+{
+    filecrypt_job *job = (filecrypt_job *)arg;
+    if (!job->progress)
+    {
+        return filecrypt_job_process(job, path);
+    }
+
+    filecrypt_progress progress = {job, path};
+    stream_progress_hook hook = {filecrypt_job_progress, &progress};
+    hook = stream_set_progress(hook);
+    int result = filecrypt_job_process(job, path);
+    stream_set_progress(hook);
+    job->progress(job->progress_arg, path, 0, result == 0 ? FILECRYPT_FILE_DONE : FILECRYPT_FILE_FAILED);
+    return result;
+}
+
+// Function to pick the ChaCha20 and AES ECB/CTR buffer size for a run: a single file gets a buffer
+// large enough to give every worker a full slice; many files share the workers, so each keeps to the
+// default. The AEADs run on one thread (their MACs are sequential), so they keep the default too
+static void filecrypt_job_plan(filecrypt_job *job, size_t files)
+{
+    size_t buffer_size = files == 1 ? (size_t)STREAM_DEFAULT_BUFFER * pool_size(job->workers) : 0;
+    if (job->buffer_size != 0)
+    {
+        return;
+    }
+    if (job->algorithm == FILECRYPT_CHACHA20)
+    {
+        job->chacha20.buffer_size = buffer_size;
+    }
+    else if (job->algorithm == FILECRYPT_AES_ECB || job->algorithm == FILECRYPT_AES_CTR)
+    {
+        job->aes.buffer_size = buffer_size;
+    }
+}
+
+int filecrypt_job_file(filecrypt_job *job, const char *path)
+{
+    filecrypt_job_plan(job, 1);
+    return filecrypt_job_batch_file(job, path);
+}
+
+int filecrypt_job_stream(filecrypt_job *job, int in_fd, int out_fd)
+{
+    filecrypt_job_plan(job, 1);
+    stream_set_stdio(in_fd, out_fd);
+    int result = filecrypt_job_batch_file(job, STREAM_STDIO);
+    stream_set_stdio(-1, -1);
+    return result;
+}
+
+void filecrypt_job_set_progress(filecrypt_job *job, filecrypt_progress_fn progress, void *arg)
+{
+    job->progress = progress;
+    job->progress_arg = arg;
+}
+
+// Function to tell whether every file the job encrypts would share one keystream: true for the
+// stream ciphers and the AEADs outside containers and hybrid jobs
+static int filecrypt_job_shares_nonce(const filecrypt_job *job)
+{
+    return job->encrypt && job->algorithm != FILECRYPT_AES_ECB && !job->container.seal && !job->rsa;
+}
+
+int filecrypt_job_run(filecrypt_job *job, const char *const *paths, size_t count, const char *list)
+{
+    batch files = {0};
+    int failed = 0, stdio = 0;
+
+    // Collect the files: plain paths, directories (recursively) and an optional list. "-" is
+    // standard input to standard output, streamed once the files are done
+    for (size_t i = 0; i < count; i++)
+    {
+        if (stream_is_stdio(paths[i]))
+        {
+            stdio = 1;
+        }
+        else if (batch_add_path(&files, paths[i]) != 0)
+        {
+            failed++;
+        }
+    }
+    if (stdio && list && strcmp(list, "-") == 0)
+    {
+        fprintf(stderr, "Standard input cannot hold both the file list and the data\n");
+        batch_free(&files);
+        return -1;
+    }
+    if (list)
+    {
+        FILE *in = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+        if (!in)
+        {
+            perror("Failed to open file list");
+            batch_free(&files);
+            return -1;
+        }
+        if (batch_add_list(&files, in) != 0)
+        {
+            failed++;
+        }
+        if (in != stdin)
+        {
+            fclose(in);
+        }
+    }
+
+    // Encrypting a second file under the job's one key and nonce would repeat the keystream (and
+    // with GCM give away the authentication key), so only engines with a fresh nonce or key per
+    // file take many. Decrypting is allowed, so such files can still be recovered
+    if (files.count + stdio > 1 && filecrypt_job_shares_nonce(job))
+    {
+        fprintf(stderr, "One nonce cannot encrypt several files; use a container, a hybrid key or one run per file\n");
+        batch_free(&files);
+        errno = EINVAL;
+        return -1;
+    }
+
+    filecrypt_job_plan(job, files.count + stdio);
+    failed += (int)batch_run(&files, job->workers, filecrypt_job_batch_file, job);
+    batch_free(&files);
+    if (stdio && filecrypt_job_batch_file(job, STREAM_STDIO) != 0)
+    {
+        failed++;
+    }
+    return failed;
+}
+
+int filecrypt_job_extract(filecrypt_job *job, const char *path, uint64_t offset, uint64_t length, int fd)
+{
+    if (!job->container.seal)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return container_extract(&job->container, path, offset, length, fd);
+}
+
+void filecrypt_job_free(filecrypt_job *job)
+{
+    if (job)
+    {
+        if (!job->shared)
+        {
+            pool_destroy(job->workers);
+        }
+        stream_arena_free(job->arena);
+        if (job->rsa)
+        {
+            rsa_key_wipe(job->rsa);
+            free(job->rsa);
+        }
+        secure_zero(job, sizeof(*job));
+        free(job);
+    }
+}
+
+int filecrypt_file(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                   const uint8_t *key, size_t key_len,
+                   const uint8_t *nonce, size_t nonce_len,
+                   const filecrypt_options *options, const char *path)
+{
+    filecrypt_job *job = filecrypt_job_create(algorithm, mode, key, key_len, nonce, nonce_len, options);
+    if (!job)
+    {
+        perror("Failed to set up the job");
+        return -1;
+    }
+    int status = filecrypt_job_file(job, path);
+    filecrypt_job_free(job);
+    return status;
+}
@@ -0,0 +1,208 @@
+#ifndef FILECRYPT_H
+#define FILECRYPT_H
+
+// Public API of libfilecrypt: AES-128/192/256 (ECB with PKCS#7 padding, CTR or GCM), ChaCha20 and
+// ChaCha20-Poly1305 over memory buffers and files, optionally with per-file keys wrapped with RSA.
+// Contexts and jobs are opaque, so their layout can change without breaking callers. Functions
+// returning int return 0 on success and -1 on failure unless stated otherwise.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define FILECRYPT_API __attribute__((visibility("default")))
+#else
+#define FILECRYPT_API
+#endif
+
+#define FILECRYPT_VERSION 4 // Bumped when the API changes incompatibly
+
+#define FILECRYPT_AES_KEY_SIZE 16 // AES-128; the AES algorithms also take AES-192 and AES-256 keys
+#define FILECRYPT_AES_192_KEY_SIZE 24
+#define FILECRYPT_AES_256_KEY_SIZE 32
+#define FILECRYPT_CHACHA20_KEY_SIZE 32
+#define FILECRYPT_NONCE_SIZE 8
+#define FILECRYPT_IETF_NONCE_SIZE 12 // The AEADs also accept a full 12-byte nonce (IV)
+#define FILECRYPT_TAG_SIZE 16
+#define FILECRYPT_MAX_OVERHEAD 16 // Most bytes an update or finalize call can write beyond its input
+
+typedef enum
+{
+    FILECRYPT_AES_ECB = 0, // AES with a 16, 24 or 32-byte key, PKCS#7 padded, no nonce
+    FILECRYPT_AES_CTR = 1, // AES in counter mode, 8-byte nonce
+    FILECRYPT_CHACHA20 = 2,         // ChaCha20 with a 64-bit counter, 8-byte nonce
+    FILECRYPT_CHACHA20_POLY1305 = 3, // RFC 8439 AEAD; an 8-byte nonce is prefixed with four zero bytes
+    FILECRYPT_AES_GCM = 4            // AES-GCM; an 8-byte nonce is prefixed with four zero bytes
+} filecrypt_algorithm;
+
+typedef enum
+{
+    FILECRYPT_DECRYPT = 0,
+    FILECRYPT_ENCRYPT = 1
+} filecrypt_mode;
+
+typedef enum
+{
+    FILECRYPT_FILE_RUNNING = 0, // More bytes of the file have been processed
+    FILECRYPT_FILE_DONE = 1,    // The file was processed successfully
+    FILECRYPT_FILE_FAILED = 2   // The file failed or was cancelled, and was left unchanged (except with use_mmap)
+} filecrypt_file_state;
+
+typedef struct filecrypt_pool filecrypt_pool;
+
+// Settings for file jobs; zero-initialise for the defaults
+typedef struct
+{
+    int threads;          // Worker threads (0 = one per online core); ignored when `pool` is set
+    size_t buffer_size;   // Streaming buffer in bytes (0 = chosen per run)
+    int use_mmap;         // Plain ChaCha20 only: rewrite files in place through a memory mapping
+    int container;        // AEADs only: write and read the chunked container format (8-byte nonce,
+                          // though each new container draws a random one of its own)
+    size_t chunk_size;    // Container chunk size in bytes, 1K to 1G (0 = 1 MiB)
+    filecrypt_pool *pool; // Workers shared with other jobs (NULL = the job starts its own)
+    int direct_io;        // Read and write files with O_DIRECT, bypassing the page cache (not with
+                          // use_mmap or containers); the buffers are reused for the job's lifetime
+    int huge_pages;       // With direct_io: back the buffers with 2 MiB pages where available
+} filecrypt_options;
+
+typedef struct filecrypt_ctx filecrypt_ctx;
+typedef struct filecrypt_job filecrypt_job;
+
+// Progress callback of a job: `bytes` more input bytes of `path` were processed (RUNNING), or the
+// file finished (DONE or FAILED, `bytes` 0). It is called from the worker running the file, so
+// calls for different files may be concurrent. Returning non-zero while RUNNING cancels the file
+typedef int (*filecrypt_progress_fn)(void *arg, const char *path, uint64_t bytes, filecrypt_file_state state);
+
+// Function to return FILECRYPT_VERSION of the library actually loaded
+FILECRYPT_API int filecrypt_version(void);
+
+// Function to parse a size such as 65536, 64K, 1M or 2G; returns 0 when it is not valid
+FILECRYPT_API size_t filecrypt_parse_size(const char *text);
+
+// Function to clear key material in a way the compiler cannot drop as a dead store
+FILECRYPT_API void filecrypt_wipe(void *p, size_t n);
+
+// Function to use only the portable engines (no AES-NI, scalar ChaCha20) for contexts and jobs
+// created afterwards. This is process-wide: call it before other threads use the library
+FILECRYPT_API void filecrypt_set_portable(int portable);
+
+// Function to reset and start (1) or stop (0) collecting run statistics: time and bytes in the read,
+// key setup, cipher and write phases, summed over the files in flight. Process-wide: call it
+// before creating jobs so the CPU counters (where perf events are permitted) cover their threads
+FILECRYPT_API void filecrypt_stats_enable(int enable);
+
+// Function to print the statistics with wall time, throughput, peak RSS and, when available, cycles
+// and instructions per byte, as a table or as one JSON object. Call it after filecrypt_job_free so
+// every worker's CPU counts are included; prints nothing while collection is off
+FILECRYPT_API void filecrypt_stats_print(FILE *out, int json);
+
+// Function to name the engine selected on this host for an algorithm, e.g. "aes-ni" or "avx2"
+FILECRYPT_API const char *filecrypt_engine_name(filecrypt_algorithm algorithm);
+
+// Function to run the known-answer tests for the engine selected on this host; for the AEADs it
+// also packs a container twice and checks that the two do not share a nonce
+FILECRYPT_API int filecrypt_self_test(filecrypt_algorithm algorithm);
+
+// Function to create a streaming context. `nonce` is ignored for FILECRYPT_AES_ECB. Returns NULL
+// with errno set to EINVAL for a bad algorithm or key/nonce length, or ENOMEM
+FILECRYPT_API filecrypt_ctx *filecrypt_init(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                            const uint8_t *key, size_t key_len,
+                                            const uint8_t *nonce, size_t nonce_len);
+
+// Function to process the next `in_len` bytes. `out` needs room for in_len + FILECRYPT_MAX_OVERHEAD
+// bytes and `*out_len` receives the bytes written. The stream ciphers write exactly in_len bytes
+// and allow out == in, as do the AEADs when encrypting. AES-ECB holds back partial (and, when
+// decrypting, final) blocks and AEAD decryption holds back the last FILECRYPT_TAG_SIZE bytes (the
+// tag); their buffers must not overlap. Decrypted AEAD output is not authentic until
+// filecrypt_finalize succeeds
+FILECRYPT_API int filecrypt_update(filecrypt_ctx *ctx, const uint8_t *in, size_t in_len,
+                                   uint8_t *out, size_t *out_len);
+
+// Function to finish the stream: AES-ECB writes the padded last block (encrypt) or checks and
+// strips the padding (decrypt, failing on a wrong key or truncated input). The AEADs write the tag
+// (encrypt) or verify it (decrypt, failing with EBADMSG on a mismatch). Writes at most
+// FILECRYPT_MAX_OVERHEAD bytes. No more updates are accepted afterwards
+FILECRYPT_API int filecrypt_finalize(filecrypt_ctx *ctx, uint8_t *out, size_t *out_len);
+
+// Function to wipe and free a context (NULL is allowed)
+FILECRYPT_API void filecrypt_free(filecrypt_ctx *ctx);
+
+// Function to start a pool of `threads` workers (0 = one per online core) that several jobs can
+// share through filecrypt_options.pool, e.g. in a long-running service. Returns NULL with errno set
+// when the workers cannot be started
+FILECRYPT_API filecrypt_pool *filecrypt_pool_create(int threads);
+
+// Function to stop the workers and free the pool (NULL is allowed); free its jobs first
+FILECRYPT_API void filecrypt_pool_free(filecrypt_pool *pool);
+
+// Function to create a file job: the key is expanded once and the worker pool started once, so a
+// job can process any number of files. With direct_io, files are moved between the disk and a
+// set of aligned buffers kept by the job, so a run over files larger than memory does not evict
+// other data from the page cache; unaligned tails and headers take the page cache and are dropped
+// from it afterwards. `options` may be NULL. Returns NULL as filecrypt_init does,
+// or with the pool's errno when the workers cannot be started
+FILECRYPT_API filecrypt_job *filecrypt_job_create(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                                  const uint8_t *key, size_t key_len,
+                                                  const uint8_t *nonce, size_t nonce_len,
+                                                  const filecrypt_options *options);
+
+// Function to create a hybrid (public-key) job for one of the AEADs. Every file gets a random
+// 32-byte key of its own, wrapped with RSA-OAEP under the RSA key in `key_file` (made by rsa
+// --genkey) and stored in a header in front of the ciphertext, so the RSA work is one operation per
+// file and the data itself takes the symmetric path. Encrypting needs the public key and
+// decrypting the private one. Containers and use_mmap cannot be combined with it. Returns NULL as
+// filecrypt_job_create does, or when the key file cannot be read or does not hold a usable key
+// (reported on stderr, with errno from fopen or EINVAL)
+FILECRYPT_API filecrypt_job *filecrypt_job_create_hybrid(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                                         const char *key_file, const filecrypt_options *options);
+
+// Function to encrypt or decrypt one file in place. The result is written to a temporary file and
+// renamed over the original only on success (except with use_mmap), so a file whose AEAD tag does
+// not verify is left unchanged. Errors are reported on stderr. A `path` of "-" streams standard
+// input to standard output instead (not for containers); the output is written as it is produced,
+// so when an AEAD tag does not verify the failure is only reported after the plaintext
+FILECRYPT_API int filecrypt_job_file(filecrypt_job *job, const char *path);
+
+// Function to stream `in_fd` to `out_fd` through the job as a path of "-" streams standard input
+// to standard output, e.g. for descriptors passed over a socket. The descriptors are not closed
+FILECRYPT_API int filecrypt_job_stream(filecrypt_job *job, int in_fd, int out_fd);
+
+// Function to set the callback told about the progress of the job's files (NULL to remove). A job
+// is not safe to run from several threads at once, so set it between runs
+FILECRYPT_API void filecrypt_job_set_progress(filecrypt_job *job, filecrypt_progress_fn progress, void *arg);
+
+// Function to process files and directories (recursively, without following symbolic links) plus,
+// when `list` is not NULL, one path per line read from that file ("-" for standard input). A path
+// of "-" streams standard input to standard output after the files, as filecrypt_job_file does.
+// Encrypting more than one file is refused with errno set to EINVAL unless every file gets a
+// keystream of its own: AES ECB, containers (a random nonce each) and hybrid jobs (a random key
+// each). Returns the number of paths that failed, or -1 when the list cannot be opened or the
+// files would share a nonce
+FILECRYPT_API int filecrypt_job_run(filecrypt_job *job, const char *const *paths, size_t count, const char *list);
+
+// Function to decrypt `length` bytes of plaintext starting at `offset` from a container file made
+// by a container job, writing them to `fd` (which may be a pipe). Only the index and the chunks
+// holding the range are read and authenticated, and only authenticated bytes are written; the
+// range is clipped to the end of the plaintext. The file is not modified
+FILECRYPT_API int filecrypt_job_extract(filecrypt_job *job, const char *path, uint64_t offset, uint64_t length, int fd);
+
+// Function to stop the job's workers (unless they belong to a shared pool) and wipe and free it
+// (NULL is allowed)
+FILECRYPT_API void filecrypt_job_free(filecrypt_job *job);
+
+// Function to process a single file with a one-off job
+FILECRYPT_API int filecrypt_file(filecrypt_algorithm algorithm, filecrypt_mode mode,
+                                 const uint8_t *key, size_t key_len,
+                                 const uint8_t *nonce, size_t nonce_len,
+                                 const filecrypt_options *options, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
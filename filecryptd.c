@@ -0,0 +1,939 @@
+#define _GNU_SOURCE // SO_PEERCRED and struct ucred
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "filecrypt.h"
+
+// filecryptd: a long-running local service that keeps one worker pool and the expanded keys of
+// recent jobs warm, so a client pays neither process start-up nor key setup per request. It
+// listens on a Unix socket that only its own user can use.
+//
+// Requests and replies are lines of words. Request values are name=value pairs; bytes that are not
+// printable ASCII, spaces and '%' are written as %XX (so keys may hold any bytes). Requests:
+//
+//   ping                      -> ok <library version>
+//   run <settings> path=P...  -> progress and failed lines, then done <failed count>
+//   stream <settings>         -> progress lines, then done 0 (or done 1 on failure); the request
+//                                carries two descriptors (SCM_RIGHTS), the input and the output
+//   cancel                    -> no reply; the files of the run in progress fail and are left
+//                                unchanged (ignored when nothing runs)
+//
+// Settings: algorithm=aes-ecb|aes-ctr|aes-gcm|chacha20|chacha20-poly1305, mode=encrypt|decrypt,
+// key=K and nonce=N (not for aes-ecb) or rsa=<key file> for the AEADs, and optionally container=1,
+// chunk-size=S, buffer-size=S, direct-io=1, huge-pages=1 (implies direct-io) and list=<file of
+// paths>. Paths must be absolute. Progress lines read "progress <files finished> <bytes processed>"
+// and come at most every DAEMON_PROGRESS_MS; "failed <path>" names a file as it fails. A request
+// that cannot start gets "error <message>". Library errors go to the daemon's stderr
+#define DAEMON_MAX_REQUEST (1 << 20) // Longest request line in bytes
+#define DAEMON_CONTEXTS 16           // Jobs kept with their keys expanded
+#define DAEMON_PROGRESS_MS 100
+#define DAEMON_MAX_LINE 16384 // Longest reply line
+
+// Decoded settings of a request, also the key of the job cache
+typedef struct
+{
+    filecrypt_algorithm algorithm;
+    filecrypt_mode mode;
+    uint8_t key[FILECRYPT_CHACHA20_KEY_SIZE];
+    size_t key_len;
+    uint8_t nonce[FILECRYPT_IETF_NONCE_SIZE];
+    size_t nonce_len;
+    const char *rsa; // Key file of a hybrid job, or NULL
+    filecrypt_options options;
+} daemon_settings;
+
+// Cached job; `rsa` is owned here, unlike in requests
+typedef struct
+{
+    daemon_settings settings;
+    filecrypt_job *job; // NULL for a free slot
+    int busy;           // A request is running the job (jobs run one request at a time)
+    uint64_t last_used;
+} daemon_context;
+
+// Client connection. `lock` orders the replies of the connection thread and the progress callbacks
+// running on the workers, and guards the counters
+typedef struct
+{
+    int fd;
+    char *buffer; // Received bytes; the request being served ends before `next`
+    size_t used, next;
+    int fds[2]; // Descriptors received with the request
+    int fd_count;
+    pthread_mutex_t lock;
+    int cancelled; // Set by a cancel request, a lost client or shutdown
+    uint64_t files, bytes, last_report;
+} daemon_connection;
+
+static filecrypt_pool *workers;
+static daemon_context contexts[DAEMON_CONTEXTS];
+static uint64_t context_clock;
+static int active;   // Requests being served
+static int stopping; // Set on SIGINT or SIGTERM; no new requests start
+static pthread_mutex_t daemon_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the globals above
+static pthread_cond_t daemon_changed = PTHREAD_COND_INITIALIZER;
+static volatile sig_atomic_t signalled;
+
+// Function to read a monotonic clock in milliseconds
+static uint64_t daemon_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Function to send a whole reply line; marks the connection cancelled when the client has gone.
+// The caller holds the connection's lock
+static void daemon_send(daemon_connection *conn, const char *line, size_t length)
+{
+    while (length && !conn->cancelled)
+    {
+        ssize_t n = send(conn->fd, line, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            conn->cancelled = 1;
+            break;
+        }
+        line += n;
+        length -= (size_t)n;
+    }
+}
+
+// Function to format and send a reply line
+static void daemon_reply(daemon_connection *conn, const char *format, ...)
+{
+    char line[DAEMON_MAX_LINE];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(line) - 1)
+    {
+        n = (int)sizeof(line) - 2;
+    }
+    line[n++] = '\n';
+    pthread_mutex_lock(&conn->lock);
+    daemon_send(conn, line, (size_t)n);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+// Function to escape a value for a reply line; `out` holds at least 3 * strlen(in) + 1 bytes
+static void daemon_escape(char *out, const char *in)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (; *in; in++)
+    {
+        unsigned char c = (unsigned char)*in;
+        if (c <= ' ' || c >= 0x7f || c == '%')
+        {
+            *out++ = '%';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 15];
+        }
+        else
+        {
+            *out++ = (char)c;
+        }
+    }
+    *out = '\0';
+}
+
+// Function to decode a %XX-escaped value in place; returns its length, or -1 for a bad escape
+static long daemon_unescape(char *value)
+{
+    char *out = value;
+    for (char *in = value; *in; in++)
+    {
+        if (*in == '%')
+        {
+            if (!isxdigit((unsigned char)in[1]) || !isxdigit((unsigned char)in[2]))
+            {
+                return -1;
+            }
+            char hex[3] = {in[1], in[2], '\0'};
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 2;
+        }
+        else
+        {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+    return out - value;
+}
+
+// Function to look for a cancel request sent while a run is in progress: in the bytes already
+// received after the request, or else waiting on the socket. The caller holds the connection's lock
+static void daemon_check_cancel(daemon_connection *conn)
+{
+    static const char cancel[] = "cancel\n";
+    char peek[sizeof(cancel) - 1];
+    size_t length = sizeof(cancel) - 1;
+
+    if (conn->used - conn->next >= length)
+    {
+        if (memcmp(conn->buffer + conn->next, cancel, length) == 0)
+        {
+            conn->next += length;
+            conn->cancelled = 1;
+        }
+    }
+    else if (conn->used == conn->next &&
+             recv(conn->fd, peek, length, MSG_PEEK | MSG_DONTWAIT) == (ssize_t)length &&
+             memcmp(peek, cancel, length) == 0)
+    {
+        recv(conn->fd, peek, length, 0);
+        conn->cancelled = 1;
+    }
+}
+
+// Progress callback of the jobs: count the bytes and files and report them to the client at most
+// every DAEMON_PROGRESS_MS; returns non-zero to cancel the file
+static int daemon_progress(void *arg, const char *path, uint64_t bytes, filecrypt_file_state state)
+{
+    daemon_connection *conn = (daemon_connection *)arg;
+    char line[DAEMON_MAX_LINE];
+    int cancel;
+
+    pthread_mutex_lock(&conn->lock);
+    if (state == FILECRYPT_FILE_RUNNING)
+    {
+        conn->bytes += bytes;
+    }
+    else
+    {
+        conn->files++;
+        if (state == FILECRYPT_FILE_FAILED && strlen(path) < (sizeof(line) - 16) / 3)
+        {
+            memcpy(line, "failed ", 7);
+            daemon_escape(line + 7, path);
+            strcat(line, "\n");
+            daemon_send(conn, line, strlen(line));
+        }
+    }
+    uint64_t now = daemon_now();
+    if (now - conn->last_report >= DAEMON_PROGRESS_MS)
+    {
+        conn->last_report = now;
+        int n = snprintf(line, sizeof(line), "progress %llu %llu\n", (unsigned long long)conn->files,
+                         (unsigned long long)conn->bytes);
+        daemon_send(conn, line, (size_t)n);
+        daemon_check_cancel(conn);
+    }
+    pthread_mutex_lock(&daemon_lock);
+    cancel = conn->cancelled || stopping;
+    pthread_mutex_unlock(&daemon_lock);
+    pthread_mutex_unlock(&conn->lock);
+    return cancel;
+}
+
+// Function to tell whether two requests can share a job
+static int daemon_same_settings(const daemon_settings *a, const daemon_settings *b)
+{
+    return a->algorithm == b->algorithm && a->mode == b->mode && a->key_len == b->key_len &&
+           memcmp(a->key, b->key, a->key_len) == 0 && a->nonce_len == b->nonce_len &&
+           memcmp(a->nonce, b->nonce, a->nonce_len) == 0 && !a->rsa == !b->rsa &&
+           (!a->rsa || strcmp(a->rsa, b->rsa) == 0) &&
+           a->options.container == b->options.container && a->options.chunk_size == b->options.chunk_size &&
+           a->options.buffer_size == b->options.buffer_size && a->options.direct_io == b->options.direct_io &&
+           a->options.huge_pages == b->options.huge_pages;
+}
+
+// Function to create a job for the settings on the shared pool
+static filecrypt_job *daemon_create_job(const daemon_settings *settings)
+{
+    if (settings->rsa)
+    {
+        return filecrypt_job_create_hybrid(settings->algorithm, settings->mode, settings->rsa, &settings->options);
+    }
+    return filecrypt_job_create(settings->algorithm, settings->mode, settings->key, settings->key_len,
+                                settings->nonce, settings->nonce_len, &settings->options);
+}
+
+// Function to free a cached job and its slot's copy of the settings
+static void daemon_free_context(daemon_context *context)
+{
+    filecrypt_job_free(context->job);
+    free((char *)context->settings.rsa);
+    filecrypt_wipe(context, sizeof(*context));
+}
+
+// Function to take a job for the settings: an idle cached one, a new one in a free or least
+// recently used idle slot, or, when every slot is busy with other settings, a one-off job that
+// `*context` is NULL for. Waits while the only matching jobs are busy. Returns NULL on failure
+static filecrypt_job *daemon_acquire(const daemon_settings *settings, daemon_context **context)
+{
+    filecrypt_job *job = NULL;
+
+    pthread_mutex_lock(&daemon_lock);
+    for (;;)
+    {
+        daemon_context *idle = NULL, *slot = NULL;
+        int matched = 0;
+        for (int i = 0; i < DAEMON_CONTEXTS; i++)
+        {
+            daemon_context *c = &contexts[i];
+            if (c->job && daemon_same_settings(&c->settings, settings))
+            {
+                matched = 1;
+                if (!c->busy)
+                {
+                    idle = c;
+                    break;
+                }
+            }
+            else if (!c->busy && (!slot || !c->job || (slot->job && c->last_used < slot->last_used)))
+            {
+                slot = c;
+            }
+        }
+
+        if (idle)
+        {
+            idle->busy = 1;
+            idle->last_used = ++context_clock;
+            *context = idle;
+            job = idle->job;
+            break;
+        }
+        if (slot || !matched)
+        {
+            job = daemon_create_job(settings);
+            *context = NULL;
+            if (job && slot)
+            {
+                char *rsa = settings->rsa ? strdup(settings->rsa) : NULL;
+                if (!settings->rsa || rsa)
+                {
+                    if (slot->job)
+                    {
+                        daemon_free_context(slot);
+                    }
+                    slot->settings = *settings;
+                    slot->settings.rsa = rsa;
+                    slot->job = job;
+                    slot->busy = 1;
+                    slot->last_used = ++context_clock;
+                    *context = slot;
+                }
+            }
+            break;
+        }
+        pthread_cond_wait(&daemon_changed, &daemon_lock);
+    }
+    pthread_mutex_unlock(&daemon_lock);
+    return job;
+}
+
+// Function to give back a job taken with daemon_acquire
+static void daemon_release(filecrypt_job *job, daemon_context *context)
+{
+    filecrypt_job_set_progress(job, NULL, NULL);
+    if (!context)
+    {
+        filecrypt_job_free(job);
+        return;
+    }
+    pthread_mutex_lock(&daemon_lock);
+    context->busy = 0;
+    pthread_cond_broadcast(&daemon_changed);
+    pthread_mutex_unlock(&daemon_lock);
+}
+
+// Function to parse a size value, where "0" means the default
+static int daemon_parse_size(const char *value, size_t *size)
+{
+    *size = strcmp(value, "0") == 0 ? 0 : filecrypt_parse_size(value);
+    return *size == 0 && strcmp(value, "0") != 0 ? -1 : 0;
+}
+
+// Function to parse the words of a request after its command into settings, paths and a list
+// file. The words are decoded in place, so the results point into the request. Returns an error
+// message, or NULL when the request is valid
+static const char *daemon_parse(char *words, daemon_settings *settings, const char ***paths, size_t *count,
+                                const char **list)
+{
+    static const char *const algorithms[] = {"aes-ecb", "aes-ctr", "chacha20", "chacha20-poly1305", "aes-gcm"};
+    int algorithm = -1, mode = -1, has_key = 0, has_nonce = 0;
+    char *save = NULL;
+
+    memset(settings, 0, sizeof(*settings));
+    settings->options.pool = workers;
+    for (char *word = strtok_r(words, " ", &save); word; word = strtok_r(NULL, " ", &save))
+    {
+        char *value = strchr(word, '=');
+        if (!value)
+        {
+            return "expected name=value";
+        }
+        *value++ = '\0';
+        long length = daemon_unescape(value);
+        if (length < 0)
+        {
+            return "bad %XX escape";
+        }
+
+        if (strcmp(word, "algorithm") == 0)
+        {
+            for (int i = 0; i < (int)(sizeof(algorithms) / sizeof(algorithms[0])); i++)
+            {
+                algorithm = strcmp(value, algorithms[i]) == 0 ? i : algorithm;
+            }
+            if (algorithm < 0)
+            {
+                return "unknown algorithm";
+            }
+        }
+        else if (strcmp(word, "mode") == 0)
+        {
+            mode = strcmp(value, "encrypt") == 0 ? FILECRYPT_ENCRYPT
+                   : strcmp(value, "decrypt") == 0 ? FILECRYPT_DECRYPT : -1;
+            if (mode < 0)
+            {
+                return "mode must be encrypt or decrypt";
+            }
+        }
+        else if (strcmp(word, "key") == 0)
+        {
+            if ((size_t)length > sizeof(settings->key))
+            {
+                return "key is too long";
+            }
+            memcpy(settings->key, value, (size_t)length);
+            settings->key_len = (size_t)length;
+            filecrypt_wipe(value, (size_t)length);
+            has_key = 1;
+        }
+        else if (strcmp(word, "nonce") == 0)
+        {
+            if ((size_t)length > sizeof(settings->nonce))
+            {
+                return "nonce is too long";
+            }
+            memcpy(settings->nonce, value, (size_t)length);
+            settings->nonce_len = (size_t)length;
+            has_nonce = 1;
+        }
+        else if (strcmp(word, "rsa") == 0 || strcmp(word, "list") == 0 || strcmp(word, "path") == 0)
+        {
+            if (value[0] != '/')
+            {
+                return "paths must be absolute";
+            }
+            if (word[0] == 'r')
+            {
+                settings->rsa = value;
+            }
+            else if (word[0] == 'l')
+            {
+                *list = value;
+            }
+            else
+            {
+                const char **grown = realloc(*paths, (*count + 1) * sizeof(**paths));
+                if (!grown)
+                {
+                    return "out of memory";
+                }
+                *paths = grown;
+                (*paths)[(*count)++] = value;
+            }
+        }
+        else if (strcmp(word, "container") == 0)
+        {
+            settings->options.container = strcmp(value, "1") == 0;
+        }
+        else if (strcmp(word, "chunk-size") == 0)
+        {
+            if (daemon_parse_size(value, &settings->options.chunk_size) != 0)
+            {
+                return "invalid chunk size";
+            }
+        }
+        else if (strcmp(word, "direct-io") == 0 || strcmp(word, "huge-pages") == 0)
+        {
+            if (strcmp(value, "1") == 0)
+            {
+                settings->options.direct_io = 1;
+                settings->options.huge_pages |= word[0] == 'h';
+            }
+        }
+        else if (strcmp(word, "buffer-size") == 0)
+        {
+            if (daemon_parse_size(value, &settings->options.buffer_size) != 0)
+            {
+                return "invalid buffer size";
+            }
+        }
+        else
+        {
+            return "unknown setting";
+        }
+    }
+
+    if (algorithm < 0 || mode < 0)
+    {
+        return "algorithm and mode are required";
+    }
+    if (settings->rsa ? has_key || has_nonce : !has_key)
+    {
+        return "give either key (and nonce) or rsa";
+    }
+    settings->algorithm = (filecrypt_algorithm)algorithm;
+    settings->mode = (filecrypt_mode)mode;
+    return NULL;
+}
+
+// Function to serve a run or stream request
+static void daemon_serve_job(daemon_connection *conn, char *words, int stream)
+{
+    daemon_settings settings;
+    daemon_context *context = NULL;
+    const char **paths = NULL;
+    const char *list = NULL;
+    size_t count = 0;
+    int failed, run_error = 0;
+
+    const char *error = daemon_parse(words, &settings, &paths, &count, &list);
+    if (!error && stream && (count || list || conn->fd_count != 2))
+    {
+        error = "stream takes two descriptors and no paths";
+    }
+    else if (!error && !stream && !count && !list)
+    {
+        error = "no paths given";
+    }
+    filecrypt_job *job = error ? NULL : daemon_acquire(&settings, &context);
+    if (!error && !job)
+    {
+        error = errno == EINVAL ? "invalid settings for the algorithm" : strerror(errno);
+    }
+    filecrypt_wipe(&settings, sizeof(settings));
+    if (error)
+    {
+        daemon_reply(conn, "error %s", error);
+        free(paths);
+        return;
+    }
+
+    pthread_mutex_lock(&conn->lock);
+    conn->cancelled = 0;
+    conn->files = conn->bytes = 0;
+    conn->last_report = daemon_now();
+    pthread_mutex_unlock(&conn->lock);
+    filecrypt_job_set_progress(job, daemon_progress, conn);
+    if (stream)
+    {
+        failed = filecrypt_job_stream(job, conn->fds[0], conn->fds[1]) != 0;
+    }
+    else
+    {
+        failed = filecrypt_job_run(job, paths, count, list);
+        run_error = errno;
+    }
+    daemon_release(job, context);
+    free(paths);
+
+    pthread_mutex_lock(&conn->lock);
+    conn->cancelled = 0; // A client that only cancelled still gets the outcome
+    pthread_mutex_unlock(&conn->lock);
+    if (failed < 0)
+    {
+        daemon_reply(conn, run_error == EINVAL ? "error one nonce cannot encrypt several files"
+                                               : "error cannot open the file list");
+    }
+    else
+    {
+        daemon_reply(conn, "progress %llu %llu", (unsigned long long)conn->files, (unsigned long long)conn->bytes);
+        daemon_reply(conn, "done %d", failed);
+    }
+}
+
+// Function to close the descriptors received with the last request
+static void daemon_close_fds(daemon_connection *conn)
+{
+    for (int i = 0; i < conn->fd_count; i++)
+    {
+        close(conn->fds[i]);
+    }
+    conn->fd_count = 0;
+}
+
+// Function to read the next request line, keeping descriptors that arrive with it. Returns the
+// line without its newline, or NULL when the client has gone or sent an over-long line
+static char *daemon_read_request(daemon_connection *conn)
+{
+    // Drop the previous request
+    memmove(conn->buffer, conn->buffer + conn->next, conn->used - conn->next);
+    conn->used -= conn->next;
+    conn->next = 0;
+
+    for (;;)
+    {
+        char *newline = memchr(conn->buffer, '\n', conn->used);
+        if (newline)
+        {
+            *newline = '\0';
+            conn->next = (size_t)(newline - conn->buffer) + 1;
+            return conn->buffer;
+        }
+        if (conn->used == DAEMON_MAX_REQUEST)
+        {
+            return NULL;
+        }
+
+        union
+        {
+            char buffer[CMSG_SPACE(2 * sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = {conn->buffer + conn->used, DAEMON_MAX_REQUEST - conn->used};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        ssize_t n = recvmsg(conn->fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return NULL;
+        }
+        conn->used += (size_t)n;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < received; i++)
+                {
+                    int fd;
+                    memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                    if (conn->fd_count < 2)
+                    {
+                        conn->fds[conn->fd_count++] = fd;
+                    }
+                    else
+                    {
+                        close(fd);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Connection thread: serve requests until the client hangs up
+static void *daemon_connection_main(void *arg)
+{
+    daemon_connection *conn = (daemon_connection *)arg;
+    char *request;
+
+    while ((request = daemon_read_request(conn)) != NULL)
+    {
+        char *words = strchr(request, ' ');
+        if (words)
+        {
+            *words++ = '\0';
+        }
+        else
+        {
+            words = request + strlen(request);
+        }
+
+        if (strcmp(request, "ping") == 0)
+        {
+            daemon_reply(conn, "ok %d", filecrypt_version());
+        }
+        else if (strcmp(request, "run") == 0 || strcmp(request, "stream") == 0)
+        {
+            pthread_mutex_lock(&daemon_lock);
+            int refused = stopping;
+            active += !refused;
+            pthread_mutex_unlock(&daemon_lock);
+            if (refused)
+            {
+                daemon_reply(conn, "error shutting down");
+            }
+            else
+            {
+                daemon_serve_job(conn, words, request[0] == 's');
+                pthread_mutex_lock(&daemon_lock);
+                active--;
+                pthread_cond_broadcast(&daemon_changed);
+                pthread_mutex_unlock(&daemon_lock);
+            }
+        }
+        else if (strcmp(request, "cancel") != 0 && request[0] != '\0')
+        {
+            daemon_reply(conn, "error unknown request");
+        }
+        filecrypt_wipe(request, conn->next); // Requests may hold keys
+        daemon_close_fds(conn);
+    }
+
+    daemon_close_fds(conn);
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->lock);
+    filecrypt_wipe(conn->buffer, DAEMON_MAX_REQUEST);
+    free(conn->buffer);
+    free(conn);
+    return NULL;
+}
+
+// Function to accept a connection from the daemon's own user and start its thread
+static void daemon_accept(int listener)
+{
+    struct ucred peer;
+    socklen_t peer_length = sizeof(peer);
+    pthread_t thread;
+
+    int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno != EINTR && errno != ECONNABORTED)
+        {
+            perror("accept");
+        }
+        return;
+    }
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_length) != 0 || peer.uid != getuid())
+    {
+        fprintf(stderr, "Refused a connection from another user\n");
+        close(fd);
+        return;
+    }
+
+    daemon_connection *conn = calloc(1, sizeof(daemon_connection));
+    if (conn)
+    {
+        conn->buffer = malloc(DAEMON_MAX_REQUEST);
+    }
+    if (!conn || !conn->buffer)
+    {
+        perror("Failed to accept a connection");
+        free(conn);
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    pthread_mutex_init(&conn->lock, NULL);
+    if (pthread_create(&thread, NULL, daemon_connection_main, conn) != 0)
+    {
+        fprintf(stderr, "Failed to start a connection thread\n");
+        pthread_mutex_destroy(&conn->lock);
+        free(conn->buffer);
+        free(conn);
+        close(fd);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+// Function to check that `dir` is a directory only this user can use, creating it with mode 0700
+// when `create` is set. The default socket lives in such a directory, so no other user can put a
+// socket of their own at its path first and collect the keys clients send; returns 0 or -1
+static int daemon_private_dir(const char *dir, int create)
+{
+    struct stat st;
+
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+    {
+        perror(dir);
+        return -1;
+    }
+    if (lstat(dir, &st) != 0)
+    {
+        perror(dir);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0)
+    {
+        fprintf(stderr, "%s: Not a directory private to this user; refusing to listen there\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to bind the listening socket, replacing a stale one left by a daemon that died
+static int daemon_listen(const char *path)
+{
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path is too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+    {
+        fprintf(stderr, "A daemon is already listening on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    if (errno == ECONNREFUSED)
+    {
+        unlink(path);
+    }
+
+    // Only the owner may connect; the peer check on accept covers systems that ignore the mode
+    mode_t old_mask = umask(077);
+    int status = bind(fd, (struct sockaddr *)&address, sizeof(address));
+    umask(old_mask);
+    if (status != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Signal handler: ask the accept loop to stop
+static void daemon_signal(int signal)
+{
+    (void)signal;
+    signalled = 1;
+}
+
+// Main function to start the pool, listen and serve until SIGINT or SIGTERM
+int main(int argc, char *argv[])
+{
+    char default_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    char default_dir[sizeof(default_path) - sizeof("/filecryptd.sock") + 1];
+    const char *path = NULL;
+    int threads = 0;
+    sigset_t block, unblocked;
+    struct sigaction action = {0};
+
+    for (int argi = 1; argi < argc; argi++)
+    {
+        if (strcmp(argv[argi], "--socket") == 0 && argi + 1 < argc)
+        {
+            path = argv[++argi];
+        }
+        else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+        {
+            threads = atoi(argv[++argi]);
+            if (threads <= 0)
+            {
+                fprintf(stderr, "Thread count must be a positive number\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argi], "--portable") == 0)
+        {
+            filecrypt_set_portable(1);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--socket <path>] [--threads N] [--portable]\n", argv[0]);
+            return 1;
+        }
+    }
+    // The default socket goes in the user's runtime directory, or else in a private directory of
+    // its own under /tmp; never straight into a directory other users can write to
+    if (!path)
+    {
+        const char *runtime = getenv("XDG_RUNTIME_DIR");
+        int own_dir = !runtime || !runtime[0];
+        int length = own_dir ? snprintf(default_dir, sizeof(default_dir), "/tmp/filecryptd-%u", (unsigned)getuid())
+                             : snprintf(default_dir, sizeof(default_dir), "%s", runtime);
+        if (length < 0 || (size_t)length >= sizeof(default_dir))
+        {
+            fprintf(stderr, "Socket path is too long: %s/filecryptd.sock\n", own_dir ? "/tmp" : runtime);
+            return 1;
+        }
+        if (daemon_private_dir(default_dir, own_dir) != 0)
+        {
+            return 1;
+        }
+        snprintf(default_path, sizeof(default_path), "%s/filecryptd.sock", default_dir);
+        path = default_path;
+    }
+
+    // The signals stay blocked in every thread and are only taken while the main thread waits for
+    // connections, so they cannot interrupt a worker or be lost between a check and the wait
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &unblocked);
+    action.sa_handler = daemon_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    workers = filecrypt_pool_create(threads);
+    if (!workers)
+    {
+        perror("Failed to start the workers");
+        return 1;
+    }
+    int listener = daemon_listen(path);
+    if (listener < 0)
+    {
+        filecrypt_pool_free(workers);
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s\n", path);
+
+    while (!signalled)
+    {
+        struct pollfd pfd = {listener, POLLIN, 0};
+        if (ppoll(&pfd, 1, NULL, &unblocked) > 0)
+        {
+            daemon_accept(listener);
+        }
+    }
+
+    // Stop taking requests, let the running ones cancel their files, then wipe the cached keys
+    close(listener);
+    unlink(path);
+    pthread_mutex_lock(&daemon_lock);
+    stopping = 1;
+    while (active)
+    {
+        pthread_cond_wait(&daemon_changed, &daemon_lock);
+    }
+    for (int i = 0; i < DAEMON_CONTEXTS; i++)
+    {
+        if (contexts[i].job)
+        {
+            daemon_free_context(&contexts[i]);
+        }
+    }
+    pthread_mutex_unlock(&daemon_lock);
+    fprintf(stderr, "Stopped\n");
+    return 0;
+}
@@ -0,0 +1,790 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "bytes.h"
+#include "gcm.h"
+#include "stream.h"
+
+// PCLMULQDQ multiplies in GF(2)[x] directly; it is only used together with the AES-NI schedule
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GCM_HAVE_CLMUL 1
+#include <cpuid.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#define CLMUL_TARGET __attribute__((target("aes,pclmul,sse2,ssse3")))
+#else
+#define GCM_HAVE_CLMUL 0
+#endif
+
+// Reduction constants for the 4-bit table engine: the bits shifted out of the low end, folded back
+// by x^128 = x^7 + x^2 + x + 1 (in GCM's reflected bit order)
+static const uint16_t ghash_rem4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0};
+
+// Function to load a big-endian 64-bit word
+static uint64_t load64_be(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// Function to store a big-endian 64-bit word
+static void store64_be(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--)
+    {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+// Function to build the table of H multiplied by every 4-bit polynomial
+static void ghash_table_init(ghash_ctx *g, const uint8_t *h)
+{
+    uint64_t hi = load64_be(h), lo = load64_be(h + 8);
+    int i, j;
+
+    memset(g->table, 0, sizeof(g->table));
+    g->table[8][0] = hi;
+    g->table[8][1] = lo;
+
+    // Halving the polynomial multiplies by x, since GCM numbers bits from the most significant
+    for (i = 4; i > 0; i >>= 1)
+    {
+        uint64_t carry = (uint64_t)0xe1 << 56 & (0 - (lo & 1));
+        lo = (hi << 63) | (lo >> 1);
+        hi = (hi >> 1) ^ carry;
+        g->table[i][0] = hi;
+        g->table[i][1] = lo;
+    }
+    for (i = 2; i < 16; i <<= 1)
+    {
+        for (j = 1; j < i; j++)
+        {
+            g->table[i + j][0] = g->table[i][0] ^ g->table[j][0];
+            g->table[i + j][1] = g->table[i][1] ^ g->table[j][1];
+        }
+    }
+}
+
+// Function to multiply y by H one nibble at a time, from the last byte to the first. The lookups
+// depend on the data, so like the T-table AES engine this path is not constant-time
+static void ghash_table_mult(const ghash_ctx *g, uint8_t *y)
+{
+    int nibble = y[15] & 0xf;
+    uint64_t hi = g->table[nibble][0], lo = g->table[nibble][1];
+
+    for (int k = 1; k < 32; k++)
+    {
+        int rem = (int)(lo & 0xf);
+        nibble = k & 1 ? y[15 - k / 2] >> 4 : y[15 - k / 2] & 0xf;
+        lo = (hi << 60) | (lo >> 4);
+        hi = (hi >> 4) ^ ((uint64_t)ghash_rem4[rem] << 48);
+        hi ^= g->table[nibble][0];
+        lo ^= g->table[nibble][1];
+    }
+    store64_be(y, hi);
+    store64_be(y + 8, lo);
+}
+
+#if GCM_HAVE_CLMUL
+// Function to check once whether the CPU has PCLMULQDQ and SSSE3
+static int clmul_available(void)
+{
+    static int available = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (available < 0)
+    {
+        available = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+    }
+    return available;
+}
+
+// Function to reverse the bytes of a block, so the carry-less multiply sees GCM's bit order
+static CLMUL_TARGET __m128i ghash_reflect(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Function to add the unreduced 256-bit product a * b into lo, mid and hi
+static CLMUL_TARGET void ghash_accumulate(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)));
+}
+
+// Function to reduce an accumulated product modulo x^128 + x^7 + x^2 + x + 1. The reduction is
+// linear, so a group of products can be summed first and reduced once
+static CLMUL_TARGET __m128i ghash_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t1, t2, t3;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // The operands are bit-reflected, so the product comes out one bit short: shift it left
+    t1 = _mm_srli_epi32(lo, 31);
+    t2 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t3 = _mm_srli_si128(t1, 12);
+    t2 = _mm_slli_si128(t2, 4);
+    t1 = _mm_slli_si128(t1, 4);
+    lo = _mm_or_si128(lo, t1);
+    hi = _mm_or_si128(_mm_or_si128(hi, t2), t3);
+
+    // Fold the low half into the high half in two steps
+    t1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    t2 = _mm_srli_si128(t1, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+    t3 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(t3, t2));
+    return _mm_xor_si128(hi, lo);
+}
+
+// Function to multiply two reflected field elements
+static CLMUL_TARGET __m128i ghash_clmul_mult(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    ghash_accumulate(a, b, &lo, &mid, &hi);
+    return ghash_reduce(lo, mid, hi);
+}
+
+// Function to compute H^1..H^GCM_LANES
+static CLMUL_TARGET void ghash_clmul_init(ghash_ctx *g, const uint8_t *h)
+{
+    __m128i hk = ghash_reflect(_mm_loadu_si128((const __m128i *)h));
+    __m128i power = hk;
+
+    for (int i = 0; i < GCM_LANES; i++)
+    {
+        _mm_storeu_si128((__m128i *)g->powers[i], power);
+        power = ghash_clmul_mult(power, hk);
+    }
+}
+
+// Function to hash GCM_LANES blocks into y: y = (y + X1) * H^8 + X2 * H^7 + ... + X8 * H
+static CLMUL_TARGET __m128i ghash_clmul_group(__m128i y, const __m128i *h, const uint8_t *input)
+{
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    for (int lane = 0; lane < GCM_LANES; lane++)
+    {
+        __m128i x = ghash_reflect(_mm_loadu_si128((const __m128i *)(input + lane * 16)));
+        ghash_accumulate(lane ? x : _mm_xor_si128(x, y), h[GCM_LANES - 1 - lane], &lo, &mid, &hi);
+    }
+    return ghash_reduce(lo, mid, hi);
+}
+
+// Function to hash whole blocks, a group at a time with a single reduction
+static CLMUL_TARGET void ghash_clmul_blocks(ghash_ctx *g, const uint8_t *input, size_t blocks)
+{
+    __m128i h[GCM_LANES];
+    __m128i y = ghash_reflect(_mm_loadu_si128((const __m128i *)g->y));
+    size_t i = 0;
+
+    for (int lane = 0; lane < GCM_LANES; lane++)
+    {
+        h[lane] = _mm_loadu_si128((const __m128i *)g->powers[lane]);
+    }
+    for (; i + GCM_LANES <= blocks; i += GCM_LANES)
+    {
+        y = ghash_clmul_group(y, h, input + i * 16);
+    }
+    for (; i < blocks; i++)
+    {
+        y = ghash_clmul_mult(_mm_xor_si128(y, ghash_reflect(_mm_loadu_si128((const __m128i *)(input + i * 16)))), h[0]);
+    }
+    _mm_storeu_si128((__m128i *)g->y, ghash_reflect(y));
+}
+
+#if GCM_LANES >= 10
+#error "The stitched loop needs an AES round for each GHASH multiply, and AES-128 has ten"
+#endif
+
+// Function to encrypt or decrypt whole groups of GCM_LANES blocks with AES-NI, hashing the
+// ciphertext with PCLMULQDQ in the same loop: one multiply is issued per AES round, so the AESENC
+// and carry-less multiply units work side by side and each block is read once while it is hot.
+// Decryption hashes the group being decrypted; encryption hashes the previous group's output.
+// The lane loops are unrolled as well, so the blocks stay in registers and each round issues
+// GCM_LANES independent AESENCs. Returns the number of blocks processed
+AES_KERNEL CLMUL_TARGET size_t gcm_clmul_rounds(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output, size_t blocks,
+                                                int rounds)
+{
+    __m128i rk[AES_MAX_ROUNDS + 1], h[GCM_LANES], b[GCM_LANES];
+    __m128i y = ghash_reflect(_mm_loadu_si128((const __m128i *)ctx->ghash.y));
+    uint32_t counter = ctx->counter;
+    int32_t iv[3];
+    size_t i = 0;
+    int round, lane;
+
+    AES_UNROLL
+    for (round = 0; round <= rounds; round++)
+    {
+        rk[round] = _mm_loadu_si128((const __m128i *)(ctx->aes->RoundKey + round * 16));
+    }
+    for (lane = 0; lane < GCM_LANES; lane++)
+    {
+        h[lane] = _mm_loadu_si128((const __m128i *)ctx->ghash.powers[lane]);
+    }
+    memcpy(iv, ctx->j0, sizeof(iv));
+
+    for (; i + GCM_LANES <= blocks; i += GCM_LANES)
+    {
+        const uint8_t *hashed = !ctx->encrypt ? input + i * 16 : i ? output + (i - GCM_LANES) * 16 : NULL;
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+        // Counter block is IV || big-endian 32-bit counter
+        AES_UNROLL
+        for (lane = 0; lane < GCM_LANES; lane++)
+        {
+            b[lane] = _mm_xor_si128(_mm_set_epi32((int32_t)__builtin_bswap32(counter + lane), iv[2], iv[1], iv[0]), rk[0]);
+        }
+        counter += GCM_LANES;
+
+        AES_UNROLL
+        for (round = 1; round <= GCM_LANES; round++)
+        {
+            AES_UNROLL
+            for (lane = 0; lane < GCM_LANES; lane++)
+            {
+                b[lane] = _mm_aesenc_si128(b[lane], rk[round]);
+            }
+            if (hashed)
+            {
+                __m128i x = ghash_reflect(_mm_loadu_si128((const __m128i *)(hashed + (round - 1) * 16)));
+                ghash_accumulate(round == 1 ? _mm_xor_si128(x, y) : x, h[GCM_LANES - round], &lo, &mid, &hi);
+            }
+        }
+        AES_UNROLL
+        for (; round < rounds; round++)
+        {
+            AES_UNROLL
+            for (lane = 0; lane < GCM_LANES; lane++)
+            {
+                b[lane] = _mm_aesenc_si128(b[lane], rk[round]);
+            }
+        }
+        if (hashed)
+        {
+            y = ghash_reduce(lo, mid, hi);
+        }
+
+        AES_UNROLL
+        for (lane = 0; lane < GCM_LANES; lane++)
+        {
+            b[lane] = _mm_aesenclast_si128(b[lane], rk[rounds]);
+            b[lane] = _mm_xor_si128(b[lane], _mm_loadu_si128((const __m128i *)(input + (i + lane) * 16)));
+            _mm_storeu_si128((__m128i *)(output + (i + lane) * 16), b[lane]);
+        }
+    }
+
+    // The last group written by an encryption has not been hashed yet
+    if (ctx->encrypt && i)
+    {
+        y = ghash_clmul_group(y, h, output + (i - GCM_LANES) * 16);
+    }
+
+    _mm_storeu_si128((__m128i *)ctx->ghash.y, ghash_reflect(y));
+    ctx->counter = counter;
+    return i;
+}
+
+// Function to run the stitched loop specialized for the key size; returns the blocks processed
+static CLMUL_TARGET size_t gcm_clmul_crypt(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    size_t done;
+
+    AES_SPECIALIZE(ctx->aes->rounds, done = gcm_clmul_rounds, ctx, input, output, blocks);
+    return done;
+}
+#endif
+
+// Function to set up GHASH with the hash key H, on PCLMULQDQ when `clmul` is set
+static void ghash_init(ghash_ctx *g, const uint8_t *h, int clmul)
+{
+    memset(g, 0, sizeof(*g));
+#if GCM_HAVE_CLMUL
+    if (clmul)
+    {
+        g->clmul = 1;
+        ghash_clmul_init(g, h);
+        return;
+    }
+#endif
+    (void)clmul;
+    ghash_table_init(g, h);
+}
+
+// Function to hash whole 16-byte blocks
+static void ghash_blocks(ghash_ctx *g, const uint8_t *input, size_t blocks)
+{
+#if GCM_HAVE_CLMUL
+    if (g->clmul)
+    {
+        ghash_clmul_blocks(g, input, blocks);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < blocks; i++)
+    {
+        for (int j = 0; j < AES_BLOCK_SIZE; j++)
+        {
+            g->y[j] ^= input[i * AES_BLOCK_SIZE + j];
+        }
+        ghash_table_mult(g, g->y);
+    }
+}
+
+// Function to hash `length` bytes, keeping a partial block for the next call
+static void ghash_update(ghash_ctx *g, const uint8_t *input, size_t length)
+{
+    size_t n;
+
+    if (g->buffered)
+    {
+        n = AES_BLOCK_SIZE - g->buffered < length ? AES_BLOCK_SIZE - g->buffered : length;
+        memcpy(g->buffer + g->buffered, input, n);
+        g->buffered += n;
+        input += n;
+        length -= n;
+        if (g->buffered < AES_BLOCK_SIZE)
+        {
+            return;
+        }
+        ghash_blocks(g, g->buffer, 1);
+        g->buffered = 0;
+    }
+    n = length / AES_BLOCK_SIZE;
+    if (n)
+    {
+        ghash_blocks(g, input, n);
+    }
+    g->buffered = length - n * AES_BLOCK_SIZE;
+    memcpy(g->buffer, input + n * AES_BLOCK_SIZE, g->buffered);
+}
+
+// Function to complete a partial block with zeros (GCM pads the AAD and the text separately)
+static void ghash_pad(ghash_ctx *g)
+{
+    if (g->buffered)
+    {
+        memset(g->buffer + g->buffered, 0, AES_BLOCK_SIZE - g->buffered);
+        ghash_blocks(g, g->buffer, 1);
+        g->buffered = 0;
+    }
+}
+
+// Function to fill `blocks` counter blocks starting at the context's counter
+static void gcm_counter_blocks(aes_gcm_ctx *ctx, uint8_t *ctr, size_t blocks)
+{
+    for (size_t j = 0; j < blocks; j++)
+    {
+        uint32_t c = ctx->counter++;
+        memcpy(ctr + j * AES_BLOCK_SIZE, ctx->j0, GCM_IV_SIZE);
+        ctr[j * AES_BLOCK_SIZE + 12] = (uint8_t)(c >> 24);
+        ctr[j * AES_BLOCK_SIZE + 13] = (uint8_t)(c >> 16);
+        ctr[j * AES_BLOCK_SIZE + 14] = (uint8_t)(c >> 8);
+        ctr[j * AES_BLOCK_SIZE + 15] = (uint8_t)c;
+    }
+}
+
+// Function to encrypt or decrypt whole blocks, hashing the ciphertext side
+static void gcm_crypt_blocks(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    uint8_t ctr[GCM_LANES * AES_BLOCK_SIZE];
+    uint8_t keystream[GCM_LANES * AES_BLOCK_SIZE];
+    size_t i = 0, j, n;
+
+#if GCM_HAVE_CLMUL
+    if (ctx->ghash.clmul)
+    {
+        i = gcm_clmul_crypt(ctx, input, output, blocks);
+    }
+#endif
+
+    // Portable path: encrypt a batch of counter blocks together, then hash and XOR the batch
+    for (; i < blocks; i += n)
+    {
+        n = blocks - i < GCM_LANES ? blocks - i : GCM_LANES;
+        gcm_counter_blocks(ctx, ctr, n);
+        aes_encrypt_blocks(ctx->aes, ctr, keystream, n);
+        if (!ctx->encrypt)
+        {
+            ghash_blocks(&ctx->ghash, input + i * AES_BLOCK_SIZE, n);
+        }
+        for (j = 0; j < n * AES_BLOCK_SIZE; j++)
+        {
+            output[i * AES_BLOCK_SIZE + j] = input[i * AES_BLOCK_SIZE + j] ^ keystream[j];
+        }
+        if (ctx->encrypt)
+        {
+            ghash_blocks(&ctx->ghash, output + i * AES_BLOCK_SIZE, n);
+        }
+    }
+}
+
+// Function to XOR `length` bytes of a keystream block, hashing the ciphertext side
+static void gcm_crypt_bytes(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output,
+                            const uint8_t *keystream, size_t length)
+{
+    if (!ctx->encrypt)
+    {
+        ghash_update(&ctx->ghash, input, length);
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        output[i] = input[i] ^ keystream[i];
+    }
+    if (ctx->encrypt)
+    {
+        ghash_update(&ctx->ghash, output, length);
+    }
+}
+
+// Function to report which engines aes_gcm_init will select
+const char *aes_gcm_engine_name(void)
+{
+#if GCM_HAVE_CLMUL
+    if (strcmp(aes_engine_name(), "aes-ni") == 0 && clmul_available())
+    {
+        return "aes-ni+pclmul";
+    }
+#endif
+    if (strcmp(aes_engine_name(), "bitsliced") == 0)
+    {
+        return "bitsliced+ghash-table";
+    }
+    return AES_TTABLE ? "t-table+ghash-table" : "byte-wise+ghash-table";
+}
+
+void aes_gcm_init(aes_gcm_ctx *ctx, const aes_ctx *aes, const uint8_t *iv, int encrypt)
+{
+    uint8_t h[AES_BLOCK_SIZE] = {0};
+    int clmul = 0;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->aes = aes;
+    ctx->encrypt = encrypt;
+
+    // The stitched loop runs AES-NI rounds itself, so PCLMULQDQ is only paired with that schedule
+#if GCM_HAVE_CLMUL
+    clmul = aes->aesni && clmul_available();
+#endif
+    aes_encrypt_block(aes, h, h);
+    ghash_init(&ctx->ghash, h, clmul);
+    secure_zero(h, sizeof(h));
+
+    memcpy(ctx->j0, iv, GCM_IV_SIZE);
+    ctx->j0[15] = 1;
+    ctx->counter = 2;
+}
+
+void aes_gcm_aad(aes_gcm_ctx *ctx, const uint8_t *aad, size_t length)
+{
+    ghash_update(&ctx->ghash, aad, length);
+    ctx->aad_length += length;
+}
+
+int aes_gcm_update(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length)
+{
+    size_t done = 0, blocks;
+
+    if (length > GCM_MAX_TEXT - ctx->text_length)
+    {
+        return -1;
+    }
+    if (!ctx->text_started)
+    {
+        ghash_pad(&ctx->ghash);
+        ctx->text_started = 1;
+    }
+    ctx->text_length += length;
+
+    // Use up the keystream left over from a previous partial block
+    if (ctx->available)
+    {
+        done = length < ctx->available ? length : ctx->available;
+        gcm_crypt_bytes(ctx, input, output, ctx->keystream + AES_BLOCK_SIZE - ctx->available, done);
+        ctx->available -= done;
+    }
+
+    // The hash is block-aligned again here, so whole blocks go straight through
+    blocks = (length - done) / AES_BLOCK_SIZE;
+    if (blocks)
+    {
+        gcm_crypt_blocks(ctx, input + done, output + done, blocks);
+        done += blocks * AES_BLOCK_SIZE;
+    }
+
+    // Start a new keystream block for the tail
+    if (done < length)
+    {
+        gcm_counter_blocks(ctx, ctx->keystream, 1);
+        aes_encrypt_block(ctx->aes, ctx->keystream, ctx->keystream);
+        gcm_crypt_bytes(ctx, input + done, output + done, ctx->keystream, length - done);
+        ctx->available = AES_BLOCK_SIZE - (length - done);
+    }
+    return 0;
+}
+
+void aes_gcm_final(aes_gcm_ctx *ctx, uint8_t *tag)
+{
+    uint8_t block[AES_BLOCK_SIZE];
+
+    // GHASH input: aad || pad || ciphertext || pad || be64(aad bits) || be64(text bits)
+    ghash_pad(&ctx->ghash);
+    store64_be(block, ctx->aad_length * 8);
+    store64_be(block + 8, ctx->text_length * 8);
+    ghash_update(&ctx->ghash, block, sizeof(block));
+
+    // The tag is the hash masked with the encrypted pre-counter block
+    aes_encrypt_block(ctx->aes, ctx->j0, block);
+    for (int i = 0; i < GCM_TAG_SIZE; i++)
+    {
+        tag[i] = block[i] ^ ctx->ghash.y[i];
+    }
+    secure_zero(block, sizeof(block));
+    secure_zero(ctx->keystream, sizeof(ctx->keystream));
+    secure_zero(&ctx->ghash, sizeof(ctx->ghash));
+}
+
+int aes_gcm_verify(aes_gcm_ctx *ctx, const uint8_t *tag)
+{
+    uint8_t computed[GCM_TAG_SIZE];
+    uint8_t diff = 0;
+
+    aes_gcm_final(ctx, computed);
+    for (int i = 0; i < GCM_TAG_SIZE; i++)
+    {
+        diff |= computed[i] ^ tag[i];
+    }
+    secure_zero(computed, sizeof(computed));
+    return diff == 0;
+}
+
+// Function to check one key size against its case of the GCM specification (McGrew and Viega),
+// fed in uneven pieces, and the wide loop against the block-at-a-time path on a longer message
+static int aes_gcm_check(const uint8_t *key, size_t key_len, const uint8_t *cipher, const uint8_t *tag)
+{
+    static const uint8_t iv[12] = {0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88};
+    static const uint8_t aad[20] = {0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed,
+                                    0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xab, 0xad, 0xda, 0xd2};
+    static const uint8_t plain[60] = {
+        0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+        0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+        0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+        0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39};
+    aes_ctx aes;
+    aes_gcm_ctx ctx;
+    uint8_t output[60], computed[16], expected[16];
+    uint8_t message[GCM_LANES * 3 * AES_BLOCK_SIZE + 5], wide[sizeof(message)], narrow[sizeof(message)];
+    size_t i, n;
+
+    aes_keysetup(&aes, key, key_len);
+    aes_gcm_init(&ctx, &aes, iv, 1);
+    aes_gcm_aad(&ctx, aad, 7);
+    aes_gcm_aad(&ctx, aad + 7, sizeof(aad) - 7);
+    aes_gcm_update(&ctx, plain, output, 5);
+    aes_gcm_update(&ctx, plain + 5, output + 5, 32);
+    aes_gcm_update(&ctx, plain + 37, output + 37, sizeof(plain) - 37);
+    aes_gcm_final(&ctx, computed);
+    if (memcmp(output, cipher, sizeof(output)) != 0 || memcmp(computed, tag, GCM_TAG_SIZE) != 0)
+    {
+        return 0;
+    }
+
+    // Decrypt in place and reject a tag with one bit flipped
+    aes_gcm_init(&ctx, &aes, iv, 0);
+    aes_gcm_aad(&ctx, aad, sizeof(aad));
+    aes_gcm_update(&ctx, output, output, sizeof(output));
+    if (!aes_gcm_verify(&ctx, tag) || memcmp(output, plain, sizeof(plain)) != 0)
+    {
+        return 0;
+    }
+    computed[15] ^= 1;
+    aes_gcm_init(&ctx, &aes, iv, 0);
+    aes_gcm_aad(&ctx, aad, sizeof(aad));
+    aes_gcm_update(&ctx, cipher, output, sizeof(output));
+    if (aes_gcm_verify(&ctx, computed))
+    {
+        return 0;
+    }
+
+    // A message long enough for the wide loop must match one fed in 7-byte pieces, which never
+    // reaches it, in both directions
+    for (i = 0; i < sizeof(message); i++)
+    {
+        message[i] = (uint8_t)(i * 7 + 3);
+    }
+    aes_gcm_init(&ctx, &aes, iv, 1);
+    aes_gcm_update(&ctx, message, wide, sizeof(message));
+    aes_gcm_final(&ctx, expected);
+    aes_gcm_init(&ctx, &aes, iv, 1);
+    for (i = 0; i < sizeof(message); i += n)
+    {
+        n = sizeof(message) - i < 7 ? sizeof(message) - i : 7;
+        aes_gcm_update(&ctx, message + i, narrow + i, n);
+    }
+    aes_gcm_final(&ctx, computed);
+    if (memcmp(wide, narrow, sizeof(wide)) != 0 || memcmp(computed, expected, sizeof(computed)) != 0)
+    {
+        return 0;
+    }
+    aes_gcm_init(&ctx, &aes, iv, 0);
+    aes_gcm_update(&ctx, wide, wide, sizeof(wide));
+    return aes_gcm_verify(&ctx, expected) && memcmp(wide, message, sizeof(message)) == 0;
+}
+
+// Function to check AES-GCM against test cases 4 (AES-128) and 16 (AES-256) of the GCM specification
+int aes_gcm_self_test(void)
+{
+    static const struct
+    {
+        uint8_t key[AES_256_KEY_SIZE];
+        size_t key_len;
+        uint8_t cipher[60];
+        uint8_t tag[GCM_TAG_SIZE];
+    } cases[2] = {
+        {{0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08},
+         16,
+         {0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+          0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+          0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+          0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91},
+         {0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb, 0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47}},
+        {{0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+          0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08},
+         32,
+         {0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07, 0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+          0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9, 0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+          0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d, 0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+          0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a, 0xbc, 0xc9, 0xf6, 0x62},
+         {0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68, 0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b}},
+    };
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (!aes_gcm_check(cases[i].key, cases[i].key_len, cases[i].cipher, cases[i].tag))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Per-file GCM state. When decrypting, the last 16 bytes of the file are the tag: `remaining`
+// counts the ciphertext still to come and the tag bytes are collected as they arrive
+typedef struct
+{
+    aes_gcm_ctx gcm;
+    const char *filename;
+    uint64_t remaining;
+    int piped; // Decrypting standard input: the length is only known at the final call
+    uint8_t tag[GCM_TAG_SIZE];
+    size_t tag_length;
+} aes_gcm_stream;
+
+// Stream transform for AES-GCM: the tag is appended after the final buffer when encrypting, and
+// checked on the final call when decrypting. A mismatch fails the stream, so the decrypted output
+// is discarded and the original file is left unchanged
+static size_t aes_gcm_transform(void *arg, uint8_t *buffer, size_t length, int final)
+{
+    aes_gcm_stream *stream = (aes_gcm_stream *)arg;
+    size_t text = length;
+
+    // A pipe's length is not known up front, but the stream keeps the whole tag in the final buffer
+    if (stream->piped)
+    {
+        stream->remaining = length;
+        if (final)
+        {
+            stream->remaining = length < GCM_TAG_SIZE ? 0 : length - GCM_TAG_SIZE;
+        }
+    }
+    if (!stream->gcm.encrypt && text > stream->remaining)
+    {
+        text = (size_t)stream->remaining;
+    }
+    if (aes_gcm_update(&stream->gcm, buffer, buffer, text) != 0)
+    {
+        fprintf(stderr, "%s: File is too large for AES-GCM\n", stream->filename);
+        return STREAM_ERROR;
+    }
+
+    if (stream->gcm.encrypt)
+    {
+        if (final)
+        {
+            aes_gcm_final(&stream->gcm, buffer + length);
+            length += GCM_TAG_SIZE;
+        }
+        return length;
+    }
+
+    stream->remaining -= text;
+    if (stream->tag_length + (length - text) > GCM_TAG_SIZE)
+    {
+        fprintf(stderr, "%s: File changed while it was being decrypted\n", stream->filename);
+        return STREAM_ERROR;
+    }
+    memcpy(stream->tag + stream->tag_length, buffer + text, length - text);
+    stream->tag_length += length - text;
+    if (final && (stream->tag_length != GCM_TAG_SIZE || !aes_gcm_verify(&stream->gcm, stream->tag)))
+    {
+        fprintf(stderr, "%s: Authentication failed (wrong key or nonce, or the file was modified); %s\n",
+                stream->filename, stream->piped ? "the output written is not authentic" : "file left unchanged");
+        return STREAM_ERROR;
+    }
+    return text;
+}
+
+int aes_gcm_process_file(const aes_job *job, const char *filename)
+{
+    aes_gcm_stream stream;
+    struct stat st;
+    int result;
+
+    secure_zero(&stream, sizeof(stream));
+    stream.filename = filename;
+    if (!job->encrypt && stream_is_stdio(filename))
+    {
+        stream.piped = 1;
+    }
+    else if (!job->encrypt)
+    {
+        if (stat(filename, &st) != 0)
+        {
+            perror(filename);
+            return -1;
+        }
+        if ((uint64_t)st.st_size < job->header_length + GCM_TAG_SIZE)
+        {
+            fprintf(stderr, "%s: File is too short to hold an authentication tag\n", filename);
+            return -1;
+        }
+        stream.remaining = (uint64_t)st.st_size - job->header_length - GCM_TAG_SIZE;
+    }
+
+    aes_gcm_init(&stream.gcm, &job->ctx, job->nonce, job->encrypt);
+    if (job->encrypt)
+    {
+        result = stream_file_framed(filename, job->buffer_size, job->arena, job->header, job->header_length, 0,
+                                    aes_gcm_transform, &stream);
+    }
+    else
+    {
+        result = stream_file_framed(filename, job->buffer_size, job->arena, NULL, 0, (off_t)job->header_length,
+                                    aes_gcm_transform, &stream);
+    }
+    secure_zero(&stream, sizeof(stream));
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef GCM_H
+#define GCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes.h"
+
+#define GCM_IV_SIZE 12
+#define GCM_TAG_SIZE 16
+#define GCM_LANES 8 // Blocks per iteration of the stitched AES-NI/PCLMULQDQ loop
+#define GCM_MAX_TEXT ((((uint64_t)1 << 32) - 2) * AES_BLOCK_SIZE) // SP 800-38D limit per IV
+
+// GHASH key and accumulator. The carry-less multiply engine keeps H^1..H^GCM_LANES, byte-reflected,
+// so a group of blocks needs only one reduction; the portable engine uses Shoup's 4-bit table
+typedef struct
+{
+    uint64_t table[16][2];                     // Multiples of H by every 4-bit value (portable engine)
+    uint8_t powers[GCM_LANES][AES_BLOCK_SIZE]; // H^1..H^GCM_LANES (carry-less multiply engine)
+    uint8_t y[AES_BLOCK_SIZE];                 // Running hash
+    uint8_t buffer[AES_BLOCK_SIZE];            // Partial block not yet hashed
+    size_t buffered;
+    int clmul; // Non-zero when PCLMULQDQ is used
+} ghash_ctx;
+
+// Running AES-GCM state for one message. The AES key is borrowed, not copied, so it must outlive
+// the context
+typedef struct
+{
+    const aes_ctx *aes;
+    ghash_ctx ghash;
+    uint8_t j0[AES_BLOCK_SIZE];        // IV || 1, the pre-counter block
+    uint32_t counter;                  // Next 32-bit counter value (the text starts at 2)
+    uint8_t keystream[AES_BLOCK_SIZE]; // Last keystream block, of which `available` bytes are unused
+    size_t available;
+    uint64_t aad_length, text_length;
+    int text_started, encrypt;
+} aes_gcm_ctx;
+
+// Function to report which engines aes_gcm_init will select, e.g. "aes-ni+pclmul"
+const char *aes_gcm_engine_name(void);
+
+// Function to start a message with an expanded key and a 12-byte IV
+void aes_gcm_init(aes_gcm_ctx *ctx, const aes_ctx *aes, const uint8_t *iv, int encrypt);
+
+// Function to authenticate additional data; all of it must come before the first update
+void aes_gcm_aad(aes_gcm_ctx *ctx, const uint8_t *aad, size_t length);
+
+// Function to encrypt or decrypt the next `length` bytes (input may equal output). Returns -1,
+// without processing anything, once the message would exceed GCM_MAX_TEXT
+int aes_gcm_update(aes_gcm_ctx *ctx, const uint8_t *input, uint8_t *output, size_t length);
+
+// Function to finish the message and write the 16-byte tag; the keystream state is wiped
+void aes_gcm_final(aes_gcm_ctx *ctx, uint8_t *tag);
+
+// Function to finish the message and compare its tag with `tag` in constant time; 1 when they match
+int aes_gcm_verify(aes_gcm_ctx *ctx, const uint8_t *tag);
+
+// Function to check AES-GCM against the published test vectors and the wide loop against the
+// block-at-a-time path; 1 when it passes
+int aes_gcm_self_test(void);
+
+// Function to encrypt a file with AES-GCM, appending the tag, or to decrypt and verify it; the job's
+// nonce is the 12-byte IV. Returns 0 on success
+int aes_gcm_process_file(const aes_job *job, const char *filename);
+
+#endif
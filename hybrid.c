@@ -0,0 +1,106 @@
+#include "hybrid.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "stream.h"
+
+size_t hybrid_header_size(const rsa_key *key)
+{
+    return HYBRID_PREFIX_SIZE + key->size;
+}
+
+int hybrid_seal(const rsa_key *key, int algorithm, const char *filename, uint8_t *file_key, uint8_t *header)
+{
+    memset(header, 0, HYBRID_PREFIX_SIZE);
+    memcpy(header, HYBRID_MAGIC, 8);
+    store_le(header + 8, HYBRID_VERSION, 2);
+    header[10] = (uint8_t)algorithm;
+    store_le(header + 12, key->size, 4);
+
+    // The fixed fields are the OAEP label, so they cannot be changed without breaking the unwrap
+    if (rsa_random(file_key, HYBRID_KEY_SIZE) != 0)
+    {
+        fprintf(stderr, "%s: Failed to generate a file key\n", filename);
+        return -1;
+    }
+    if (rsa_oaep_encrypt(key, header + HYBRID_PREFIX_SIZE, file_key, HYBRID_KEY_SIZE, header, HYBRID_PREFIX_SIZE) != 0)
+    {
+        fprintf(stderr, "%s: Failed to wrap the file key\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int hybrid_open(const rsa_key *key, int algorithm, const char *filename, uint8_t *file_key)
+{
+    uint8_t header[HYBRID_MAX_HEADER], unwrapped[RSA_MAX_SIZE];
+    size_t header_length = hybrid_header_size(key), length;
+    ssize_t n;
+    int result = 0;
+
+    // Standard input is read up to the body; a file is read at offset 0 and streamed from the body later
+    if (stream_is_stdio(filename))
+    {
+        n = stream_read_full(stream_stdio_input(), header, header_length, -1);
+    }
+    else
+    {
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0)
+        {
+            perror(filename);
+            return -1;
+        }
+        n = stream_read_full(fd, header, header_length, 0);
+        close(fd);
+    }
+    if (n < 0)
+    {
+        perror(filename);
+        return -1;
+    }
+
+    if ((size_t)n < HYBRID_PREFIX_SIZE || memcmp(header, HYBRID_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "%s: Not a file encrypted with an RSA key\n", filename);
+        return -1;
+    }
+    if (load_le(header + 8, 2) != HYBRID_VERSION)
+    {
+        fprintf(stderr, "%s: Unsupported version %u\n", filename, (unsigned)load_le(header + 8, 2));
+        return -1;
+    }
+    if (header[10] != algorithm)
+    {
+        fprintf(stderr, "%s: File was encrypted with a different algorithm\n", filename);
+        return -1;
+    }
+    if (load_le(header + 12, 4) != key->size)
+    {
+        fprintf(stderr, "%s: File was encrypted for a key of a different size\n", filename);
+        return -1;
+    }
+    if ((size_t)n < header_length)
+    {
+        fprintf(stderr, "%s: File is too short to hold its header\n", filename);
+        return -1;
+    }
+
+    if (rsa_oaep_decrypt(key, unwrapped, &length, header + HYBRID_PREFIX_SIZE, header, HYBRID_PREFIX_SIZE) != 0 ||
+        length != HYBRID_KEY_SIZE)
+    {
+        fprintf(stderr, "%s: The file key cannot be unwrapped (wrong private key, or the header was modified)\n",
+                filename);
+        result = -1;
+    }
+    else
+    {
+        memcpy(file_key, unwrapped, HYBRID_KEY_SIZE);
+    }
+    secure_zero(unwrapped, sizeof(unwrapped));
+    return result;
+}
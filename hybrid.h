@@ -0,0 +1,38 @@
+#ifndef HYBRID_H
+#define HYBRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rsa.h"
+
+// Hybrid file layout (integers little-endian):
+//
+//   header   16 bytes: magic "FCRYPTPK", u16 version, u8 algorithm, u8 0, u32 wrapped key size,
+//            then the wrapped key: the file key encrypted with RSA-OAEP (SHA-256) under the
+//            recipient's public key, with the first 16 header bytes as the OAEP label
+//   body     the file encrypted with the AEAD under the file key and an all-zero nonce, then its tag
+//
+// Every file gets a fresh random key, so the fixed nonce is never used twice with one key, and only
+// the key is encrypted with RSA: one public-key operation per file, whatever its size. Changing
+// the header makes the unwrap fail, and the body is authenticated by its tag
+#define HYBRID_MAGIC "FCRYPTPK"
+#define HYBRID_VERSION 1
+#define HYBRID_PREFIX_SIZE 16
+#define HYBRID_KEY_SIZE 32 // AES-256 or ChaCha20
+#define HYBRID_NONCE_SIZE 12
+#define HYBRID_MAX_HEADER (HYBRID_PREFIX_SIZE + RSA_MAX_SIZE)
+
+// Function to return the size of the header for files encrypted to `key`
+size_t hybrid_header_size(const rsa_key *key);
+
+// Function to draw a random file key for `filename` and build the header that carries it wrapped
+// with the public half of `key`. Errors are reported on stderr. Returns 0 on success
+int hybrid_seal(const rsa_key *key, int algorithm, const char *filename, uint8_t *file_key, uint8_t *header);
+
+// Function to read the header of `filename` and unwrap its file key with the private half of
+// `key`. Standard input (STREAM_STDIO) is left positioned at the body. Errors are reported on
+// stderr. Returns 0 on success
+int hybrid_open(const rsa_key *key, int algorithm, const char *filename, uint8_t *file_key);
+
+#endif
@@ -0,0 +1,370 @@
+#include <string.h>
+
+#include "bytes.h"
+#include "poly1305.h"
+
+// Function to load 4 or 8 little-endian bytes
+static uint32_t load32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+#if POLY1305_LIMB64
+static uint64_t load64_le(const uint8_t *p)
+{
+    return (uint64_t)load32_le(p) | (uint64_t)load32_le(p + 4) << 32;
+}
+
+// Function to store 8 little-endian bytes
+static void store64_le(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+typedef unsigned __int128 poly1305_u128;
+
+#define MASK44 0xfffffffffffULL
+#define MASK42 0x3ffffffffffULL
+
+void poly1305_init(poly1305_ctx *ctx, const uint8_t *key)
+{
+    uint64_t t0 = load64_le(key), t1 = load64_le(key + 8);
+
+    // r is clamped as the RFC requires and split into 44 + 44 + 42 bits
+    ctx->r[0] = t0 & 0xffc0fffffffULL;
+    ctx->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+    ctx->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+    ctx->h[0] = ctx->h[1] = ctx->h[2] = 0;
+    ctx->pad[0] = load64_le(key + 16);
+    ctx->pad[1] = load64_le(key + 24);
+    ctx->leftover = 0;
+}
+
+// Function to absorb whole 16-byte blocks: h = (h + block) * r mod 2^130 - 5. `hibit` is the
+// 2^128 bit of each block, clear only for the padded final block
+static void poly1305_blocks(poly1305_ctx *ctx, const uint8_t *m, size_t bytes, uint64_t hibit)
+{
+    const uint64_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+
+    while (bytes >= 16)
+    {
+        uint64_t t0 = load64_le(m), t1 = load64_le(m + 8), c;
+        h0 += t0 & MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+        h2 += ((t1 >> 24) & MASK42) | hibit;
+
+        poly1305_u128 d0 = (poly1305_u128)h0 * r0 + (poly1305_u128)h1 * s2 + (poly1305_u128)h2 * s1;
+        poly1305_u128 d1 = (poly1305_u128)h0 * r1 + (poly1305_u128)h1 * r0 + (poly1305_u128)h2 * s2;
+        poly1305_u128 d2 = (poly1305_u128)h0 * r2 + (poly1305_u128)h1 * r1 + (poly1305_u128)h2 * r0;
+
+        // Partial carry propagation keeps every limb small enough for the next block
+        c = (uint64_t)(d0 >> 44);
+        h0 = (uint64_t)d0 & MASK44;
+        d1 += c;
+        c = (uint64_t)(d1 >> 44);
+        h1 = (uint64_t)d1 & MASK44;
+        d2 += c;
+        c = (uint64_t)(d2 >> 42);
+        h2 = (uint64_t)d2 & MASK42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= MASK44;
+        h1 += c;
+
+        m += 16;
+        bytes -= 16;
+    }
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+}
+
+// Function to reduce h fully, add the pad and write the low 128 bits
+static void poly1305_emit(poly1305_ctx *ctx, uint8_t *tag)
+{
+    uint64_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+    uint64_t g0, g1, g2, c, t0, t1;
+
+    c = h1 >> 44;
+    h1 &= MASK44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= MASK42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= MASK44;
+    h1 += c;
+    c = h1 >> 44;
+    h1 &= MASK44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= MASK42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= MASK44;
+    h1 += c;
+
+    // g = h - p; keep it when h >= p, selected without branching on secret data
+    g0 = h0 + 5;
+    c = g0 >> 44;
+    g0 &= MASK44;
+    g1 = h1 + c;
+    c = g1 >> 44;
+    g1 &= MASK44;
+    g2 = h2 + c - (1ULL << 42);
+    c = (g2 >> 63) - 1;
+    h0 = (h0 & ~c) | (g0 & c);
+    h1 = (h1 & ~c) | (g1 & c);
+    h2 = (h2 & ~c) | (g2 & c);
+
+    // tag = (h + s) mod 2^128
+    t0 = ctx->pad[0];
+    t1 = ctx->pad[1];
+    h0 += t0 & MASK44;
+    c = h0 >> 44;
+    h0 &= MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c;
+    c = h1 >> 44;
+    h1 &= MASK44;
+    h2 += ((t1 >> 24) & MASK42) + c;
+    h2 &= MASK42;
+
+    store64_le(tag, h0 | (h1 << 44));
+    store64_le(tag + 8, (h1 >> 20) | (h2 << 24));
+}
+
+#define POLY1305_HIBIT (1ULL << 40)
+#else
+// Function to store 4 little-endian bytes
+static void store32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+#define MASK26 0x3ffffff
+
+void poly1305_init(poly1305_ctx *ctx, const uint8_t *key)
+{
+    // r is clamped as the RFC requires and split into five 26-bit limbs
+    ctx->r[0] = load32_le(key) & 0x3ffffff;
+    ctx->r[1] = (load32_le(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (load32_le(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (load32_le(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (load32_le(key + 12) >> 8) & 0x00fffff;
+    memset(ctx->h, 0, sizeof(ctx->h));
+    for (int i = 0; i < 4; i++)
+    {
+        ctx->pad[i] = load32_le(key + 16 + 4 * i);
+    }
+    ctx->leftover = 0;
+}
+
+// Function to absorb whole 16-byte blocks: h = (h + block) * r mod 2^130 - 5. `hibit` is the
+// 2^128 bit of each block, clear only for the padded final block
+static void poly1305_blocks(poly1305_ctx *ctx, const uint8_t *m, size_t bytes, uint32_t hibit)
+{
+    const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+
+    while (bytes >= 16)
+    {
+        uint64_t d0, d1, d2, d3, d4;
+        uint32_t c;
+        h0 += load32_le(m) & MASK26;
+        h1 += (load32_le(m + 3) >> 2) & MASK26;
+        h2 += (load32_le(m + 6) >> 4) & MASK26;
+        h3 += (load32_le(m + 9) >> 6) & MASK26;
+        h4 += (load32_le(m + 12) >> 8) | hibit;
+
+        d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        c = (uint32_t)(d0 >> 26);
+        h0 = (uint32_t)d0 & MASK26;
+        d1 += c;
+        c = (uint32_t)(d1 >> 26);
+        h1 = (uint32_t)d1 & MASK26;
+        d2 += c;
+        c = (uint32_t)(d2 >> 26);
+        h2 = (uint32_t)d2 & MASK26;
+        d3 += c;
+        c = (uint32_t)(d3 >> 26);
+        h3 = (uint32_t)d3 & MASK26;
+        d4 += c;
+        c = (uint32_t)(d4 >> 26);
+        h4 = (uint32_t)d4 & MASK26;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= MASK26;
+        h1 += c;
+
+        m += 16;
+        bytes -= 16;
+    }
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+    ctx->h[3] = h3;
+    ctx->h[4] = h4;
+}
+
+// Function to reduce h fully, add the pad and write the low 128 bits
+static void poly1305_emit(poly1305_ctx *ctx, uint8_t *tag)
+{
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+    uint32_t g0, g1, g2, g3, g4, c, mask;
+    uint64_t f;
+
+    c = h1 >> 26;
+    h1 &= MASK26;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= MASK26;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= MASK26;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= MASK26;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= MASK26;
+    h1 += c;
+
+    // g = h - p; keep it when h >= p, selected without branching on secret data
+    g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= MASK26;
+    g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= MASK26;
+    g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= MASK26;
+    g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= MASK26;
+    g4 = h4 + c - (1UL << 26);
+    mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    // Repack into 32-bit words, then tag = (h + s) mod 2^128
+    h0 = h0 | (h1 << 26);
+    h1 = (h1 >> 6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 << 8);
+    f = (uint64_t)h0 + ctx->pad[0];
+    store32_le(tag, (uint32_t)f);
+    f = (uint64_t)h1 + ctx->pad[1] + (f >> 32);
+    store32_le(tag + 4, (uint32_t)f);
+    f = (uint64_t)h2 + ctx->pad[2] + (f >> 32);
+    store32_le(tag + 8, (uint32_t)f);
+    f = (uint64_t)h3 + ctx->pad[3] + (f >> 32);
+    store32_le(tag + 12, (uint32_t)f);
+}
+
+#define POLY1305_HIBIT (1UL << 24)
+#endif
+
+void poly1305_update(poly1305_ctx *ctx, const uint8_t *message, size_t length)
+{
+    // Complete a partial block first
+    if (ctx->leftover)
+    {
+        size_t want = 16 - ctx->leftover;
+        if (want > length)
+        {
+            want = length;
+        }
+        memcpy(ctx->buffer + ctx->leftover, message, want);
+        ctx->leftover += want;
+        message += want;
+        length -= want;
+        if (ctx->leftover < 16)
+        {
+            return;
+        }
+        poly1305_blocks(ctx, ctx->buffer, 16, POLY1305_HIBIT);
+        ctx->leftover = 0;
+    }
+
+    size_t whole = length & ~(size_t)15;
+    if (whole)
+    {
+        poly1305_blocks(ctx, message, whole, POLY1305_HIBIT);
+        message += whole;
+        length -= whole;
+    }
+
+    memcpy(ctx->buffer, message, length);
+    ctx->leftover = length;
+}
+
+void poly1305_pad16(poly1305_ctx *ctx)
+{
+    static const uint8_t zeros[16] = {0};
+    if (ctx->leftover)
+    {
+        poly1305_update(ctx, zeros, 16 - ctx->leftover);
+    }
+}
+
+void poly1305_finish(poly1305_ctx *ctx, uint8_t *tag)
+{
+    // The last partial block is padded with a 1 byte and zeros, and has no 2^128 bit
+    if (ctx->leftover)
+    {
+        ctx->buffer[ctx->leftover] = 1;
+        memset(ctx->buffer + ctx->leftover + 1, 0, 16 - ctx->leftover - 1);
+        poly1305_blocks(ctx, ctx->buffer, 16, 0);
+    }
+    poly1305_emit(ctx, tag);
+
+    secure_zero(ctx, sizeof(*ctx));
+}
+
+int poly1305_verify(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t diff = 0;
+    for (int i = 0; i < POLY1305_TAG_SIZE; i++)
+    {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+int poly1305_self_test(void)
+{
+    // RFC 8439 2.5.2, fed in uneven pieces to exercise the partial-block path
+    static const uint8_t key[32] = {
+        0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+        0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b};
+    static const char message[] = "Cryptographic Forum Research Group";
+    static const uint8_t expected[16] = {
+        0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9};
+    poly1305_ctx ctx;
+    uint8_t tag[16];
+
+    poly1305_init(&ctx, key);
+    poly1305_update(&ctx, (const uint8_t *)message, 5);
+    poly1305_update(&ctx, (const uint8_t *)message + 5, 20);
+    poly1305_update(&ctx, (const uint8_t *)message + 25, sizeof(message) - 1 - 25);
+    poly1305_finish(&ctx, tag);
+    return poly1305_verify(tag, expected);
+}
@@ -0,0 +1,50 @@
+#ifndef POLY1305_H
+#define POLY1305_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POLY1305_KEY_SIZE 32
+#define POLY1305_TAG_SIZE 16
+
+// Use 44-bit limbs with 64x64->128-bit products where the compiler has them, 26-bit limbs otherwise
+#ifndef POLY1305_LIMB64
+#if defined(__SIZEOF_INT128__)
+#define POLY1305_LIMB64 1
+#else
+#define POLY1305_LIMB64 0
+#endif
+#endif
+
+// Structure to hold the running Poly1305 state: the clamped key r, the accumulator h and the
+// final pad s, plus a partial 16-byte block
+typedef struct
+{
+#if POLY1305_LIMB64
+    uint64_t r[3], h[3], pad[2];
+#else
+    uint32_t r[5], h[5], pad[4];
+#endif
+    uint8_t buffer[16];
+    size_t leftover;
+} poly1305_ctx;
+
+// Function to start a MAC with a one-time 32-byte key
+void poly1305_init(poly1305_ctx *ctx, const uint8_t *key);
+
+// Function to absorb `length` more bytes of the message
+void poly1305_update(poly1305_ctx *ctx, const uint8_t *message, size_t length);
+
+// Function to absorb zero bytes up to the next 16-byte boundary (the AEAD padding)
+void poly1305_pad16(poly1305_ctx *ctx);
+
+// Function to finish the MAC and write the 16-byte tag; the state is wiped
+void poly1305_finish(poly1305_ctx *ctx, uint8_t *tag);
+
+// Function to compare two tags in constant time; returns 1 when they match
+int poly1305_verify(const uint8_t *a, const uint8_t *b);
+
+// Function to check the implementation against the RFC 8439 test vector; 1 when it passes
+int poly1305_self_test(void);
+
+#endif
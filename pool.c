@@ -0,0 +1,314 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A queued task and the group it belongs to
+typedef struct
+{
+    pool_fn fn;
+    void *arg;
+    pool_group *group;
+} pool_task;
+
+// Growable ring of tasks; the owner works at the back, thieves take from the front
+typedef struct
+{
+    pthread_mutex_t lock;
+    pool_task *tasks;
+    size_t head, count, capacity;
+} pool_deque;
+
+struct pool
+{
+    int threads;
+    pthread_t *tids;
+    pool_deque *deques; // One per worker, plus the injection queue at index `threads`
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // Signalled when a task is queued or a group finishes
+    size_t queued;          // Tasks sitting in any deque; counted and uncounted under `lock`, and
+                            // a task is counted before any thread can take it
+    int stop;
+};
+
+// Index of the calling thread's deque in the pool it belongs to
+static __thread const pool *current_pool = NULL;
+static __thread int current_index = -1;
+
+// Function to append a task to the back of a deque
+static int deque_push(pool_deque *d, const pool_task *task)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity)
+    {
+        size_t capacity = d->capacity ? d->capacity * 2 : 64;
+        pool_task *tasks = malloc(capacity * sizeof(pool_task));
+        if (!tasks)
+        {
+            pthread_mutex_unlock(&d->lock);
+            return 0;
+        }
+        for (size_t i = 0; i < d->count; i++)
+        {
+            tasks[i] = d->tasks[(d->head + i) % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->head = 0;
+        d->capacity = capacity;
+    }
+    d->tasks[(d->head + d->count) % d->capacity] = *task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+// Function to take a task from the back (owner) or the front (thief) of a deque
+static int deque_take(pool_deque *d, pool_task *task, int back)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0)
+    {
+        if (back)
+        {
+            *task = d->tasks[(d->head + d->count - 1) % d->capacity];
+        }
+        else
+        {
+            *task = d->tasks[d->head];
+            d->head = (d->head + 1) % d->capacity;
+        }
+        d->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// Function to find work for deque `self`: own tasks first, then the injection queue, then steal
+static int pool_take(pool *p, int self, pool_task *task)
+{
+    int found = self < p->threads && deque_take(&p->deques[self], task, 1);
+    if (!found)
+    {
+        found = deque_take(&p->deques[p->threads], task, 0);
+    }
+    for (int i = 1; !found && i <= p->threads; i++)
+    {
+        int victim = (self + i) % (p->threads + 1);
+        if (victim != p->threads)
+        {
+            found = deque_take(&p->deques[victim], task, 0);
+        }
+    }
+    if (found)
+    {
+        pthread_mutex_lock(&p->lock);
+        p->queued--;
+        pthread_mutex_unlock(&p->lock);
+    }
+    return found;
+}
+
+// Function to run a task and mark it finished in its group
+static void pool_run(pool *p, const pool_task *task)
+{
+    task->fn(task->arg);
+    pthread_mutex_lock(&p->lock);
+    task->group->pending--;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Function to return the deque index of the calling thread (the injection queue for outsiders)
+static int pool_self(const pool *p)
+{
+    return current_pool == p ? current_index : p->threads;
+}
+
+// Start-up argument for a worker thread
+typedef struct
+{
+    pool *p;
+    int index;
+} pool_worker_arg;
+
+// Worker thread: run tasks until the pool is stopped and drained
+static void *pool_worker(void *arg)
+{
+    pool_worker_arg *w = (pool_worker_arg *)arg;
+    pool *p = w->p;
+    pool_task task;
+
+    current_pool = p;
+    current_index = w->index;
+    free(w);
+
+    for (;;)
+    {
+        if (pool_take(p, current_index, &task))
+        {
+            pool_run(p, &task);
+            continue;
+        }
+        pthread_mutex_lock(&p->lock);
+        while (p->queued == 0 && !p->stop)
+        {
+            pthread_cond_wait(&p->changed, &p->lock);
+        }
+        int done = p->queued == 0 && p->stop;
+        pthread_mutex_unlock(&p->lock);
+        if (done)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Function to resolve a requested thread count, where 0 means one per online core
+int pool_thread_count(int threads)
+{
+    if (threads <= 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+    return threads;
+}
+
+// Function to start a pool with `threads` workers (0 = one per online core); NULL on failure
+pool *pool_create(int threads)
+{
+    pool *p = calloc(1, sizeof(pool));
+    if (!p)
+    {
+        return NULL;
+    }
+    p->threads = pool_thread_count(threads);
+    p->tids = calloc(p->threads, sizeof(pthread_t));
+    p->deques = calloc(p->threads + 1, sizeof(pool_deque));
+    if (!p->tids || !p->deques)
+    {
+        free(p->tids);
+        free(p->deques);
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->changed, NULL);
+    for (int i = 0; i <= p->threads; i++)
+    {
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    }
+
+    for (int i = 0; i < p->threads; i++)
+    {
+        pool_worker_arg *w = malloc(sizeof(pool_worker_arg));
+        if (w)
+        {
+            w->p = p;
+            w->index = i;
+        }
+        if (!w || pthread_create(&p->tids[i], NULL, pool_worker, w) != 0)
+        {
+            // Run with the workers that did start; the waiting threads pick up the slack
+            free(w);
+            p->threads = i;
+            break;
+        }
+    }
+    return p;
+}
+
+// Function to return the number of workers in the pool
+int pool_size(const pool *p)
+{
+    return p->threads;
+}
+
+// Function to queue fn(arg) as part of `group`
+void pool_submit(pool *p, pool_group *group, pool_fn fn, void *arg)
+{
+    pool_task task = {fn, arg, group};
+
+    // The task is counted before the pool lock is released, so a thief that takes it at once
+    // cannot uncount it first (pool_take needs the pool lock to do so)
+    pthread_mutex_lock(&p->lock);
+    group->pending++;
+    int pushed = deque_push(&p->deques[pool_self(p)], &task);
+    if (pushed)
+    {
+        p->queued++;
+        pthread_cond_broadcast(&p->changed);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    if (!pushed)
+    {
+        // Out of memory for the queue: run it here instead
+        pool_run(p, &task);
+    }
+}
+
+// Function to wait until every task in `group` has finished, running queued tasks meanwhile
+void pool_wait(pool *p, pool_group *group)
+{
+    int self = pool_self(p);
+    pool_task task;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        int pending = group->pending;
+        pthread_mutex_unlock(&p->lock);
+        if (pending == 0)
+        {
+            break;
+        }
+
+        if (pool_take(p, self, &task))
+        {
+            pool_run(p, &task);
+            continue;
+        }
+
+        // Nothing to help with: sleep until a task is queued or one finishes
+        pthread_mutex_lock(&p->lock);
+        if (group->pending > 0 && p->queued == 0)
+        {
+            pthread_cond_wait(&p->changed, &p->lock);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+// Function to finish the queued tasks, stop the workers and free the pool
+void pool_destroy(pool *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->threads; i++)
+    {
+        pthread_join(p->tids[i], NULL);
+    }
+    for (int i = 0; i <= p->threads; i++)
+    {
+        pthread_mutex_destroy(&p->deques[i].lock);
+        free(p->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->changed);
+    free(p->deques);
+    free(p->tids);
+    free(p);
+}
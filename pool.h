@@ -0,0 +1,39 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Work-stealing thread pool. Each worker owns a deque: it pushes and pops its own tasks at the
+// back and, when idle, steals the oldest task from another worker's front. Tasks submitted from
+// outside the pool go to a shared injection queue.
+typedef struct pool pool;
+
+// Task entry point
+typedef void (*pool_fn)(void *arg);
+
+// Set of tasks that can be waited for together; initialise with POOL_GROUP_INIT
+typedef struct
+{
+    int pending;
+} pool_group;
+
+#define POOL_GROUP_INIT {0}
+
+// Function to resolve a requested thread count, where 0 means one per online core
+int pool_thread_count(int threads);
+
+// Function to start a pool with `threads` workers (0 = one per online core); NULL on failure
+pool *pool_create(int threads);
+
+// Function to return the number of workers in the pool
+int pool_size(const pool *p);
+
+// Function to queue fn(arg) as part of `group`
+void pool_submit(pool *p, pool_group *group, pool_fn fn, void *arg);
+
+// Function to wait until every task in `group` has finished, running queued tasks meanwhile so
+// that tasks may themselves submit and wait for subtasks
+void pool_wait(pool *p, pool_group *group);
+
+// Function to finish the queued tasks, stop the workers and free the pool
+void pool_destroy(pool *p);
+
+#endif
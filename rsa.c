@@ -1,63 +1,1158 @@
-#include <stdio.h>  // Include standard input/output library for handling input and output.
-#include <stdlib.h> // Include standard library for memory allocation, process control, and conversions.
+#include "rsa.h"
 
-// Function to perform modular exponentiation. It returns (base^exp) % mod.
-// This function is crucial for RSA as it handles the power and mod operations efficiently.
-long long mod_pow(long long base, long long exp, long long mod)
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytes.h"
+
+#define RSA_MAX_WINDOW 6     // Largest sliding window, for public exponents of more than 671 bits
+#define RSA_SECRET_WINDOW 5  // Fixed window for private exponents
+#define RSA_SIEVE_LIMIT 2048 // Candidate primes are first checked against the odd primes below this
+#define RSA_SIEVE_SPAN 65536 // Candidates tried after each random start before drawing a new one
+
+// Key file fields, in the order they are written
+enum
+{
+    RSA_FIELD_N,
+    RSA_FIELD_E,
+    RSA_FIELD_D,
+    RSA_FIELD_P,
+    RSA_FIELD_Q,
+    RSA_FIELD_DP,
+    RSA_FIELD_DQ,
+    RSA_FIELD_QINV,
+    RSA_FIELDS
+};
+
+static const char *const rsa_field_names[RSA_FIELDS] = {"n", "e", "d", "p", "q", "dp", "dq", "qinv"};
+
+int rsa_random(void *buffer, size_t length)
+{
+    uint8_t *out = (uint8_t *)buffer;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    while (length > 0)
+    {
+        ssize_t n = read(fd, out, length);
+        if (n <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        out += n;
+        length -= n;
+    }
+    close(fd);
+    return 0;
+}
+
+// Function to return bit `i` of a
+static unsigned bn_bit(const rsa_limb *a, size_t i)
+{
+    return (unsigned)(a[i / RSA_LIMB_BITS] >> (i % RSA_LIMB_BITS)) & 1;
+}
+
+// Function to count the significant bits of a
+static size_t bn_bits(const rsa_limb *a, size_t n)
+{
+    while (n > 0 && a[n - 1] == 0)
+    {
+        n--;
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+    size_t bits = n * RSA_LIMB_BITS;
+    for (rsa_limb top = a[n - 1]; !(top >> (RSA_LIMB_BITS - 1)); top <<= 1)
+    {
+        bits--;
+    }
+    return bits;
+}
+
+// Function to compare a and b; returns -1, 0 or 1. Not constant time
+static int bn_cmp(const rsa_limb *a, const rsa_limb *b, size_t n)
+{
+    while (n-- > 0)
+    {
+        if (a[n] != b[n])
+        {
+            return a[n] < b[n] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Function to set r = a + b; returns the carry out
+static rsa_limb bn_add(rsa_limb *r, const rsa_limb *a, const rsa_limb *b, size_t n)
+{
+    rsa_limb carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        rsa_dlimb s = (rsa_dlimb)a[i] + b[i] + carry;
+        r[i] = (rsa_limb)s;
+        carry = (rsa_limb)(s >> RSA_LIMB_BITS);
+    }
+    return carry;
+}
+
+// Function to set r = a - b; returns the borrow out
+static rsa_limb bn_sub(rsa_limb *r, const rsa_limb *a, const rsa_limb *b, size_t n)
+{
+    rsa_limb borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        rsa_dlimb d = (rsa_dlimb)a[i] - b[i] - borrow;
+        r[i] = (rsa_limb)d;
+        borrow = (rsa_limb)(d >> RSA_LIMB_BITS) & 1;
+    }
+    return borrow;
+}
+
+// Function to set r = a where `mask` is all ones and r = b where it is zero, without branching
+static void bn_select(rsa_limb *r, const rsa_limb *a, const rsa_limb *b, size_t n, rsa_limb mask)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        r[i] = (a[i] & mask) | (b[i] & ~mask);
+    }
+}
+
+// Function to set r (an + bn limbs, not overlapping the inputs) = a * b
+static void bn_mul(rsa_limb *r, const rsa_limb *a, size_t an, const rsa_limb *b, size_t bn)
+{
+    memset(r, 0, (an + bn) * sizeof(rsa_limb));
+    for (size_t i = 0; i < an; i++)
+    {
+        rsa_limb carry = 0;
+        for (size_t j = 0; j < bn; j++)
+        {
+            rsa_dlimb t = (rsa_dlimb)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (rsa_limb)t;
+            carry = (rsa_limb)(t >> RSA_LIMB_BITS);
+        }
+        r[i + bn] = carry;
+    }
+}
+
+// Function to set r = a * mul + add; returns the limb carried out
+static rsa_limb bn_mul_small(rsa_limb *r, const rsa_limb *a, size_t n, rsa_limb mul, rsa_limb add)
+{
+    rsa_limb carry = add;
+    for (size_t i = 0; i < n; i++)
+    {
+        rsa_dlimb t = (rsa_dlimb)a[i] * mul + carry;
+        r[i] = (rsa_limb)t;
+        carry = (rsa_limb)(t >> RSA_LIMB_BITS);
+    }
+    return carry;
+}
+
+// Function to set r = a / d (r may be NULL); returns a mod d
+static rsa_limb bn_div_small(rsa_limb *r, const rsa_limb *a, size_t n, rsa_limb d)
+{
+    rsa_dlimb rem = 0;
+    while (n-- > 0)
+    {
+        rem = rem << RSA_LIMB_BITS | a[n];
+        if (r)
+        {
+            r[n] = (rsa_limb)(rem / d);
+        }
+        rem %= d;
+    }
+    return (rsa_limb)rem;
+}
+
+// Function to set r = a >> shift, for shift less than n limbs
+static void bn_shift_right(rsa_limb *r, const rsa_limb *a, size_t n, size_t shift)
+{
+    size_t limbs = shift / RSA_LIMB_BITS, bits = shift % RSA_LIMB_BITS;
+    for (size_t i = 0; i < n; i++)
+    {
+        rsa_limb low = i + limbs < n ? a[i + limbs] : 0;
+        rsa_limb high = i + limbs + 1 < n ? a[i + limbs + 1] : 0;
+        r[i] = bits ? low >> bits | high << (RSA_LIMB_BITS - bits) : low;
+    }
+}
+
+// Function to read a big-endian number of `length` bytes; returns -1 when it does not fit in n limbs
+static int bn_from_bytes(rsa_limb *r, size_t n, const uint8_t *in, size_t length)
+{
+    memset(r, 0, n * sizeof(rsa_limb));
+    for (size_t k = 0; k < length; k++)
+    {
+        uint8_t byte = in[length - 1 - k];
+        if (k >= n * sizeof(rsa_limb))
+        {
+            if (byte)
+            {
+                return -1;
+            }
+            continue;
+        }
+        r[k / sizeof(rsa_limb)] |= (rsa_limb)byte << (8 * (k % sizeof(rsa_limb)));
+    }
+    return 0;
+}
+
+// Function to write a as a big-endian number of exactly `length` bytes
+static void bn_to_bytes(uint8_t *out, size_t length, const rsa_limb *a, size_t n)
+{
+    for (size_t k = 0; k < length; k++)
+    {
+        out[length - 1 - k] = k < n * sizeof(rsa_limb) ? (uint8_t)(a[k / sizeof(rsa_limb)] >> (8 * (k % sizeof(rsa_limb)))) : 0;
+    }
+}
+
+// Function to read a hexadecimal number; returns -1 when it is empty, not hexadecimal or does not
+// fit in n limbs
+static int bn_from_hex(rsa_limb *r, size_t n, const char *text)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t digits = strlen(text);
+
+    memset(r, 0, n * sizeof(rsa_limb));
+    if (digits == 0)
+    {
+        return -1;
+    }
+    for (size_t k = 0; k < digits; k++)
+    {
+        const char *digit = strchr(hex_digits, tolower((unsigned char)text[digits - 1 - k]));
+        if (!digit || !*digit)
+        {
+            return -1;
+        }
+        rsa_limb v = (rsa_limb)(digit - hex_digits);
+        if (k >= n * RSA_LIMB_BITS / 4)
+        {
+            if (v)
+            {
+                return -1;
+            }
+            continue;
+        }
+        r[k / (RSA_LIMB_BITS / 4)] |= v << (4 * (k % (RSA_LIMB_BITS / 4)));
+    }
+    return 0;
+}
+
+// Function to write a in hexadecimal without leading zeros
+static void bn_print_hex(FILE *out, const rsa_limb *a, size_t n)
+{
+    size_t digits = (bn_bits(a, n) + 3) / 4;
+    if (digits == 0)
+    {
+        fputc('0', out);
+    }
+    while (digits-- > 0)
+    {
+        fputc("0123456789abcdef"[(a[digits / (RSA_LIMB_BITS / 4)] >> (4 * (digits % (RSA_LIMB_BITS / 4)))) & 15], out);
+    }
+}
+
+// Function to set up Montgomery arithmetic modulo the odd `m` of `limbs` limbs
+static void mont_init(rsa_mont *mont, const rsa_limb *m, size_t limbs)
+{
+    rsa_limb x[RSA_LIMBS], u[RSA_LIMBS];
+
+    memset(mont, 0, sizeof(*mont));
+    mont->limbs = limbs;
+    memcpy(mont->m, m, limbs * sizeof(rsa_limb));
+
+    // m^-1 mod 2^RSA_LIMB_BITS by Newton's iteration: m is its own inverse to 3 bits, and each
+    // step doubles the bits that are right
+    rsa_limb inv = m[0];
+    for (int i = 0; i < 5; i++)
+    {
+        inv *= 2 - m[0] * inv;
+    }
+    mont->m0inv = 0 - inv;
+
+    // R^2 mod m, doubling 1 once for every bit of R^2
+    memset(x, 0, limbs * sizeof(rsa_limb));
+    x[0] = 1;
+    for (size_t i = 0; i < 2 * limbs * RSA_LIMB_BITS; i++)
+    {
+        rsa_limb carry = bn_add(x, x, x, limbs);
+        rsa_limb borrow = bn_sub(u, x, m, limbs);
+        bn_select(x, u, x, limbs, 0 - (carry | (borrow ^ 1)));
+    }
+    memcpy(mont->rr, x, limbs * sizeof(rsa_limb));
+}
+
+// Function to set r = a * b / R mod m (coarsely integrated operand scanning). `a` must be less
+// than R and `b` less than m; r may be either of them. The final subtraction is masked, so the
+// time does not depend on the values
+static void mont_mul(const rsa_mont *mont, rsa_limb *r, const rsa_limb *a, const rsa_limb *b)
+{
+    size_t n = mont->limbs;
+    rsa_limb t[RSA_LIMBS + 2], u[RSA_LIMBS];
+
+    memset(t, 0, (n + 2) * sizeof(rsa_limb));
+    for (size_t i = 0; i < n; i++)
+    {
+        // t += a * b[i]
+        rsa_limb carry = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            rsa_dlimb s = (rsa_dlimb)a[j] * b[i] + t[j] + carry;
+            t[j] = (rsa_limb)s;
+            carry = (rsa_limb)(s >> RSA_LIMB_BITS);
+        }
+        rsa_dlimb s = (rsa_dlimb)t[n] + carry;
+        t[n] = (rsa_limb)s;
+        t[n + 1] = (rsa_limb)(s >> RSA_LIMB_BITS);
+
+        // t = (t + q * m) / 2^RSA_LIMB_BITS, with q chosen so the low limb cancels
+        rsa_limb q = t[0] * mont->m0inv;
+        s = (rsa_dlimb)q * mont->m[0] + t[0];
+        carry = (rsa_limb)(s >> RSA_LIMB_BITS);
+        for (size_t j = 1; j < n; j++)
+        {
+            s = (rsa_dlimb)q * mont->m[j] + t[j] + carry;
+            t[j - 1] = (rsa_limb)s;
+            carry = (rsa_limb)(s >> RSA_LIMB_BITS);
+        }
+        s = (rsa_dlimb)t[n] + carry;
+        t[n - 1] = (rsa_limb)s;
+        t[n] = t[n + 1] + (rsa_limb)(s >> RSA_LIMB_BITS);
+    }
+
+    // t < 2m: subtract m unless that borrows past the top limb
+    rsa_limb borrow = bn_sub(u, t, mont->m, n);
+    bn_select(r, u, t, n, 0 - (t[n] | (borrow ^ 1)));
+}
+
+// Function to set r = a + b mod m, for a and b less than m
+static void mont_add(const rsa_mont *mont, rsa_limb *r, const rsa_limb *a, const rsa_limb *b)
+{
+    rsa_limb u[RSA_LIMBS];
+    rsa_limb carry = bn_add(r, a, b, mont->limbs);
+    rsa_limb borrow = bn_sub(u, r, mont->m, mont->limbs);
+    bn_select(r, u, r, mont->limbs, 0 - (carry | (borrow ^ 1)));
+}
+
+// Function to set r = a - b mod m, for a and b less than m
+static void mont_sub(const rsa_mont *mont, rsa_limb *r, const rsa_limb *a, const rsa_limb *b)
 {
-    long long result = 1; // Start with a result of 1.
-    while (exp > 0)
-    {                     // Continue looping until exp is 0.
-        if (exp % 2 == 1) // If exp is odd, multiply the current result by the base modulo mod.
-            result = (result * base) % mod;
-        base = (base * base) % mod; // Square the base and take mod.
-        exp /= 2;                   // Divide exp by 2.
+    rsa_limb u[RSA_LIMBS];
+    rsa_limb borrow = bn_sub(r, a, b, mont->limbs);
+    bn_add(u, r, mont->m, mont->limbs);
+    bn_select(r, u, r, mont->limbs, 0 - borrow);
+}
+
+// Function to set r to R mod m, the Montgomery form of 1
+static void mont_one(const rsa_mont *mont, rsa_limb *r)
+{
+    rsa_limb one[RSA_LIMBS];
+    memset(one, 0, mont->limbs * sizeof(rsa_limb));
+    one[0] = 1;
+    mont_mul(mont, r, one, mont->rr);
+}
+
+// Function to bring r out of Montgomery form
+static void mont_leave(const rsa_mont *mont, rsa_limb *r)
+{
+    rsa_limb one[RSA_LIMBS];
+    memset(one, 0, mont->limbs * sizeof(rsa_limb));
+    one[0] = 1;
+    mont_mul(mont, r, r, one);
+}
+
+// Function to set r (m's size) = a mod m for a number of any length, one m-sized chunk at a time
+// from the top: acc = acc * R + chunk
+static void mont_reduce(const rsa_mont *mont, rsa_limb *r, const rsa_limb *a, size_t a_limbs)
+{
+    size_t n = mont->limbs;
+    rsa_limb acc[RSA_LIMBS], chunk[RSA_LIMBS];
+
+    memset(acc, 0, n * sizeof(rsa_limb));
+    for (size_t c = (a_limbs + n - 1) / n; c > 0; c--)
+    {
+        size_t low = (c - 1) * n;
+        size_t count = a_limbs - low < n ? a_limbs - low : n;
+        memset(chunk, 0, n * sizeof(rsa_limb));
+        memcpy(chunk, a + low, count * sizeof(rsa_limb));
+        mont_mul(mont, chunk, chunk, mont->rr); // chunk * R mod m
+        mont_leave(mont, chunk);                // chunk mod m
+        mont_mul(mont, acc, acc, mont->rr);     // acc * R mod m
+        mont_add(mont, acc, acc, chunk);
     }
-    return result; // Return the final result of the modular exponentiation.
+    memcpy(r, acc, n * sizeof(rsa_limb));
+    secure_zero(chunk, sizeof(chunk));
 }
 
-// Main function: controls program execution.
-int main(int argc, char *argv[])
+// Function to choose the window for an exponent of `bits`, balancing the table it needs against
+// the multiplications it saves
+static int rsa_window_bits(size_t bits)
 {
-    // Check for the correct number of command-line arguments.
-    if (argc != 5)
+    return bits > 671 ? 6 : bits > 239 ? 5 : bits > 79 ? 4 : bits > 23 ? 3 : 1;
+}
+
+// Function to set r = base^exp mod m for a public exponent, with a sliding window over the odd
+// powers of base. The sequence of squarings and multiplications follows the exponent's bits, so
+// this must only see public exponents
+static void mont_pow_public(const rsa_mont *mont, rsa_limb *r, const rsa_limb *base, const rsa_limb *exp, size_t exp_limbs)
+{
+    rsa_limb table[1 << (RSA_MAX_WINDOW - 1)][RSA_LIMBS], square[RSA_LIMBS], acc[RSA_LIMBS];
+    size_t bits = bn_bits(exp, exp_limbs);
+    int window = rsa_window_bits(bits);
+
+    // base, base^3, base^5, ... base^(2^window - 1), in Montgomery form
+    mont_mul(mont, table[0], base, mont->rr);
+    mont_mul(mont, square, table[0], table[0]);
+    for (int i = 1; i < 1 << (window - 1); i++)
     {
-        fprintf(stderr, "Usage: %s <file> <n> <exp> <mode>\n", argv[0]); // Provide the correct usage if not met.
-        return 1;                                                        // Return an error status.
+        mont_mul(mont, table[i], table[i - 1], square);
     }
 
-    // Store command line arguments for easy access.
-    const char *filepath = argv[1]; // File path for input/output.
-    int n = atoi(argv[2]);          // Convert string to integer for modulus n.
-    int exp = atoi(argv[3]);        // Convert string to integer for exponent (e or d).
-    const char *mode = argv[4];     // Operation mode ("encrypt" or "decrypt").
+    // Square through zero bits; at a set bit take the longest window up to `window` bits that ends
+    // in a set bit, and multiply by its odd power
+    mont_one(mont, acc);
+    for (size_t i = bits; i > 0;)
+    {
+        if (!bn_bit(exp, i - 1))
+        {
+            mont_mul(mont, acc, acc, acc);
+            i--;
+            continue;
+        }
+        size_t low = i > (size_t)window ? i - window : 0;
+        while (!bn_bit(exp, low))
+        {
+            low++;
+        }
+        unsigned value = 0;
+        for (size_t k = i; k > low; k--)
+        {
+            mont_mul(mont, acc, acc, acc);
+            value = value << 1 | bn_bit(exp, k - 1);
+        }
+        mont_mul(mont, acc, acc, table[value >> 1]);
+        i = low;
+    }
+    mont_leave(mont, acc);
+    memcpy(r, acc, mont->limbs * sizeof(rsa_limb));
+}
 
-    // Open the file in read/write mode ("r+").
-    FILE *fp = fopen(filepath, "r+");
-    if (!fp)
+// Function to set r = base^exp mod m for a private exponent of exp_limbs limbs, in constant time:
+// every bit position is processed whatever its value, each window costs the same squarings and
+// one multiplication, and the table entry is picked by reading all of them
+static void mont_pow_secret(const rsa_mont *mont, rsa_limb *r, const rsa_limb *base, const rsa_limb *exp, size_t exp_limbs)
+{
+    rsa_limb table[1 << RSA_SECRET_WINDOW][RSA_LIMBS], pick[RSA_LIMBS], acc[RSA_LIMBS];
+    size_t n = mont->limbs;
+    size_t bits = exp_limbs * RSA_LIMB_BITS;
+    size_t windows = (bits + RSA_SECRET_WINDOW - 1) / RSA_SECRET_WINDOW;
+
+    // base^0 to base^(2^RSA_SECRET_WINDOW - 1), in Montgomery form
+    mont_one(mont, table[0]);
+    mont_mul(mont, table[1], base, mont->rr);
+    for (int i = 2; i < 1 << RSA_SECRET_WINDOW; i++)
+    {
+        mont_mul(mont, table[i], table[i - 1], table[1]);
+    }
+
+    for (size_t w = windows; w > 0; w--)
+    {
+        size_t low = (w - 1) * RSA_SECRET_WINDOW;
+        unsigned value = 0;
+        for (size_t k = low + RSA_SECRET_WINDOW; k > low; k--)
+        {
+            value = value << 1 | (k - 1 < bits ? bn_bit(exp, k - 1) : 0);
+        }
+        for (unsigned i = 0; i < 1 << RSA_SECRET_WINDOW; i++)
+        {
+            // All ones when i == value: (i ^ value) - 1 only sets the top bit for zero
+            rsa_limb mask = 0 - (rsa_limb)((((i ^ value) - 1) >> 31) & 1);
+            bn_select(pick, table[i], pick, n, mask);
+        }
+        if (w == windows)
+        {
+            memcpy(acc, pick, n * sizeof(rsa_limb));
+            continue;
+        }
+        for (int k = 0; k < RSA_SECRET_WINDOW; k++)
+        {
+            mont_mul(mont, acc, acc, acc);
+        }
+        mont_mul(mont, acc, acc, pick);
+    }
+    mont_leave(mont, acc);
+    memcpy(r, acc, n * sizeof(rsa_limb));
+    secure_zero(table, sizeof(table));
+    secure_zero(pick, sizeof(pick));
+    secure_zero(acc, sizeof(acc));
+}
+
+// Function to read an input block as a number less than n; returns 0 when it is
+static int rsa_input(const rsa_key *key, rsa_limb *x, const uint8_t *in)
+{
+    bn_from_bytes(x, key->n.limbs, in, key->size);
+    return bn_cmp(x, key->n.m, key->n.limbs) < 0 ? 0 : -1;
+}
+
+int rsa_public(const rsa_key *key, uint8_t *out, const uint8_t *in)
+{
+    rsa_limb x[RSA_LIMBS];
+
+    if (rsa_input(key, x, in) != 0)
     {
-        perror("Failed to open file"); // If the file fails to open, print an error.
-        return 1;                      // Return an error status.
+        return -1;
     }
+    mont_pow_public(&key->n, x, x, key->e, key->n.limbs);
+    bn_to_bytes(out, key->size, x, key->n.limbs);
+    return 0;
+}
 
-    int num;
-    // Attempt to read an integer from the file.
-    if (fscanf(fp, "%d", &num) != 1)
+int rsa_private(const rsa_key *key, uint8_t *out, const uint8_t *in)
+{
+    rsa_limb c[RSA_LIMBS], m1[RSA_LIMBS], m2[RSA_LIMBS], h[RSA_LIMBS], m[2 * RSA_LIMBS], check[RSA_LIMBS];
+    size_t n = key->n.limbs, pl = key->p.limbs, ql = key->q.limbs;
+    int result = 0;
+
+    if (!key->has_private || rsa_input(key, c, in) != 0)
     {
-        perror("Failed to read the number from the file"); // Error if read fails.
-        fclose(fp);                                        // Ensure the file is closed properly.
-        return 1;                                          // Return an error status.
+        return -1;
     }
 
-    // Perform the RSA encryption or decryption using the mod_pow function.
-    long long result = mod_pow(num, exp, n);
+    // Half-size exponentiations: m1 = c^dp mod p and m2 = c^dq mod q
+    mont_reduce(&key->p, m1, c, n);
+    mont_pow_secret(&key->p, m1, m1, key->dp, pl);
+    mont_reduce(&key->q, m2, c, n);
+    mont_pow_secret(&key->q, m2, m2, key->dq, ql);
+
+    // Garner's recombination: h = qinv (m1 - m2) mod p, m = m2 + h q
+    mont_reduce(&key->p, h, m2, ql);
+    mont_sub(&key->p, h, m1, h);
+    mont_mul(&key->p, h, h, key->qinv);
+    mont_mul(&key->p, h, h, key->p.rr);
+    bn_mul(m, h, pl, key->q.m, ql);
+    memset(m1, 0, sizeof(m1));
+    memcpy(m1, m2, ql * sizeof(rsa_limb));
+    bn_add(m, m, m1, n); // The sum is less than n
+
+    // A fault in either half would give a result that reveals a prime (Boneh-DeMillo-Lipton), so
+    // nothing is written unless it maps back to the input
+    mont_pow_public(&key->n, check, m, key->e, n);
+    if (bn_cmp(check, c, n) != 0)
+    {
+        result = -1;
+    }
+    else
+    {
+        bn_to_bytes(out, key->size, m, n);
+    }
+    secure_zero(m1, sizeof(m1));
+    secure_zero(m2, sizeof(m2));
+    secure_zero(h, sizeof(h));
+    secure_zero(m, sizeof(m));
+    return result;
+}
+
+// Function to XOR the MGF1 mask (SHA-256) of `seed` over `length` bytes of `out`
+static void rsa_mgf1_xor(uint8_t *out, size_t length, const uint8_t *seed, size_t seed_length)
+{
+    uint8_t digest[SHA256_DIGEST_SIZE], counter[4];
+    sha256_ctx ctx;
+
+    for (uint32_t i = 0; length > 0; i++)
+    {
+        size_t n = length < SHA256_DIGEST_SIZE ? length : SHA256_DIGEST_SIZE;
+        counter[0] = (uint8_t)(i >> 24);
+        counter[1] = (uint8_t)(i >> 16);
+        counter[2] = (uint8_t)(i >> 8);
+        counter[3] = (uint8_t)i;
+        sha256_init(&ctx);
+        sha256_update(&ctx, seed, seed_length);
+        sha256_update(&ctx, counter, sizeof(counter));
+        sha256_final(&ctx, digest);
+        for (size_t j = 0; j < n; j++)
+        {
+            out[j] ^= digest[j];
+        }
+        out += n;
+        length -= n;
+    }
+    secure_zero(digest, sizeof(digest));
+}
+
+int rsa_oaep_encrypt(const rsa_key *key, uint8_t *out, const uint8_t *message, size_t length,
+                     const uint8_t *label, size_t label_length)
+{
+    uint8_t em[RSA_MAX_SIZE];
+    size_t k = key->size;
+    uint8_t *seed = em + 1, *db = em + 1 + SHA256_DIGEST_SIZE;
+    size_t db_length = k - SHA256_DIGEST_SIZE - 1;
+    int result;
+
+    if (length > k - RSA_OAEP_OVERHEAD)
+    {
+        return -1;
+    }
+
+    // EM = 0 || seed ^ mask(db') || db' with db = hash(label) || 0... || 1 || message and
+    // db' = db ^ mask(seed)
+    memset(em, 0, k);
+    sha256(label, label_length, db);
+    db[db_length - length - 1] = 1;
+    memcpy(db + db_length - length, message, length);
+    if (rsa_random(seed, SHA256_DIGEST_SIZE) != 0)
+    {
+        secure_zero(em, sizeof(em));
+        return -1;
+    }
+    rsa_mgf1_xor(db, db_length, seed, SHA256_DIGEST_SIZE);
+    rsa_mgf1_xor(seed, SHA256_DIGEST_SIZE, db, db_length);
+
+    result = rsa_public(key, out, em);
+    secure_zero(em, sizeof(em));
+    return result;
+}
+
+// Function to return 1 when x is 0 and 0 otherwise, without a branch
+static size_t rsa_is_zero(size_t x)
+{
+    return (~x & (x - 1)) >> (sizeof(size_t) * 8 - 1);
+}
+
+int rsa_oaep_decrypt(const rsa_key *key, uint8_t *out, size_t *length, const uint8_t *in,
+                     const uint8_t *label, size_t label_length)
+{
+    uint8_t em[RSA_MAX_SIZE], hash[SHA256_DIGEST_SIZE];
+    size_t k = key->size;
+    uint8_t *seed = em + 1, *db = em + 1 + SHA256_DIGEST_SIZE;
+    size_t db_length = k - SHA256_DIGEST_SIZE - 1;
+    size_t bad, looking = 1, index = 0;
+
+    if (rsa_private(key, em, in) != 0)
+    {
+        return -1;
+    }
+    rsa_mgf1_xor(seed, SHA256_DIGEST_SIZE, db, db_length);
+    rsa_mgf1_xor(db, db_length, seed, SHA256_DIGEST_SIZE);
+
+    // The leading byte must be 0 and the label hash must match; then zeros until the 1 that starts
+    // the message. Every byte is looked at whatever it holds, so the time does not show where the
+    // padding went wrong (Manger's attack)
+    sha256(label, label_length, hash);
+    bad = em[0];
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++)
+    {
+        bad |= db[i] ^ hash[i];
+    }
+    for (size_t i = SHA256_DIGEST_SIZE; i < db_length; i++)
+    {
+        size_t is_one = rsa_is_zero(db[i] ^ 1), is_zero = rsa_is_zero(db[i]);
+        size_t found = looking & is_one;
+        index = (index & (found - 1)) | (i & (0 - found));
+        bad |= looking & ((is_one | is_zero) ^ 1); // Neither 0 nor 1 before the separator
+        looking &= is_one ^ 1;
+    }
+    bad |= looking;
+
+    int result = -1;
+    if (bad == 0)
+    {
+        *length = db_length - index - 1;
+        memcpy(out, db + index + 1, *length);
+        result = 0;
+    }
+    secure_zero(em, sizeof(em));
+    return result;
+}
+
+// Function to set up a key from its key file fields (NULL where absent); returns 0 when the key
+// is complete and consistent
+static int rsa_key_build(rsa_key *key, const char *const *fields)
+{
+    rsa_limb v[RSA_LIMBS], product[2 * RSA_LIMBS];
+    const int private_fields[] = {RSA_FIELD_P, RSA_FIELD_Q, RSA_FIELD_DP, RSA_FIELD_DQ, RSA_FIELD_QINV};
+    size_t given = 0, limbs, bits, pl, ql;
+
+    memset(key, 0, sizeof(*key));
+    if (!fields[RSA_FIELD_N] || !fields[RSA_FIELD_E] || bn_from_hex(v, RSA_LIMBS, fields[RSA_FIELD_N]) != 0)
+    {
+        return -1;
+    }
+    bits = bn_bits(v, RSA_LIMBS);
+    if (bits < RSA_MIN_BITS || bits > RSA_MAX_BITS || !(v[0] & 1))
+    {
+        return -1;
+    }
+    limbs = (bits + RSA_LIMB_BITS - 1) / RSA_LIMB_BITS;
+    mont_init(&key->n, v, limbs);
+    key->bits = bits;
+    key->size = (bits + 7) / 8;
+
+    // The public exponent: odd, more than 1 and less than n
+    if (bn_from_hex(key->e, limbs, fields[RSA_FIELD_E]) != 0 || !(key->e[0] & 1) || bn_bits(key->e, limbs) < 2 ||
+        bn_cmp(key->e, key->n.m, limbs) >= 0)
+    {
+        return -1;
+    }
+    if (fields[RSA_FIELD_D] && bn_from_hex(key->d, limbs, fields[RSA_FIELD_D]) != 0)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(private_fields) / sizeof(private_fields[0]); i++)
+    {
+        given += fields[private_fields[i]] != NULL;
+    }
+    if (given == 0)
+    {
+        return 0;
+    }
+    if (given != sizeof(private_fields) / sizeof(private_fields[0]))
+    {
+        return -1;
+    }
+
+    // Odd primes whose product is n, and CRT values reduced modulo them
+    if (bn_from_hex(v, limbs, fields[RSA_FIELD_P]) != 0 || !(v[0] & 1) || bn_bits(v, limbs) < 2)
+    {
+        return -1;
+    }
+    pl = (bn_bits(v, limbs) + RSA_LIMB_BITS - 1) / RSA_LIMB_BITS;
+    mont_init(&key->p, v, pl);
+    if (bn_from_hex(v, limbs, fields[RSA_FIELD_Q]) != 0 || !(v[0] & 1) || bn_bits(v, limbs) < 2)
+    {
+        return -1;
+    }
+    ql = (bn_bits(v, limbs) + RSA_LIMB_BITS - 1) / RSA_LIMB_BITS;
+    mont_init(&key->q, v, ql);
+    if (pl + ql > RSA_LIMBS + 1)
+    {
+        return -1;
+    }
+    bn_mul(product, key->p.m, pl, key->q.m, ql);
+    memset(v, 0, sizeof(v));
+    memcpy(v, key->n.m, limbs * sizeof(rsa_limb));
+    if (bn_bits(product, pl + ql) != bits || bn_cmp(product, v, limbs) != 0)
+    {
+        return -1;
+    }
+    if (bn_from_hex(key->dp, pl, fields[RSA_FIELD_DP]) != 0 || bn_cmp(key->dp, key->p.m, pl) >= 0 ||
+        bn_from_hex(key->dq, ql, fields[RSA_FIELD_DQ]) != 0 || bn_cmp(key->dq, key->q.m, ql) >= 0 ||
+        bn_from_hex(key->qinv, pl, fields[RSA_FIELD_QINV]) != 0 || bn_cmp(key->qinv, key->p.m, pl) >= 0)
+    {
+        return -1;
+    }
+    key->has_private = 1;
+    return 0;
+}
+
+int rsa_key_load(rsa_key *key, FILE *in)
+{
+    char line[2 * RSA_MAX_SIZE + 64];
+    char *fields[RSA_FIELDS] = {NULL};
+    int result = 0, i;
+
+    while (result == 0 && fgets(line, sizeof(line), in))
+    {
+        size_t length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n')
+        {
+            result = -1; // Longer than any field can be
+            break;
+        }
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' '))
+        {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        // "name hex": each field once
+        char *value = strchr(line, ' ');
+        if (!value)
+        {
+            result = -1;
+            break;
+        }
+        *value++ = '\0';
+        for (i = 0; i < RSA_FIELDS && strcmp(line, rsa_field_names[i]) != 0; i++)
+        {
+        }
+        if (i == RSA_FIELDS || fields[i] || !(fields[i] = strdup(value)))
+        {
+            result = -1;
+        }
+    }
+    if (result == 0)
+    {
+        result = rsa_key_build(key, (const char *const *)fields);
+    }
+    for (i = 0; i < RSA_FIELDS; i++)
+    {
+        if (fields[i])
+        {
+            secure_zero(fields[i], strlen(fields[i]));
+            free(fields[i]);
+        }
+    }
+    secure_zero(line, sizeof(line));
+    return result;
+}
+
+int rsa_key_save(const rsa_key *key, FILE *out, int include_private)
+{
+    const rsa_limb *values[RSA_FIELDS] = {key->n.m, key->e, key->d, key->p.m, key->q.m, key->dp, key->dq, key->qinv};
+    const size_t limbs[RSA_FIELDS] = {key->n.limbs, key->n.limbs, key->n.limbs, key->p.limbs,
+                                      key->q.limbs, key->p.limbs, key->q.limbs, key->p.limbs};
+    int fields = include_private && key->has_private ? RSA_FIELDS : RSA_FIELD_D;
+
+    fprintf(out, "# RSA-%zu %s key\n", key->bits, fields == RSA_FIELDS ? "private" : "public");
+    for (int i = 0; i < fields; i++)
+    {
+        fprintf(out, "%s ", rsa_field_names[i]);
+        bn_print_hex(out, values[i], limbs[i]);
+        fputc('\n', out);
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+void rsa_key_wipe(rsa_key *key)
+{
+    secure_zero(key, sizeof(*key));
+}
+
+// Function to return a^-1 mod m for small values, or 0 when a and m share a factor
+static rsa_limb rsa_inverse_small(rsa_limb a, rsa_limb m)
+{
+    int64_t t = 0, next_t = 1, r = (int64_t)m, next_r = (int64_t)(a % m);
+    while (next_r != 0)
+    {
+        int64_t q = r / next_r, swap = t - q * next_t;
+        t = next_t;
+        next_t = swap;
+        swap = r - q * next_r;
+        r = next_r;
+        next_r = swap;
+    }
+    if (r != 1)
+    {
+        return 0;
+    }
+    return (rsa_limb)(t < 0 ? t + (int64_t)m : t);
+}
+
+// Function to set x = e^-1 mod m for a small e coprime to m: with k = -m^-1 mod e, k m + 1 is a
+// multiple of e, and x = (k m + 1) / e is less than m. Returns 0 on success
+static int rsa_inverse_e(rsa_limb *x, const rsa_limb *m, size_t limbs, rsa_limb e)
+{
+    rsa_limb t[RSA_LIMBS + 1];
+    rsa_limb inverse = rsa_inverse_small(bn_div_small(NULL, m, limbs, e), e);
+
+    if (inverse == 0)
+    {
+        return -1;
+    }
+    t[limbs] = bn_mul_small(t, m, limbs, e - inverse, 1);
+    if (bn_div_small(t, t, limbs + 1, e) != 0)
+    {
+        return -1;
+    }
+    memcpy(x, t, limbs * sizeof(rsa_limb));
+    secure_zero(t, sizeof(t));
+    return 0;
+}
+
+// Function to run `rounds` Miller-Rabin tests with random bases; returns 1 for a probable prime, 0
+// for a composite and -1 when no random bytes could be read
+static int rsa_miller_rabin(const rsa_mont *mont, int rounds)
+{
+    size_t n = mont->limbs, bits = bn_bits(mont->m, n), s = 1;
+    rsa_limb t[RSA_LIMBS], a[RSA_LIMBS], x[RSA_LIMBS], one[RSA_LIMBS], minus_one[RSA_LIMBS];
+    uint8_t bytes[RSA_MAX_SIZE];
+    int result = 1;
+
+    // m - 1 = 2^s t with t odd; m is odd, so bit 0 of m - 1 is clear
+    memcpy(t, mont->m, n * sizeof(rsa_limb));
+    t[0] &= ~(rsa_limb)1;
+    while (!bn_bit(t, s))
+    {
+        s++;
+    }
+    bn_shift_right(t, t, n, s);
+    mont_one(mont, one);
+    bn_sub(minus_one, mont->m, one, n);
+
+    for (int round = 0; round < rounds && result == 1; round++)
+    {
+        // A base from 2 to m - 2: fewer bits than m, and not 0 or 1
+        do
+        {
+            if (rsa_random(bytes, (bits + 7) / 8) != 0)
+            {
+                return -1;
+            }
+            bn_from_bytes(a, n, bytes, (bits + 7) / 8);
+            a[(bits - 1) / RSA_LIMB_BITS] &= ((rsa_limb)1 << ((bits - 1) % RSA_LIMB_BITS)) - 1;
+        } while (bn_bits(a, n) < 2);
+
+        // a^t must be 1 or -1, or become -1 within s - 1 squarings
+        mont_pow_secret(mont, x, a, t, n);
+        mont_mul(mont, x, x, mont->rr);
+        int witness = bn_cmp(x, one, n) != 0 && bn_cmp(x, minus_one, n) != 0;
+        for (size_t i = 1; i < s && witness; i++)
+        {
+            mont_mul(mont, x, x, x);
+            if (bn_cmp(x, one, n) == 0)
+            {
+                break;
+            }
+            witness = bn_cmp(x, minus_one, n) != 0;
+        }
+        if (witness)
+        {
+            result = 0;
+        }
+    }
+    secure_zero(t, sizeof(t));
+    secure_zero(x, sizeof(x));
+    return result;
+}
+
+// Function to find a random prime of exactly `bits` bits with the top two set (so the product of
+// two has twice the bits) and p - 1 coprime to the public exponent. From a random odd start,
+// candidates step by 2 and are sieved with their residues modulo the small primes, so only
+// survivors reach Miller-Rabin. Returns 0 on success
+static int rsa_random_prime(rsa_mont *mont, size_t bits)
+{
+    uint16_t primes[RSA_SIEVE_LIMIT / 2], residues[RSA_SIEVE_LIMIT / 2];
+    uint8_t composite[RSA_SIEVE_LIMIT] = {0};
+    uint8_t bytes[RSA_MAX_SIZE];
+    rsa_limb v[RSA_LIMBS], step[RSA_LIMBS];
+    size_t count = 0, limbs = (bits + RSA_LIMB_BITS - 1) / RSA_LIMB_BITS, size = (bits + 7) / 8;
+
+    for (unsigned i = 3; i < RSA_SIEVE_LIMIT; i += 2)
+    {
+        if (!composite[i])
+        {
+            primes[count++] = (uint16_t)i;
+            for (unsigned j = i * i; j < RSA_SIEVE_LIMIT; j += 2 * i)
+            {
+                composite[j] = 1;
+            }
+        }
+    }
+
+    for (;;)
+    {
+        if (rsa_random(bytes, size) != 0)
+        {
+            return -1;
+        }
+        bn_from_bytes(v, limbs, bytes, size);
+        if (bits % RSA_LIMB_BITS)
+        {
+            v[limbs - 1] &= ((rsa_limb)1 << (bits % RSA_LIMB_BITS)) - 1;
+        }
+        v[(bits - 1) / RSA_LIMB_BITS] |= (rsa_limb)1 << ((bits - 1) % RSA_LIMB_BITS);
+        v[(bits - 2) / RSA_LIMB_BITS] |= (rsa_limb)1 << ((bits - 2) % RSA_LIMB_BITS);
+        v[0] |= 1;
+        for (size_t i = 0; i < count; i++)
+        {
+            residues[i] = (uint16_t)bn_div_small(NULL, v, limbs, primes[i]);
+        }
+        rsa_limb residue_e = bn_div_small(NULL, v, limbs, RSA_PUBLIC_EXPONENT);
+
+        for (rsa_limb delta = 0; delta < RSA_SIEVE_SPAN; delta += 2)
+        {
+            size_t i = 0;
+            while (i < count && (residues[i] + delta) % primes[i] != 0)
+            {
+                i++;
+            }
+            if (i < count || (residue_e + delta) % RSA_PUBLIC_EXPONENT == 1)
+            {
+                continue;
+            }
+
+            // The step could carry out of the top bits; then start again
+            memset(step, 0, limbs * sizeof(rsa_limb));
+            step[0] = delta;
+            bn_add(step, v, step, limbs);
+            if (bn_bits(step, limbs) != bits || !bn_bit(step, bits - 2))
+            {
+                break;
+            }
+            mont_init(mont, step, limbs);
+            int prime = rsa_miller_rabin(mont, RSA_MR_ROUNDS);
+            if (prime != 0)
+            {
+                secure_zero(v, sizeof(v));
+                secure_zero(step, sizeof(step));
+                return prime == 1 ? 0 : -1;
+            }
+        }
+    }
+}
+
+int rsa_generate(rsa_key *key, size_t bits)
+{
+    rsa_limb pm1[RSA_LIMBS], qm1[RSA_LIMBS], product[2 * RSA_LIMBS], t[RSA_LIMBS];
+    rsa_mont p, q;
+    size_t pl, ql;
+    int result = 0;
+
+    if (bits < RSA_MIN_BITS || bits > RSA_MAX_BITS || bits % 2 != 0)
+    {
+        return -1;
+    }
+    do
+    {
+        if (rsa_random_prime(&p, bits / 2) != 0 || rsa_random_prime(&q, bits / 2) != 0)
+        {
+            return -1;
+        }
+    } while (bn_cmp(p.m, q.m, p.limbs) == 0);
+    if (bn_cmp(p.m, q.m, p.limbs) < 0)
+    {
+        rsa_mont swap = p;
+        p = q;
+        q = swap;
+    }
+    pl = p.limbs;
+    ql = q.limbs;
+
+    memset(key, 0, sizeof(*key));
+    bn_mul(product, p.m, pl, q.m, ql);
+    mont_init(&key->n, product, (bits + RSA_LIMB_BITS - 1) / RSA_LIMB_BITS);
+    key->bits = bits;
+    key->size = (bits + 7) / 8;
+    key->e[0] = RSA_PUBLIC_EXPONENT;
+    key->p = p;
+    key->q = q;
+
+    // d, dp and dq are inverses of e modulo (p - 1)(q - 1), p - 1 and q - 1; p and q are odd
+    memcpy(pm1, p.m, pl * sizeof(rsa_limb));
+    memcpy(qm1, q.m, ql * sizeof(rsa_limb));
+    pm1[0] &= ~(rsa_limb)1;
+    qm1[0] &= ~(rsa_limb)1;
+    bn_mul(product, pm1, pl, qm1, ql);
+    if (rsa_inverse_e(key->d, product, pl + ql, RSA_PUBLIC_EXPONENT) != 0 ||
+        rsa_inverse_e(key->dp, pm1, pl, RSA_PUBLIC_EXPONENT) != 0 ||
+        rsa_inverse_e(key->dq, qm1, ql, RSA_PUBLIC_EXPONENT) != 0)
+    {
+        result = -1;
+    }
+
+    // qinv = q^(p - 2) mod p, since p is prime
+    memset(t, 0, pl * sizeof(rsa_limb));
+    t[0] = 2;
+    bn_sub(pm1, p.m, t, pl);
+    mont_reduce(&key->p, t, q.m, ql);
+    mont_pow_secret(&key->p, key->qinv, t, pm1, pl);
+    key->has_private = result == 0;
+
+    secure_zero(pm1, sizeof(pm1));
+    secure_zero(qm1, sizeof(qm1));
+    secure_zero(product, sizeof(product));
+    secure_zero(t, sizeof(t));
+    secure_zero(&p, sizeof(p));
+    secure_zero(&q, sizeof(q));
+    if (result != 0)
+    {
+        rsa_key_wipe(key);
+    }
+    return result;
+}
+
+int rsa_self_test(void)
+{
+    // 2048-bit key made with OpenSSL, and the raw RSA ciphertext OpenSSL computes for the message
+    static const char *const fields[RSA_FIELDS] = {
+        [RSA_FIELD_N] = "bfc1194a0722634f926959b0aacd6b4ed432c33220f7521749c89014a4e31a11fc829923935e85fde3677f2454600418"
+            "49f820c0305d77c0f4f9924b5c1a8545623431edfdaf9c0c7a8b22956de43a96fa3bc80bae3ad97bdad939ccf477b680"
+            "843ba3f5141454d1c055cb42d0c63e9c2d7f4ba5bd202b2fd0afc31caa2588b2f74e6137b6438048720dbbfd4742f00a"
+            "59295fe8b7ae69a0d623055838a273971519f2a999df5669d5331a4483cfa106924d3f0d8f15c26c243ffed2d6b44159"
+            "092e07d2a24b8736c9d85bea124cd7a882e7571905134a69cccf4d4aec614fda05b478902892a947d4be2f405555ca05"
+            "a02402372650f8b9a75e608efcdb200b",
+        [RSA_FIELD_E] = "010001",
+        [RSA_FIELD_D] = "5edfa1ed0c199a0c5132f9b2dcd754fc0426778872621bc634f5dc3fb293409f5c919b464c504cb860cea0cbef49304d"
+            "7a2f9fb8a7555f7e6356a5e8ce51bad5a8f08d31a4be41d5b4bde967089f8ed38b4c8fbe23beaf4345f50b519a352ee1"
+            "684b7fe42ec29e72c7184bc0abbe22553077968c92c5fb48259708d0c2685eb8de26d6445c965e615e42bd1d8a54d0e1"
+            "7837b4d48043c06d43d675d248c50c6b5dbd63aac6b0219c9dfde345b904121f89ee414b65d73d6cbce7cf704539a478"
+            "9ffabce897ea1f7b2fdd6cf2deacf70ab155411088a8e0f83dbf6295252950afecde0328a8b4dc86a24a1577879181c4"
+            "392e5a02002d9bd20edbfbe1ab552215",
+        [RSA_FIELD_P] = "e444297a276ab6c8fe4583ccc8bb10649c6bf47b78a50674ce161d392be60775aabaf09f4e97182b1f750578439e53e2"
+            "02fa59f5121911619ed7f263d12b1669e97f1bf9d206a82d01f240a6665400d362a37a902af014984e1aa83025088bd5"
+            "93810a6cc877067149c8fe9ee4b9b246d95ea58f5f7ceecb6857d91a65462c4f",
+        [RSA_FIELD_Q] = "d70d4b220d08fa83215769971f3f33c542e509565d9fba1080dcb8df21855f73a91f680ae630ee44353f3ee2a58ae79f"
+            "b2b4fc1cc52c92a130e7d8b471f87d6a4a595c2096ad55c4dbc918015c49f4720c67d3fa61777f1751195beeed85ff59"
+            "ba4970fba5111d380425061c70a92807e484cf8d832dce20e53111cd78fa7585",
+        [RSA_FIELD_DP] = "d037d0f1e964b16934702aa2b173d9a73cfc489e1c55c446e5fa4c1beb8c3fbfb8c61f59e1f1778d567b834ac9bb71de"
+            "d74290ae391cfebae28f2f3e97fd4acbbfbf3fc0a9318354d2d2ace05cb541af90e978926b686610ec25eac747f0bcc5"
+            "4c70c816a4e1d5d19f31a5f940c096fb83aa8f30f2345f0ad29a57a279410287",
+        [RSA_FIELD_DQ] = "6c29317ac4d79937ced32a3669eeddd8ff1637260b1cc4f67bf987ba221ff4ac3589a848a3124524652b9433665380bf"
+            "dfa00b9564ce5049665195badbffc1046eb4971384f5554817cb0299dc930db136f019bbbabde15c16dc0c53157fe9b8"
+            "756b6eba0281a312837323a9b6383dfc0a418a2a80a9cf1cd8695facda860e09",
+        [RSA_FIELD_QINV] = "08e39c1c2006d7c520bf2375cd59bd89f3f12e7e93b9486a96075017fdd4f674054cc172313c961c134636559873d059"
+            "d3a8a8ade32be3ba2c00e4164f4476ec18f90e3560c4a954d9f459c1f22268ab8f887eaf2e5c53f26ed70371fe18f23e"
+            "32803805f43bea832e3aeb9938b63c1103615f0cca4ebab4b3d416f934e02ca8",
+    };
+    static const char message[] = "libfilecrypt RSA known-answer test";
+    static const char ciphertext[] =
+        "2235fcc499b9c014129e07098dc2877fd08eb1c5a8f5e4dbe75ccefcdbf4e2bf3bbb0045c9750550e4609c3696c4fc84"
+        "96acc93893299fa10f2f5367cd79284b3b4eb292d358091b84128a476c67d865e24835bc2d1e2275d271826eda762130"
+        "567448781e88ac7888691b04e80ebf13a71ec380c6e079417f83ef72617a439f49ad77bfd861daf5944f3d310f3a4bfb"
+        "60df90e655e3536d4461afb40f4ed5c7da46c5e2888804071852bcbda5625d1fefd9fe4c58c04955700cc7c303f16b21"
+        "26e263c3e48fd9f0f8ddf8878f1c72d9a9229b93876c285a9de1c633321c5c90af30d5e27f9a05da5177356b4c62ee81"
+        "1ddbbed6e1e8c3e4173b79e1416d58d8";
+    // The same message wrapped by OpenSSL with RSA-OAEP (SHA-256), labelled "libfilecrypt"
+    static const char label[] = "libfilecrypt";
+    static const char oaep[] =
+        "4ccb43bc7709e9599014724bed42ae873644712ebd32749a1f08fc8ecc831961775180276d1b7e066b62a99a664d5931"
+        "18d7cac5d394a741be32dcba34fe112179d1016f2a271ca1ad704407ced2e9e4747f19c8d0c288a72b7cc7bd89361eca"
+        "e46291d67afe573280f1210596811ecea171f39715f1e9edd5c2aea51e88c19f3147f165d08de542cf44a25e965b5702"
+        "33370fe8fb414de3ecf63449abb1d930da377f6312a3a43ea3c4a20d92350de99da59ebf252184de77501167827a1d35"
+        "04cfea18edf7101dbbe8cf164f0a6702e16609d514d856e6f4fde5fb466700ccbc84d93923ae57721321e5695133d44c"
+        "9522ffb43a64435b3fb7ff27a8ca260a";
+    uint8_t block[RSA_MAX_SIZE] = {0}, expected[RSA_MAX_SIZE] = {0}, out[RSA_MAX_SIZE];
+    rsa_limb c[RSA_LIMBS], m[RSA_LIMBS];
+    rsa_key key;
+    size_t length;
+    int ok;
+
+    if (!sha256_self_test() || rsa_key_build(&key, fields) != 0 || !key.has_private)
+    {
+        return -1;
+    }
+    memset(block, 0, key.size);
+    memcpy(block + key.size - (sizeof(message) - 1), message, sizeof(message) - 1);
+    bn_from_hex(c, key.n.limbs, ciphertext);
+    bn_to_bytes(expected, key.size, c, key.n.limbs);
 
-    // Rewind the file to the beginning to overwrite it with the result.
-    rewind(fp);
-    fprintf(fp, "%lld", result); // Write the result as a long long integer.
-    fclose(fp);                  // Close the file.
+    // Encrypt, decrypt with the CRT, and decrypt with d over the full modulus
+    ok = rsa_public(&key, out, block) == 0 && memcmp(out, expected, key.size) == 0;
+    ok = ok && rsa_private(&key, out, expected) == 0 && memcmp(out, block, key.size) == 0;
+    mont_pow_secret(&key.n, m, c, key.d, key.n.limbs);
+    bn_to_bytes(out, key.size, m, key.n.limbs);
+    ok = ok && memcmp(out, block, key.size) == 0;
 
-    // Print a completion message indicating mode and the result.
-    printf("%s operation complete. Result: %lld\n", mode, result);
-    return 0; // Return a success status.
+    // Unwrap OpenSSL's OAEP block, and round-trip one of ours
+    bn_from_hex(c, key.n.limbs, oaep);
+    bn_to_bytes(expected, key.size, c, key.n.limbs);
+    ok = ok && rsa_oaep_decrypt(&key, out, &length, expected, (const uint8_t *)label, sizeof(label) - 1) == 0 &&
+         length == sizeof(message) - 1 && memcmp(out, message, length) == 0;
+    ok = ok && rsa_oaep_encrypt(&key, block, (const uint8_t *)message, sizeof(message) - 1,
+                                (const uint8_t *)label, sizeof(label) - 1) == 0 &&
+         rsa_oaep_decrypt(&key, out, &length, block, (const uint8_t *)label, sizeof(label) - 1) == 0 &&
+         length == sizeof(message) - 1 && memcmp(out, message, length) == 0;
+    rsa_key_wipe(&key);
+    return ok ? 0 : -1;
 }
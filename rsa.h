@@ -0,0 +1,97 @@
+#ifndef RSA_H
+#define RSA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sha256.h"
+
+// Numbers are arrays of limbs, least significant first. Products of two limbs need twice the
+// width, so 64-bit limbs are used where the compiler has a 128-bit type
+#if defined(__SIZEOF_INT128__)
+typedef uint64_t rsa_limb;
+typedef unsigned __int128 rsa_dlimb;
+#define RSA_LIMB_BITS 64
+#else
+typedef uint32_t rsa_limb;
+typedef uint64_t rsa_dlimb;
+#define RSA_LIMB_BITS 32
+#endif
+
+#define RSA_MIN_BITS 2048
+#define RSA_MAX_BITS 4096
+#define RSA_MAX_SIZE (RSA_MAX_BITS / 8) // Largest modulus in bytes
+#define RSA_LIMBS (RSA_MAX_BITS / RSA_LIMB_BITS)
+#define RSA_PUBLIC_EXPONENT 65537 // Used for new keys
+#define RSA_MR_ROUNDS 5           // Miller-Rabin rounds for each prime of a new key (FIPS 186-4 C.3)
+#define RSA_OAEP_OVERHEAD (2 * SHA256_DIGEST_SIZE + 2) // OAEP messages are at most key->size minus this
+
+// Montgomery arithmetic modulo an odd `m`: numbers are kept as a*R mod m, with R = 2^(limbs *
+// RSA_LIMB_BITS), so a modular product needs no division
+typedef struct
+{
+    size_t limbs;
+    rsa_limb m[RSA_LIMBS];
+    rsa_limb rr[RSA_LIMBS]; // R^2 mod m, to bring numbers into Montgomery form
+    rsa_limb m0inv;         // -m^-1 mod 2^RSA_LIMB_BITS
+} rsa_mont;
+
+// RSA key. The private half holds the primes and CRT exponents, so a private-key operation is two
+// exponentiations modulo the half-size primes instead of one modulo n
+typedef struct
+{
+    size_t bits; // Modulus size
+    size_t size; // Modulus size in bytes, the length of every input and output block
+    int has_private;
+    rsa_mont n;
+    rsa_limb e[RSA_LIMBS];
+    rsa_limb d[RSA_LIMBS]; // Kept for the key file; the CRT values below are what is used
+    rsa_mont p, q;
+    rsa_limb dp[RSA_LIMBS];   // d mod (p - 1)
+    rsa_limb dq[RSA_LIMBS];   // d mod (q - 1)
+    rsa_limb qinv[RSA_LIMBS]; // q^-1 mod p
+} rsa_key;
+
+// Function to generate a key of `bits` (RSA_MIN_BITS to RSA_MAX_BITS, even) with exponent 65537
+// from two random primes; returns 0 on success
+int rsa_generate(rsa_key *key, size_t bits);
+
+// Function to read a key file: "name hex" lines for n and e, and for a private key p, q, dp, dq
+// and qinv (d is optional). Lines starting with # are comments. Returns 0 when the key is valid
+int rsa_key_load(rsa_key *key, FILE *in);
+
+// Function to write a key in the format rsa_key_load reads, with or without the private half
+int rsa_key_save(const rsa_key *key, FILE *out, int include_private);
+
+// Function to compute in^e mod n. `in` and `out` are key->size bytes, big-endian, and `in` must be
+// less than n; they may be the same buffer. Returns 0 on success
+int rsa_public(const rsa_key *key, uint8_t *out, const uint8_t *in);
+
+// Function to compute in^d mod n with the CRT, in constant time. The result is checked with the
+// public exponent before it is written, so a fault cannot leak the primes. Returns 0 on success
+int rsa_private(const rsa_key *key, uint8_t *out, const uint8_t *in);
+
+// Function to encrypt a short message (at most key->size - RSA_OAEP_OVERHEAD bytes) with RSA-OAEP
+// (RFC 8017, SHA-256 and MGF1 with SHA-256) under a fresh random seed. `label` is bound to the
+// result without being stored in it. `out` receives key->size bytes. Returns 0 on success
+int rsa_oaep_encrypt(const rsa_key *key, uint8_t *out, const uint8_t *message, size_t length,
+                     const uint8_t *label, size_t label_length);
+
+// Function to decrypt an RSA-OAEP block of key->size bytes made with the same label. `out` needs
+// room for key->size bytes and *length receives the message length. The padding is checked in
+// constant time and every failure looks the same. Returns 0 on success
+int rsa_oaep_decrypt(const rsa_key *key, uint8_t *out, size_t *length, const uint8_t *in,
+                     const uint8_t *label, size_t label_length);
+
+// Function to fill `buffer` from the system's random number generator; returns 0 on success
+int rsa_random(void *buffer, size_t length);
+
+// Function to wipe a key
+void rsa_key_wipe(rsa_key *key);
+
+// Function to check the engine, RSA-OAEP and SHA-256 against known answers (the RSA ones made with
+// OpenSSL); returns 0 on success
+int rsa_self_test(void);
+
+#endif
@@ -0,0 +1,222 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "rsa.h"
+
+#define RSA_FILE_MAX (2 * RSA_MAX_SIZE + 64) // Largest number file: hex digits plus whitespace
+
+// Function to read a key file; returns 0 on success
+static int load_key(const char *path, rsa_key *key)
+{
+    FILE *in = fopen(path, "r");
+    if (!in)
+    {
+        perror(path);
+        return -1;
+    }
+    int result = rsa_key_load(key, in);
+    fclose(in);
+    if (result != 0)
+    {
+        fprintf(stderr, "%s: Not a valid RSA key of %d to %d bits\n", path, RSA_MIN_BITS, RSA_MAX_BITS);
+    }
+    return result;
+}
+
+// Function to write a key file, readable only by its owner when it holds the private key
+static int save_key(const char *path, const rsa_key *key, int include_private)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, include_private ? 0600 : 0644);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out)
+    {
+        perror(path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    int result = rsa_key_save(key, out, include_private);
+    if (fclose(out) != 0)
+    {
+        result = -1;
+    }
+    if (result != 0)
+    {
+        perror(path);
+    }
+    return result;
+}
+
+// Function to read the number in `path` as a big-endian block of `size` bytes: the file's bytes, or
+// with `hex` its hexadecimal digits. Returns 0 when it fits
+static int read_number(const char *path, int hex, uint8_t *block, size_t size)
+{
+    uint8_t data[RSA_FILE_MAX];
+    FILE *in = fopen(path, "rb");
+    size_t length, digits = 0;
+
+    if (!in)
+    {
+        perror(path);
+        return -1;
+    }
+    length = fread(data, 1, sizeof(data), in);
+    fclose(in);
+
+    memset(block, 0, size);
+    if (!hex)
+    {
+        if (length > size)
+        {
+            fprintf(stderr, "%s: Longer than the %zu-byte modulus\n", path, size);
+            return -1;
+        }
+        memcpy(block + size - length, data, length);
+        return 0;
+    }
+
+    // Hexadecimal: collect the digits, then fill the block from its last byte
+    for (size_t i = 0; i < length; i++)
+    {
+        if (isxdigit(data[i]))
+        {
+            data[digits++] = data[i];
+        }
+        else if (!isspace(data[i]))
+        {
+            fprintf(stderr, "%s: Not a hexadecimal number\n", path);
+            return -1;
+        }
+    }
+    if (digits == 0 || digits > 2 * size)
+    {
+        fprintf(stderr, "%s: Expected 1 to %zu hexadecimal digits\n", path, 2 * size);
+        return -1;
+    }
+    for (size_t k = 0; k < digits; k++)
+    {
+        char c = (char)tolower(data[digits - 1 - k]);
+        uint8_t v = (uint8_t)(c <= '9' ? c - '0' : c - 'a' + 10);
+        block[size - 1 - k / 2] |= (uint8_t)(v << (4 * (k % 2)));
+    }
+    return 0;
+}
+
+// Function to replace the contents of `path` with the block, as bytes or hexadecimal digits
+static int write_number(const char *path, int hex, const uint8_t *block, size_t size)
+{
+    FILE *out = fopen(path, "wb");
+    int result = 0;
+
+    if (!out)
+    {
+        perror(path);
+        return -1;
+    }
+    if (hex)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            fprintf(out, "%02x", block[i]);
+        }
+        fputc('\n', out);
+    }
+    else
+    {
+        fwrite(block, 1, size, out);
+    }
+    if (ferror(out) || fclose(out) != 0)
+    {
+        perror(path);
+        result = -1;
+    }
+    return result;
+}
+
+// Main function to handle command-line arguments: generate a key pair, or encrypt or decrypt the
+// number held in a file
+int main(int argc, char *argv[])
+{
+    uint8_t block[RSA_MAX_SIZE];
+    rsa_key key;
+    int hex = 0;
+    int argi = 1;
+
+    // Parse leading options
+    if (argi < argc && strcmp(argv[argi], "--self-test") == 0)
+    {
+        int ok = rsa_self_test() == 0;
+        printf("RSA self-test %s\n", ok ? "passed" : "FAILED");
+        return ok ? 0 : 1;
+    }
+    if (argi < argc && strcmp(argv[argi], "--genkey") == 0 && argc == 5)
+    {
+        int bits = atoi(argv[2]);
+        if (bits < RSA_MIN_BITS || bits > RSA_MAX_BITS || bits % 2 != 0)
+        {
+            fprintf(stderr, "Key size must be an even number of bits from %d to %d\n", RSA_MIN_BITS, RSA_MAX_BITS);
+            return 1;
+        }
+        if (rsa_generate(&key, bits) != 0)
+        {
+            fprintf(stderr, "Failed to generate the key\n");
+            return 1;
+        }
+        int failed = save_key(argv[3], &key, 1) != 0 || save_key(argv[4], &key, 0) != 0;
+        rsa_key_wipe(&key);
+        return failed;
+    }
+    if (argi < argc && strcmp(argv[argi], "--hex") == 0)
+    {
+        hex = 1;
+        argi++;
+    }
+
+    if (argc - argi != 3)
+    {
+        fprintf(stderr, "Usage: %s [--hex] <file> <key-file> <encrypt|decrypt>\n", argv[0]);
+        fprintf(stderr, "       %s --genkey <bits> <private-key-file> <public-key-file>\n", argv[0]);
+        fprintf(stderr, "       %s --self-test\n", argv[0]);
+        return 1;
+    }
+
+    const char *filepath = argv[argi];
+    const char *mode = argv[argi + 2];
+    if (strcmp(mode, "encrypt") != 0 && strcmp(mode, "decrypt") != 0)
+    {
+        fprintf(stderr, "Mode must be encrypt or decrypt\n");
+        return 1;
+    }
+    if (load_key(argv[argi + 1], &key) != 0)
+    {
+        return 1;
+    }
+    if (strcmp(mode, "decrypt") == 0 && !key.has_private)
+    {
+        fprintf(stderr, "%s: Decryption needs the private key\n", argv[argi + 1]);
+        rsa_key_wipe(&key);
+        return 1;
+    }
+
+    // Encrypt with the public exponent, or decrypt with the private key's primes (CRT)
+    int failed = read_number(filepath, hex, block, key.size) != 0;
+    if (!failed && (strcmp(mode, "encrypt") == 0 ? rsa_public(&key, block, block) : rsa_private(&key, block, block)) != 0)
+    {
+        fprintf(stderr, "%s: The number must be less than the modulus\n", filepath);
+        failed = 1;
+    }
+    if (!failed)
+    {
+        failed = write_number(filepath, hex, block, key.size) != 0;
+    }
+    rsa_key_wipe(&key);
+    secure_zero(block, sizeof(block));
+    return failed;
+}
@@ -0,0 +1,34 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+// Structure to hold the running SHA-256 state and a partial 64-byte block
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length; // Bytes absorbed so far
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    size_t leftover;
+} sha256_ctx;
+
+// Function to start a new hash
+void sha256_init(sha256_ctx *ctx);
+
+// Function to absorb `length` more bytes of the message
+void sha256_update(sha256_ctx *ctx, const uint8_t *message, size_t length);
+
+// Function to finish the hash and write the 32-byte digest; the state is wiped
+void sha256_final(sha256_ctx *ctx, uint8_t *digest);
+
+// Function to hash a whole message at once
+void sha256(const uint8_t *message, size_t length, uint8_t *digest);
+
+// Function to check the implementation against the FIPS 180-4 examples; 1 when it passes
+int sha256_self_test(void);
+
+#endif
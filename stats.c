@@ -0,0 +1,176 @@
+#include "stats.h"
+
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+// Count CPU cycles and instructions with perf events where the kernel provides them
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define STATS_HAVE_PERF 1
+#else
+#define STATS_HAVE_PERF 0
+#endif
+
+static const char *const stats_phase_names[STATS_PHASES] = {"read", "keysetup", "cipher", "write"};
+
+// Set by --stats; the totals below are added to with relaxed atomics from any thread
+static int stats_enabled = 0;
+static uint64_t stats_started;
+static uint64_t stats_ns[STATS_PHASES];
+static uint64_t stats_bytes[STATS_PHASES];
+static uint64_t stats_calls[STATS_PHASES];
+static int stats_perf_fd[2] = {-1, -1}; // Cycles and instructions
+
+// Function to read the monotonic clock in nanoseconds
+static uint64_t stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#if STATS_HAVE_PERF
+// Function to count a hardware event in user space for this process and the threads it starts
+// from now on; returns -1 when there is no PMU or perf_event_paranoid forbids it
+static int stats_perf_open(uint64_t config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// Function to reset the counters and start or stop collecting
+void stats_enable(int enable)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (stats_perf_fd[i] >= 0)
+        {
+            close(stats_perf_fd[i]);
+            stats_perf_fd[i] = -1;
+        }
+    }
+    memset(stats_ns, 0, sizeof(stats_ns));
+    memset(stats_bytes, 0, sizeof(stats_bytes));
+    memset(stats_calls, 0, sizeof(stats_calls));
+    stats_enabled = enable;
+    if (!enable)
+    {
+        return;
+    }
+#if STATS_HAVE_PERF
+    stats_perf_fd[0] = stats_perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    stats_perf_fd[1] = stats_perf_open(PERF_COUNT_HW_INSTRUCTIONS);
+#endif
+    stats_started = stats_now();
+}
+
+// Function to start timing a phase
+uint64_t stats_begin(void)
+{
+    return stats_enabled ? stats_now() : 0;
+}
+
+// Function to charge the time since `start` and `bytes` to `phase`
+void stats_end(stats_phase phase, uint64_t start, uint64_t bytes)
+{
+    if (!start)
+    {
+        return;
+    }
+    __atomic_fetch_add(&stats_ns[phase], stats_now() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_bytes[phase], bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+// Function to read the cycle and instruction counters; returns 0 when they are unavailable
+static int stats_perf_read(uint64_t *counts)
+{
+#if STATS_HAVE_PERF
+    for (int i = 0; i < 2; i++)
+    {
+        if (stats_perf_fd[i] < 0 || read(stats_perf_fd[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+#else
+    (void)counts;
+    return 0;
+#endif
+}
+
+// Function to print the totals as text or as one JSON object
+void stats_print(FILE *out, int json)
+{
+    unsigned long long bytes = stats_bytes[STATS_CIPHER];
+    uint64_t counts[2] = {0, 0};
+    struct rusage usage;
+    double wall;
+    int have_perf, i;
+
+    if (!stats_enabled)
+    {
+        return;
+    }
+    wall = (double)(stats_now() - stats_started) / 1e9;
+    have_perf = stats_perf_read(counts);
+    getrusage(RUSAGE_SELF, &usage);
+
+    if (json)
+    {
+        fprintf(out, "{\"wall_s\":%.6f,\"bytes\":%llu,\"mb_per_s\":%.1f", wall, bytes,
+                wall > 0 ? bytes / wall / 1e6 : 0.0);
+        for (i = 0; i < STATS_PHASES; i++)
+        {
+            fprintf(out, ",\"%s\":{\"s\":%.6f,\"bytes\":%llu,\"calls\":%llu}", stats_phase_names[i],
+                    stats_ns[i] / 1e9, (unsigned long long)stats_bytes[i], (unsigned long long)stats_calls[i]);
+        }
+        fprintf(out, ",\"peak_rss_kib\":%ld", usage.ru_maxrss);
+        if (have_perf)
+        {
+            fprintf(out, ",\"cycles\":%llu,\"instructions\":%llu,\"cycles_per_byte\":%.3f,\"instructions_per_byte\":%.3f",
+                    (unsigned long long)counts[0], (unsigned long long)counts[1],
+                    bytes ? (double)counts[0] / bytes : 0.0, bytes ? (double)counts[1] / bytes : 0.0);
+        }
+        else
+        {
+            fprintf(out, ",\"cycles\":null,\"instructions\":null,\"cycles_per_byte\":null,\"instructions_per_byte\":null");
+        }
+        fprintf(out, "}\n");
+        return;
+    }
+
+    fprintf(out, "%-10s %10s %8s %14s %8s %10s\n", "phase", "seconds", "of wall", "bytes", "calls", "MB/s");
+    for (i = 0; i < STATS_PHASES; i++)
+    {
+        double seconds = stats_ns[i] / 1e9;
+        fprintf(out, "%-10s %10.4f %7.1f%% %14llu %8llu %10.1f\n", stats_phase_names[i], seconds,
+                wall > 0 ? 100 * seconds / wall : 0.0, (unsigned long long)stats_bytes[i],
+                (unsigned long long)stats_calls[i], seconds > 0 ? stats_bytes[i] / seconds / 1e6 : 0.0);
+    }
+    fprintf(out, "Processed %llu bytes in %.4f s (%.1f MB/s), peak RSS %ld KiB\n", bytes, wall,
+            wall > 0 ? bytes / wall / 1e6 : 0.0, usage.ru_maxrss);
+    if (have_perf)
+    {
+        fprintf(out, "%llu cycles, %llu instructions (%.2f cycles/byte, %.2f instructions/byte, user space)\n",
+                (unsigned long long)counts[0], (unsigned long long)counts[1],
+                bytes ? (double)counts[0] / bytes : 0.0, bytes ? (double)counts[1] / bytes : 0.0);
+    }
+    else
+    {
+        fprintf(out, "Cycle and instruction counts unavailable (perf events not permitted on this host)\n");
+    }
+}
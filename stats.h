@@ -0,0 +1,34 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Run statistics for --stats. Each phase collects the time spent in it and the bytes it handled,
+// summed over every file in flight. The pipeline overlaps reading, the cipher and writing, so the
+// phase closest to the wall time is the one that bounds the run. While collection is off the
+// hooks only test a flag and never read the clock
+typedef enum
+{
+    STATS_READ,     // Reading the input file
+    STATS_KEYSETUP, // Key expansion, once per job or context
+    STATS_CIPHER,   // The cipher kernels, including the split across the worker pool
+    STATS_WRITE,    // Writing the output and syncing it to disk
+    STATS_PHASES
+} stats_phase;
+
+// Function to reset the counters and start (1) or stop (0) collecting. Process-wide: call it
+// before jobs are created so the CPU counters also cover their worker threads
+void stats_enable(int enable);
+
+// Function to start timing a phase; returns 0 when collection is off
+uint64_t stats_begin(void);
+
+// Function to charge the time since `start` and `bytes` to `phase`; does nothing for a 0 start
+void stats_end(stats_phase phase, uint64_t start, uint64_t bytes);
+
+// Function to print the totals as text, or as one JSON object when `json` is set. Threads that
+// are still running are not yet included in the CPU counters, so call it after the work is joined
+void stats_print(FILE *out, int json);
+
+#endif
@@ -0,0 +1,975 @@
+#define _GNU_SOURCE // F_SETPIPE_SZ, O_DIRECT and MAP_HUGETLB
+
+#include "stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+// Buffer of an arena, allocated once and lent to one file at a time
+typedef struct stream_arena_buffer
+{
+    struct stream_arena_buffer *next;
+    uint8_t *data;
+    size_t size;
+    int in_use;
+} stream_arena_buffer;
+
+struct stream_arena
+{
+    pthread_mutex_t lock;
+    stream_arena_buffer *buffers;
+    int huge_pages;
+};
+
+// Per-thread settings: the progress callback of the file being processed, and the descriptors
+// STREAM_STDIO stands for
+static __thread stream_progress_hook progress_hook = {NULL, NULL};
+static __thread int stdio_in = STDIN_FILENO, stdio_out = STDOUT_FILENO;
+
+// Function to report a failed system call on `filename`, like perror but naming the file
+static void stream_perror(const char *filename, const char *what)
+{
+    fprintf(stderr, "%s: %s: %s\n", filename, what, strerror(errno));
+}
+
+// Function to parse a size such as 65536, 64K, 1M or 2G; returns 0 when it is not valid
+size_t stream_parse_size(const char *text)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (end == text)
+    {
+        return 0;
+    }
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        value <<= 10;
+        // fall through
+    case 'M':
+    case 'm':
+        value <<= 10;
+        // fall through
+    case 'K':
+    case 'k':
+        value <<= 10;
+        end++;
+        break;
+    }
+    return *end == '\0' ? (size_t)value : 0;
+}
+
+// Function to install a progress callback for streams run on the calling thread
+stream_progress_hook stream_set_progress(stream_progress_hook hook)
+{
+    stream_progress_hook previous = progress_hook;
+    progress_hook = hook;
+    return previous;
+}
+
+// Function to report `bytes` more input bytes transformed to the calling thread's callback
+int stream_progress(uint64_t bytes)
+{
+    return progress_hook.fn && progress_hook.fn(progress_hook.arg, bytes) != 0 ? -1 : 0;
+}
+
+// Function to choose the descriptors STREAM_STDIO stands for on the calling thread
+void stream_set_stdio(int in_fd, int out_fd)
+{
+    stdio_in = in_fd < 0 ? STDIN_FILENO : in_fd;
+    stdio_out = out_fd < 0 ? STDOUT_FILENO : out_fd;
+}
+
+// Function to return the descriptor STREAM_STDIO reads from on the calling thread
+int stream_stdio_input(void)
+{
+    return stdio_in;
+}
+
+stream_arena *stream_arena_create(int huge_pages)
+{
+    stream_arena *arena = calloc(1, sizeof(stream_arena));
+    if (arena)
+    {
+        pthread_mutex_init(&arena->lock, NULL);
+        arena->huge_pages = huge_pages;
+    }
+    return arena;
+}
+
+void stream_arena_free(stream_arena *arena)
+{
+    if (arena)
+    {
+        while (arena->buffers)
+        {
+            stream_arena_buffer *buffer = arena->buffers;
+            arena->buffers = buffer->next;
+            munmap(buffer->data, buffer->size);
+            free(buffer);
+        }
+        pthread_mutex_destroy(&arena->lock);
+        free(arena);
+    }
+}
+
+// Function to map `size` bytes for an arena: page-aligned, or with huge pages 2 MiB pages from the
+// reserved pool, falling back to a 2 MiB-aligned mapping that transparent huge pages can back
+static uint8_t *stream_arena_map(size_t size, int huge_pages)
+{
+    uint8_t *data;
+
+    if (!huge_pages)
+    {
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return data == MAP_FAILED ? NULL : data;
+    }
+#ifdef MAP_HUGETLB
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED)
+    {
+        return data;
+    }
+#endif
+
+    // Map one huge page more than needed and trim both ends to a 2 MiB boundary
+    data = mmap(NULL, size + STREAM_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    size_t head = (STREAM_HUGE_PAGE - (uintptr_t)data % STREAM_HUGE_PAGE) % STREAM_HUGE_PAGE;
+    if (head)
+    {
+        munmap(data, head);
+    }
+    munmap(data + head + size, STREAM_HUGE_PAGE - head);
+    data += head;
+#ifdef MADV_HUGEPAGE
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+    return data;
+}
+
+// Function to borrow a buffer of at least `size` bytes: the smallest idle one that fits, or a new
+// one when none does. Buffers go back to the arena, not to the system, so a run allocates only
+// until it is warm
+static uint8_t *stream_arena_take(stream_arena *arena, size_t size)
+{
+    stream_arena_buffer *best = NULL;
+    size_t unit = arena->huge_pages ? STREAM_HUGE_PAGE : STREAM_DIRECT_ALIGN;
+
+    size = (size + unit - 1) / unit * unit;
+    pthread_mutex_lock(&arena->lock);
+    for (stream_arena_buffer *buffer = arena->buffers; buffer; buffer = buffer->next)
+    {
+        if (!buffer->in_use && buffer->size >= size && (!best || buffer->size < best->size))
+        {
+            best = buffer;
+        }
+    }
+    if (!best)
+    {
+        best = malloc(sizeof(stream_arena_buffer));
+        if (best && (best->data = stream_arena_map(size, arena->huge_pages)) == NULL)
+        {
+            free(best);
+            best = NULL;
+        }
+        if (best)
+        {
+            best->size = size;
+            best->next = arena->buffers;
+            arena->buffers = best;
+        }
+    }
+    if (best)
+    {
+        best->in_use = 1;
+    }
+    pthread_mutex_unlock(&arena->lock);
+    return best ? best->data : NULL;
+}
+
+// Function to give a buffer back to its arena
+static void stream_arena_give(stream_arena *arena, uint8_t *data)
+{
+    pthread_mutex_lock(&arena->lock);
+    for (stream_arena_buffer *buffer = arena->buffers; buffer; buffer = buffer->next)
+    {
+        if (buffer->data == data)
+        {
+            buffer->in_use = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// Function to round a requested buffer size to one the stream engine accepts
+size_t stream_buffer_size(size_t requested)
+{
+    if (requested == 0)
+    {
+        requested = STREAM_DEFAULT_BUFFER;
+    }
+    return (requested + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+}
+
+// Function to read exactly `length` bytes at `offset` (or, when it is -1, the current position)
+// unless the file ends first. A pipe returns whatever is in it, so keep reading until it is full;
+// a read or write interrupted by a signal is retried
+ssize_t stream_read_full(int fd, uint8_t *buffer, size_t length, off_t offset)
+{
+    uint64_t start = stats_begin();
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t n = offset < 0 ? read(fd, buffer + done, length - done)
+                               : pread(fd, buffer + done, length - done, offset + done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        done += n;
+    }
+    stats_end(STATS_READ, start, done);
+    return done;
+}
+
+// Function to write exactly `length` bytes at `offset` (or, when it is -1, the current position)
+int stream_write_full(int fd, const uint8_t *buffer, size_t length, off_t offset)
+{
+    uint64_t start = stats_begin();
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t n = offset < 0 ? write(fd, buffer + done, length - done)
+                               : pwrite(fd, buffer + done, length - done, offset + done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        done += n;
+    }
+    stats_end(STATS_WRITE, start, done);
+    return 0;
+}
+
+// Slot states in the ring shared by the reader, cipher and writer stages
+enum
+{
+    SLOT_FREE,   // Ready for the reader
+    SLOT_READ,   // Filled, waiting for the transform
+    SLOT_CIPHER, // Transformed, waiting for the writer
+};
+
+// One buffer in the ring
+typedef struct
+{
+    uint8_t *data;
+    size_t length; // Bytes read, then bytes to write after the transform
+    int final;
+    int state;
+} stream_slot;
+
+// State shared by the pipeline stages
+typedef struct
+{
+    stream_slot slots[STREAM_RING_DEPTH];
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    const char *filename;
+    size_t buffer_size;
+    int in_fd, out_fd;
+    off_t in_size;
+    off_t in_offset, out_offset; // Where the data starts: past a header skipped or written by the caller
+    int sequential; // Standard input to standard output: no offsets, and the length is not known
+    int failed;
+    stream_arena *arena; // Direct I/O: buffers come from here
+    int in_direct, out_direct; // O_DIRECT is set on the descriptor (-1: the file system refused it)
+} stream_pipeline;
+
+// Function to tell whether a transfer can bypass the page cache: direct I/O needs its file
+// offset, length and memory address all on a STREAM_DIRECT_ALIGN boundary
+static int stream_aligned(off_t offset, size_t length, const uint8_t *buffer)
+{
+    return ((uint64_t)offset | length | (uintptr_t)buffer) % STREAM_DIRECT_ALIGN == 0;
+}
+
+// Function to turn O_DIRECT on or off for a descriptor, tracking its state in `*direct`. A file
+// system that refuses it leaves the descriptor on the page cache for the rest of the file
+static void stream_set_direct(int fd, int *direct, int on)
+{
+    if (*direct < 0 || *direct == on)
+    {
+        return;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT) < 0)
+    {
+        *direct = -1;
+        return;
+    }
+    *direct = on;
+}
+
+// Function to read for the pipeline: with an arena, aligned reads bypass the page cache. A direct
+// read that stops short on an unaligned length has reached the end of the file
+static ssize_t pipeline_read(stream_pipeline *p, uint8_t *buffer, size_t length, off_t offset)
+{
+    if (!p->arena || p->sequential)
+    {
+        return stream_read_full(p->in_fd, buffer, length, p->sequential ? -1 : offset);
+    }
+    stream_set_direct(p->in_fd, &p->in_direct, stream_aligned(offset, length, buffer));
+    if (p->in_direct != 1)
+    {
+        return stream_read_full(p->in_fd, buffer, length, offset);
+    }
+
+    uint64_t start = stats_begin();
+    size_t done = 0;
+    while (done < length && done % STREAM_DIRECT_ALIGN == 0)
+    {
+        ssize_t n = pread(p->in_fd, buffer + done, length - done, offset + done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        done += n;
+    }
+    stats_end(STATS_READ, start, done);
+    return done;
+}
+
+// Function to write for the pipeline: with an arena, the aligned part of a write bypasses the page
+// cache and an unaligned tail (the end of the file, or data shifted by a header) goes through it
+static int pipeline_write(stream_pipeline *p, const uint8_t *buffer, size_t length, off_t offset)
+{
+    size_t bulk = 0;
+
+    if (!p->arena || p->sequential)
+    {
+        return stream_write_full(p->out_fd, buffer, length, p->sequential ? -1 : offset);
+    }
+    if (stream_aligned(offset, 0, buffer))
+    {
+        bulk = length / STREAM_DIRECT_ALIGN * STREAM_DIRECT_ALIGN;
+    }
+    if (bulk)
+    {
+        stream_set_direct(p->out_fd, &p->out_direct, 1);
+        if (stream_write_full(p->out_fd, buffer, bulk, offset) < 0)
+        {
+            return -1;
+        }
+    }
+    if (bulk < length)
+    {
+        stream_set_direct(p->out_fd, &p->out_direct, 0);
+        return stream_write_full(p->out_fd, buffer + bulk, length - bulk, offset + bulk);
+    }
+    return 0;
+}
+
+// Function to wait until slot `index` reaches `state`; returns 0 if the pipeline failed meanwhile
+static int slot_wait(stream_pipeline *p, int index, int state)
+{
+    pthread_mutex_lock(&p->lock);
+    while (p->slots[index].state != state && !p->failed)
+    {
+        pthread_cond_wait(&p->changed, &p->lock);
+    }
+    int ok = !p->failed;
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+// Function to hand slot `index` to the next stage
+static void slot_publish(stream_pipeline *p, int index, int state)
+{
+    pthread_mutex_lock(&p->lock);
+    p->slots[index].state = state;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Function to stop every stage after an error
+static void pipeline_fail(stream_pipeline *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Reader stage: fill free slots from the input file in order. Reading a pipe, the end is only seen
+// after a full buffer has been read, so the last STREAM_HOLD bytes of each full buffer are held back
+// and start the next one: the final buffer then holds at least the last block or AEAD tag
+static void *reader_stage(void *arg)
+{
+    stream_pipeline *p = (stream_pipeline *)arg;
+    uint8_t tail[STREAM_HOLD];
+    size_t held = 0;
+    off_t offset = p->in_offset;
+    int final = 0;
+
+    for (int i = 0; !final; i = (i + 1) % STREAM_RING_DEPTH)
+    {
+        if (!slot_wait(p, i, SLOT_FREE))
+        {
+            break;
+        }
+        stream_slot *slot = &p->slots[i];
+        memcpy(slot->data, tail, held);
+        ssize_t n = pipeline_read(p, slot->data + held, p->buffer_size - held, offset);
+        if (n < 0)
+        {
+            stream_perror(p->filename, "Failed to read file");
+            pipeline_fail(p);
+            break;
+        }
+        if (p->sequential)
+        {
+            n += held;
+            final = (size_t)n < p->buffer_size;
+            held = final ? 0 : STREAM_HOLD;
+            n -= held;
+            memcpy(tail, slot->data + n, held);
+        }
+        else
+        {
+            offset += n;
+            final = (size_t)n < p->buffer_size || offset >= p->in_size;
+        }
+        slot->length = n;
+        slot->final = final;
+        slot_publish(p, i, SLOT_READ);
+    }
+    return NULL;
+}
+
+// Writer stage: drain transformed slots to the output file in order
+static void *writer_stage(void *arg)
+{
+    stream_pipeline *p = (stream_pipeline *)arg;
+    off_t offset = p->out_offset;
+    int final = 0;
+
+    for (int i = 0; !final; i = (i + 1) % STREAM_RING_DEPTH)
+    {
+        if (!slot_wait(p, i, SLOT_CIPHER))
+        {
+            break;
+        }
+        stream_slot *slot = &p->slots[i];
+        if (pipeline_write(p, slot->data, slot->length, offset) < 0)
+        {
+            stream_perror(p->filename, "Failed to write file");
+            pipeline_fail(p);
+            break;
+        }
+        offset += slot->length;
+        final = slot->final;
+        slot_publish(p, i, SLOT_FREE);
+    }
+    return NULL;
+}
+
+// Function to tell whether `filename` names standard input and output rather than a file
+int stream_is_stdio(const char *filename)
+{
+    return strcmp(filename, STREAM_STDIO) == 0;
+}
+
+// Function to flush a directory entry change (the rename) to disk
+static void sync_parent_dir(const char *filename)
+{
+    char *dir = strdup(filename);
+    char *slash = dir ? strrchr(dir, '/') : NULL;
+    int fd;
+
+    if (!dir)
+    {
+        return;
+    }
+    if (slash)
+    {
+        *(slash == dir ? slash + 1 : slash) = '\0';
+        fd = open(dir, O_RDONLY);
+    }
+    else
+    {
+        fd = open(".", O_RDONLY);
+    }
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+// Function to create the temporary file a rewrite of `filename` goes to, in the same directory so
+// the final rename is atomic, with the permission bits of `mode`. Returns the descriptor and sets
+// *tmpname (to pass to stream_commit_temp), or -1 with the reason already reported
+int stream_create_temp(const char *filename, mode_t mode, char **tmpname)
+{
+    size_t name_length = strlen(filename) + sizeof(".tmp.XXXXXX");
+    int fd;
+
+    *tmpname = malloc(name_length);
+    if (!*tmpname)
+    {
+        stream_perror(filename, "Failed to allocate file name");
+        return -1;
+    }
+    snprintf(*tmpname, name_length, "%s.tmp.XXXXXX", filename);
+    fd = mkstemp(*tmpname);
+    if (fd < 0)
+    {
+        stream_perror(filename, "Failed to create temporary file");
+        free(*tmpname);
+        return -1;
+    }
+    fchmod(fd, mode & 07777);
+    return fd;
+}
+
+// Function to finish a rewrite: when `result` is 0 the temporary file is synced and renamed over
+// `filename`, otherwise (or if that fails) it is removed. Closes `fd`, frees `tmpname` and returns
+// the final result
+int stream_commit_temp(const char *filename, int fd, char *tmpname, int result)
+{
+    // Make the new contents durable before they replace the original
+    uint64_t start = stats_begin();
+    if (result == 0 && fsync(fd) < 0)
+    {
+        stream_perror(filename, "Failed to sync file");
+        result = -1;
+    }
+    stats_end(STATS_WRITE, start, 0);
+    if (close(fd) < 0 && result == 0)
+    {
+        stream_perror(filename, "Failed to close file");
+        result = -1;
+    }
+    if (result == 0 && rename(tmpname, filename) < 0)
+    {
+        stream_perror(filename, "Failed to replace file");
+        result = -1;
+    }
+    if (result == 0)
+    {
+        sync_parent_dir(filename);
+    }
+    else
+    {
+        unlink(tmpname);
+    }
+    free(tmpname);
+    return result;
+}
+
+// Function to run the reader, cipher and writer stages over the ring until the final buffer
+static int stream_run_stages(stream_pipeline *p, stream_transform transform, void *arg)
+{
+    pthread_t reader, writer;
+    int i, final = 0;
+
+    for (i = 0; i < STREAM_RING_DEPTH; i++)
+    {
+        p->slots[i].data = p->arena ? stream_arena_take(p->arena, p->buffer_size + STREAM_SLACK)
+                                    : malloc(p->buffer_size + STREAM_SLACK);
+        if (!p->slots[i].data)
+        {
+            stream_perror(p->filename, "Failed to allocate buffer");
+            return -1;
+        }
+    }
+
+    if (pthread_create(&reader, NULL, reader_stage, p) != 0)
+    {
+        stream_perror(p->filename, "Failed to start reader thread");
+        return -1;
+    }
+    if (pthread_create(&writer, NULL, writer_stage, p) != 0)
+    {
+        stream_perror(p->filename, "Failed to start writer thread");
+        pipeline_fail(p);
+        pthread_join(reader, NULL);
+        return -1;
+    }
+
+    // Cipher stage: transform slots in order on the calling thread
+    for (i = 0; !final; i = (i + 1) % STREAM_RING_DEPTH)
+    {
+        if (!slot_wait(p, i, SLOT_READ))
+        {
+            break;
+        }
+        stream_slot *slot = &p->slots[i];
+        uint64_t start = stats_begin();
+        size_t out = transform(arg, slot->data, slot->length, slot->final);
+        stats_end(STATS_CIPHER, start, slot->length);
+
+        // Only the final buffer may grow; earlier ones may hold bytes back (e.g. a trailing tag)
+        if (out == STREAM_ERROR || (!slot->final && out > slot->length))
+        {
+            pipeline_fail(p);
+            break;
+        }
+        if (stream_progress(slot->length) != 0)
+        {
+            fprintf(stderr, "%s: Cancelled\n", p->filename);
+            pipeline_fail(p);
+            break;
+        }
+        slot->length = out;
+        final = slot->final;
+        slot_publish(p, i, SLOT_CIPHER);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    return p->failed ? -1 : 0;
+}
+
+// Function to set up the ring, run the pipeline over it and free it again
+static int stream_pipelined(stream_pipeline *p, stream_transform transform, void *arg)
+{
+    int result, i;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->changed, NULL);
+    result = stream_run_stages(p, transform, arg);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->changed);
+    for (i = 0; i < STREAM_RING_DEPTH; i++)
+    {
+        if (!p->arena)
+        {
+            free(p->slots[i].data);
+        }
+        else if (p->slots[i].data)
+        {
+            stream_arena_give(p->arena, p->slots[i].data);
+        }
+    }
+    return result;
+}
+
+// Function to transform a file that fits in one buffer on the calling thread; starting the
+// pipeline threads would cost more than the I/O they overlap
+static int stream_direct(stream_pipeline *p, stream_transform transform, void *arg)
+{
+    size_t size = p->in_size - p->in_offset;
+    uint8_t *buffer;
+    int result = 0;
+
+    // Direct reads are whole blocks, so an arena buffer is read in up to a block past the end
+    if (p->arena)
+    {
+        size = (size + STREAM_DIRECT_ALIGN - 1) / STREAM_DIRECT_ALIGN * STREAM_DIRECT_ALIGN;
+        buffer = stream_arena_take(p->arena, size + STREAM_SLACK);
+    }
+    else
+    {
+        buffer = malloc(size + STREAM_SLACK);
+    }
+    if (!buffer)
+    {
+        stream_perror(p->filename, "Failed to allocate buffer");
+        return -1;
+    }
+    ssize_t n = pipeline_read(p, buffer, size, p->in_offset);
+    if (n < 0)
+    {
+        stream_perror(p->filename, "Failed to read file");
+        result = -1;
+    }
+    else
+    {
+        uint64_t start = stats_begin();
+        size_t out = transform(arg, buffer, n, 1);
+        stats_end(STATS_CIPHER, start, n);
+        if (out == STREAM_ERROR)
+        {
+            result = -1;
+        }
+        else if (stream_progress(n) != 0)
+        {
+            fprintf(stderr, "%s: Cancelled\n", p->filename);
+            result = -1;
+        }
+        else if (pipeline_write(p, buffer, out, p->out_offset) < 0)
+        {
+            stream_perror(p->filename, "Failed to write file");
+            result = -1;
+        }
+    }
+    if (p->arena)
+    {
+        stream_arena_give(p->arena, buffer);
+    }
+    else
+    {
+        free(buffer);
+    }
+    return result;
+}
+
+// Function to let a pipe hold a whole buffer, so the reader and writer each move a buffer with one
+// system call and wake-up rather than one per 64 KiB. Unprivileged processes are limited to
+// /proc/sys/fs/pipe-max-size, so smaller sizes are tried down to the default
+static void stream_grow_pipe(int fd, size_t size)
+{
+#ifdef F_SETPIPE_SZ
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || !S_ISFIFO(st.st_mode))
+    {
+        return;
+    }
+    for (size = size < (1 << 30) ? size : (1 << 30); size > (64 << 10); size /= 2)
+    {
+        if (fcntl(fd, F_SETPIPE_SZ, (int)size) >= 0)
+        {
+            return;
+        }
+    }
+#else
+    (void)fd;
+    (void)size;
+#endif
+}
+
+// Function to stream standard input to standard output through the same pipeline as a file.
+// Nothing is staged on disk and memory use is the ring alone, so it can sit between other
+// commands. The data still passes through the ring: it is transformed in place there, and pages
+// handed to the next command with vmsplice could be overwritten by the following buffer
+static int stream_stdio(size_t buffer_size, const uint8_t *header, size_t header_length,
+                        stream_transform transform, void *arg)
+{
+    stream_pipeline p;
+
+    memset(&p, 0, sizeof(p));
+    p.filename = "-";
+    p.buffer_size = stream_buffer_size(buffer_size);
+    if (p.buffer_size < 2 * STREAM_HOLD)
+    {
+        p.buffer_size = 2 * STREAM_HOLD;
+    }
+    p.in_fd = stdio_in;
+    p.out_fd = stdio_out;
+    p.sequential = 1;
+    stream_grow_pipe(p.in_fd, p.buffer_size);
+    stream_grow_pipe(p.out_fd, p.buffer_size);
+    if (header_length > 0 && stream_write_full(p.out_fd, header, header_length, -1) < 0)
+    {
+        stream_perror(p.filename, "Failed to write file");
+        return -1;
+    }
+    return stream_pipelined(&p, transform, arg);
+}
+
+// Function to rewrite a file through `transform`, one fixed-size buffer at a time. A reader
+// thread, the calling thread (running the transform) and a writer thread pass buffers through
+// a ring of STREAM_RING_DEPTH slots, so I/O overlaps the cipher. Output goes to a temporary file
+// next to the original, which is fsync'd and renamed over it only when everything succeeded
+int stream_file(const char *filename, size_t buffer_size, stream_arena *arena, stream_transform transform, void *arg)
+{
+    return stream_file_framed(filename, buffer_size, arena, NULL, 0, 0, transform, arg);
+}
+
+// Function to rewrite a file as stream_file does, writing `header` ahead of the transformed data
+// and starting to read the input at `skip`
+int stream_file_framed(const char *filename, size_t buffer_size, stream_arena *arena, const uint8_t *header,
+                       size_t header_length, off_t skip, stream_transform transform, void *arg)
+{
+    stream_pipeline p;
+    struct stat st;
+    int result;
+
+    if (stream_is_stdio(filename))
+    {
+        return stream_stdio(buffer_size, header, header_length, transform, arg);
+    }
+    memset(&p, 0, sizeof(p));
+    p.filename = filename;
+    p.buffer_size = stream_buffer_size(buffer_size);
+    if (arena)
+    {
+        p.arena = arena;
+        p.buffer_size = (p.buffer_size + STREAM_DIRECT_ALIGN - 1) / STREAM_DIRECT_ALIGN * STREAM_DIRECT_ALIGN;
+    }
+    p.in_fd = open(filename, O_RDONLY);
+    if (p.in_fd < 0)
+    {
+        stream_perror(filename, "Failed to open file");
+        return -1;
+    }
+    if (fstat(p.in_fd, &st) < 0)
+    {
+        stream_perror(filename, "Failed to stat file");
+        close(p.in_fd);
+        return -1;
+    }
+    p.in_size = st.st_size;
+    if (p.in_size < skip)
+    {
+        fprintf(stderr, "%s: File is too short to hold its header\n", filename);
+        close(p.in_fd);
+        return -1;
+    }
+    p.in_offset = skip;
+    p.out_offset = header_length;
+
+    char *tmpname;
+    p.out_fd = stream_create_temp(filename, st.st_mode, &tmpname);
+    if (p.out_fd < 0)
+    {
+        close(p.in_fd);
+        return -1;
+    }
+
+    if (header_length > 0 && stream_write_full(p.out_fd, header, header_length, 0) < 0)
+    {
+        stream_perror(filename, "Failed to write file");
+        result = -1;
+    }
+    else if ((size_t)(p.in_size - p.in_offset) < p.buffer_size)
+    {
+        result = stream_direct(&p, transform, arg);
+    }
+    else
+    {
+        result = stream_pipelined(&p, transform, arg);
+    }
+
+    // Drop what did go through the page cache (headers and unaligned tails) once it is on disk, so
+    // direct I/O leaves the cache as it found it
+    if (arena)
+    {
+        posix_fadvise(p.in_fd, 0, 0, POSIX_FADV_DONTNEED);
+        if (result == 0 && fdatasync(p.out_fd) == 0)
+        {
+            posix_fadvise(p.out_fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+    close(p.in_fd);
+    return stream_commit_temp(filename, p.out_fd, tmpname, result);
+}
+
+// Function to transform a file in place through a read-write memory mapping, `stride` bytes per
+// call. Only length-preserving transforms are allowed. There are no heap buffers or copies, but
+// the update is not atomic: a crash part-way leaves the file partly transformed
+int stream_map_file(const char *filename, size_t stride, stream_transform transform, void *arg)
+{
+    struct stat st;
+    int result = 0;
+    if (stream_is_stdio(filename))
+    {
+        return stream_file(filename, stride, NULL, transform, arg);
+    }
+    int fd = open(filename, O_RDWR);
+    if (fd < 0)
+    {
+        stream_perror(filename, "Failed to open file");
+        return -1;
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        stream_perror(filename, "Failed to stat file");
+        close(fd);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    if (size == 0)
+    {
+        // Nothing to map; still give the transform its final call
+        result = transform(arg, NULL, 0, 1) == STREAM_ERROR ? -1 : 0;
+        close(fd);
+        return result;
+    }
+
+    uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        stream_perror(filename, "Failed to map file");
+        close(fd);
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    stride = stride ? stream_buffer_size(stride) : STREAM_MAP_STRIDE;
+    for (size_t offset = 0; offset < size; offset += stride)
+    {
+        size_t length = size - offset < stride ? size - offset : stride;
+        int final = offset + length == size;
+
+        // Start faulting in the next stride while this one is transformed
+        if (!final)
+        {
+            size_t next = size - offset - length < stride ? size - offset - length : stride;
+            madvise(map + offset + length, next, MADV_WILLNEED);
+        }
+        // Page faults on the mapping are charged to the cipher: there is no separate read
+        uint64_t start = stats_begin();
+        size_t out = transform(arg, map + offset, length, final);
+        stats_end(STATS_CIPHER, start, length);
+        if (out != length)
+        {
+            result = -1;
+            break;
+        }
+        if (stream_progress(length) != 0)
+        {
+            fprintf(stderr, "%s: Cancelled; the file is left partly transformed\n", filename);
+            result = -1;
+            break;
+        }
+    }
+
+    if (msync(map, size, MS_SYNC) < 0 && result == 0)
+    {
+        stream_perror(filename, "Failed to sync file");
+        result = -1;
+    }
+    munmap(map, size);
+    close(fd);
+    return result;
+}
@@ -0,0 +1,107 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define STREAM_DEFAULT_BUFFER (1 << 20) // Default buffer size for streaming a file (1 MiB)
+#define STREAM_ALIGN 64                 // Buffer sizes are rounded up to a multiple of this
+#define STREAM_SLACK 64                 // Extra room after each buffer for padding on the final call
+#define STREAM_ERROR ((size_t)-1)       // Returned by a transform to abort the stream
+#define STREAM_RING_DEPTH 4             // Buffers in flight between the reader, cipher and writer
+#define STREAM_MAP_STRIDE (16 << 20)    // Default bytes per transform call for a mapped file
+#define STREAM_HOLD 64                  // Streaming a pipe, the final call gets at least this many bytes
+#define STREAM_STDIO "-"                // File name that streams standard input to standard output
+#define STREAM_DIRECT_ALIGN 4096        // Direct I/O transfers start, end and sit in memory on this boundary
+#define STREAM_HUGE_PAGE (2 << 20)      // Arena buffers backed by huge pages are a multiple of this
+
+// Transform applied to each buffer in place. `final` is set on the last call (which may have
+// length 0); the return value is the number of bytes to write, or STREAM_ERROR. Earlier calls may
+// write fewer than `length` bytes; only the final call may write more, using up to STREAM_SLACK
+// bytes past it
+typedef size_t (*stream_transform)(void *arg, uint8_t *buffer, size_t length, int final);
+
+// Callback told that `bytes` more input bytes have been transformed; a non-zero return cancels the
+// stream, which then fails as on an error (a rewritten file is left unchanged)
+typedef int (*stream_progress_fn)(void *arg, uint64_t bytes);
+
+typedef struct
+{
+    stream_progress_fn fn; // NULL for none
+    void *arg;
+} stream_progress_hook;
+
+// Function to install a progress callback for streams run on the calling thread; returns the one it
+// replaces, to be put back afterwards (a thread waiting on the pool may run other files meanwhile)
+stream_progress_hook stream_set_progress(stream_progress_hook hook);
+
+// Function to report `bytes` of progress to the calling thread's callback; returns -1 to cancel
+int stream_progress(uint64_t bytes);
+
+// Function to make STREAM_STDIO read `in_fd` and write `out_fd` on the calling thread, e.g.
+// descriptors passed over a socket; -1 restores standard input or output
+void stream_set_stdio(int in_fd, int out_fd);
+
+// Function to return the descriptor STREAM_STDIO reads from on the calling thread
+int stream_stdio_input(void);
+
+// Pool of aligned buffers for direct I/O, shared by the files of a run: each file borrows its
+// buffers and gives them back, so a run allocates only until it is warm
+typedef struct stream_arena stream_arena;
+
+// Function to create an empty arena. With `huge_pages` its buffers are backed by 2 MiB pages from
+// the reserved pool, or else marked for transparent huge pages. Returns NULL when out of memory
+stream_arena *stream_arena_create(int huge_pages);
+
+// Function to unmap an arena's buffers and free it (NULL is allowed); no file may be using it
+void stream_arena_free(stream_arena *arena);
+
+// Function to parse a size such as 65536, 64K, 1M or 2G; returns 0 when it is not valid
+size_t stream_parse_size(const char *text);
+
+// Function to round a requested buffer size to one the stream engine accepts
+size_t stream_buffer_size(size_t requested);
+
+// Function to read exactly `length` bytes at `offset` (-1 for the current position, e.g. on a pipe)
+// unless the file ends first; returns the bytes read or -1
+ssize_t stream_read_full(int fd, uint8_t *buffer, size_t length, off_t offset);
+
+// Function to write exactly `length` bytes at `offset` (-1 for the current position); returns 0 or -1
+int stream_write_full(int fd, const uint8_t *buffer, size_t length, off_t offset);
+
+// Function to tell whether `filename` names standard input and output rather than a file
+int stream_is_stdio(const char *filename);
+
+// Function to create the temporary file a rewrite of `filename` goes to, next to it and with the
+// permission bits of `mode`. Returns the descriptor and sets *tmpname, or -1 (already reported)
+int stream_create_temp(const char *filename, mode_t mode, char **tmpname);
+
+// Function to finish a rewrite started with stream_create_temp: on `result` 0 the temporary file
+// is synced and atomically renamed over `filename`, otherwise it is removed. Closes `fd`, frees
+// `tmpname` and returns the final result
+int stream_commit_temp(const char *filename, int fd, char *tmpname, int result);
+
+// Function to rewrite a file through `transform`, one fixed-size buffer at a time, overlapping
+// reads, the transform and writes. The original is replaced atomically only on success.
+// Returns 0 on success and -1 on failure (with the reason already reported). STREAM_STDIO streams
+// standard input to standard output instead; its length is not known until the end, and output is
+// written as it is produced, so a transform that fails on the final call cannot take it back.
+// With an `arena` (NULL for none) the buffers come from it and the file is read and written with
+// direct I/O, bypassing the page cache. The buffer size is rounded up to STREAM_DIRECT_ALIGN, and
+// transfers that are not aligned (the tail of the file, data shifted by a header) go through the
+// cache, which is dropped once the file is written. Standard input and output are not affected
+int stream_file(const char *filename, size_t buffer_size, stream_arena *arena, stream_transform transform, void *arg);
+
+// Function to rewrite a file as stream_file does, with a header around the transformed data: the
+// `header_length` bytes of `header` are written first, and the input is read from offset `skip`
+// on (standard input is read from wherever the caller left it, so a header there is read first)
+int stream_file_framed(const char *filename, size_t buffer_size, stream_arena *arena, const uint8_t *header,
+                       size_t header_length, off_t skip, stream_transform transform, void *arg);
+
+// Function to transform a file in place through a memory mapping, `stride` bytes per call
+// (0 = STREAM_MAP_STRIDE). The transform must preserve length; the update is not atomic. A pipe
+// cannot be mapped, so STREAM_STDIO is streamed as by stream_file
+int stream_map_file(const char *filename, size_t stride, stream_transform transform, void *arg);
+
+#endif